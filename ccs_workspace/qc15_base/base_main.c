@@ -18,12 +18,40 @@
 #include "util.h"
 #include "base_main.h"
 
-#define RADIO_STATS_MSG_LEN 35
-#define RADIO_PROGRESS_MSG_LEN 30
+#define RADIO_STATS_MSG_LEN 64
+#define RADIO_PROGRESS_MSG_LEN 40
 #define BASE_BEACON_INTERVAL_CENT_SEC 1600
 
+/// Shortest time we'll spend on any one channel, in centiseconds.
+/**
+ ** This needs to be long enough for a badge to hear our arrival beacon and
+ ** get all six of its progress frames and its stats frame out to us.
+ */
+#define BASE_DWELL_MIN_CENT_SEC 200
+/// Total length of one trip through all the channels, in centiseconds.
+/**
+ ** Every channel gets BASE_DWELL_MIN_CENT_SEC; the rest of the round is
+ ** shared out in proportion to how much we heard on each channel during the
+ ** previous round. This needs to be comfortably longer than a badge's
+ ** RADIO_GD_INTERVAL, so that badges age us out between our visits and send
+ ** their progress again the next time we show up.
+ */
+#define BASE_ROUND_CENT_SEC 3000
+#define BASE_DWELL_WEIGHTED_CENT_SEC \
+    (BASE_ROUND_CENT_SEC - FREQ_NUM*BASE_DWELL_MIN_CENT_SEC)
+#define RADIO_CHANNEL_MSG_LEN 40
+
 volatile uint8_t f_time_loop;
 
+/// Index (from FREQ_MIN) of the channel we're currently listening on.
+uint8_t base_channel = 0;
+/// Messages received on each channel during the current round.
+uint16_t channel_rx_cnt[FREQ_NUM] = {0,};
+/// Messages received on each channel since boot.
+uint32_t channel_rx_total[FREQ_NUM] = {0,};
+/// How long to stay on each channel during the current round.
+uint16_t channel_dwell[FREQ_NUM] = {0,};
+
 //void delay_millis(unsigned long mils) {
 //    while (mils) {
 //        __delay_cycles(1000);
@@ -76,10 +104,12 @@ void radio_rx_done(uint8_t* data, uint8_t len, uint8_t pipe) {
     radio_proto *radio_msg = (radio_proto *) data;
     switch (radio_msg->msg_type) {
     case RADIO_MSG_TYPE_PROGRESS :
+        channel_rx_cnt[base_channel]++;
         progress_payload = (radio_progress_payload *) radio_msg->msg_payload;
         send_progress_payload(radio_msg->badge_id, progress_payload);
         break;
     case RADIO_MSG_TYPE_STATS :
+        channel_rx_cnt[base_channel]++;
         stats_payload = (radio_stats_payload *) (radio_msg->msg_payload);
         send_stats_payload(radio_msg->badge_id, stats_payload);
         break;
@@ -172,16 +202,14 @@ void send_progress_payload(uint16_t badge_id, radio_progress_payload *payload) {
      * For example: `0x0A1B340001340110A523`
      */
     uint8_t message[RADIO_PROGRESS_MSG_LEN] = {0};
-    sprintf(message, "3,%d,%d,0x", badge_id, payload->part_id);
+    uint8_t len;
+    // Longest case is "3,65535,255,0x" plus 20 hex digits: 34 characters.
+    len = sprintf((char *) message, "3,%u,%u,0x", badge_id, payload->part_id);
 
     for(int i = 0; i < 10; i++) {
-        if (payload->part_data[0] < 16) {
-            sprintf(message, "%s0%x", message, payload->part_data[i]);
-        } else {
-            sprintf(message, "%s%x", message, payload->part_data[i]);
-        }
+        len += sprintf((char *) &message[len], "%02x", payload->part_data[i]);
     }
-    send_string(message, RADIO_PROGRESS_MSG_LEN);
+    send_string(message, len);
     // CRLF
     send_char(0x0D);
     send_char(0x0A);
@@ -196,9 +224,10 @@ void send_stats_payload(uint16_t badge_id, radio_stats_payload *payload) {
      * ubers_seen_count,ubers_connected_count,ubers_uploaded_count,handlers_seen,
      * handlers_connected,handlers_uploaded_count\CR\LF
      */
-    // 12+2+1+10 = 25 bytes
+    // At most 2+5+9*6 = 61 characters.
     uint8_t message[RADIO_STATS_MSG_LEN] = {0};
-    sprintf(message, "4,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
+    uint8_t len;
+    len = sprintf((char *) message, "4,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
             badge_id,
             payload->badges_seen_count,
             payload->badges_downloaded_count,
@@ -209,7 +238,7 @@ void send_stats_payload(uint16_t badge_id, radio_stats_payload *payload) {
             payload->handlers_seen_count,
             payload->handlers_downloaded_count,
             payload->handlers_uploaded_count);
-    send_string(message, RADIO_STATS_MSG_LEN);
+    send_string(message, len);
     // CRLF
     send_char(0x0D);
     send_char(0x0A);
@@ -235,6 +264,83 @@ void beacon() {
     rfm75_tx(RFM75_BROADCAST_ADDR, 0, (uint8_t *) &radio_msg, RFM75_PAYLOAD_SIZE);
 }
 
+/**
+ * Emits the per-channel reception counts for the round that just ended.
+ *
+ * Lines starting with `#` are debug output, and are ignored by anything
+ * that's parsing our progress and stats lines.
+ */
+void send_channel_stats() {
+    uint8_t message[RADIO_CHANNEL_MSG_LEN];
+    uint8_t len;
+
+    for (uint8_t i=0; i<FREQ_NUM; i++) {
+        // # ch,dwell,rx_this_round,rx_total
+        len = sprintf((char *) message, "# %u,%u,%u,%lu",
+                      FREQ_MIN+i, channel_dwell[i], channel_rx_cnt[i],
+                      channel_rx_total[i]);
+        send_string(message, len);
+        send_char(0x0D);
+        send_char(0x0A);
+    }
+}
+
+/**
+ * Decides how long to listen on each channel during the next round.
+ *
+ * Each channel always gets the minimum dwell time, so that we still visit
+ * channels that have been quiet. The rest of the round is weighted by how
+ * many messages we heard on each channel last time around. If we heard
+ * nothing at all, it's split evenly.
+ */
+void compute_channel_dwell() {
+    uint16_t rx_round_total = 0;
+
+    for (uint8_t i=0; i<FREQ_NUM; i++) {
+        rx_round_total += channel_rx_cnt[i];
+    }
+
+    for (uint8_t i=0; i<FREQ_NUM; i++) {
+        channel_dwell[i] = BASE_DWELL_MIN_CENT_SEC;
+        if (rx_round_total) {
+            channel_dwell[i] += (uint32_t) BASE_DWELL_WEIGHTED_CENT_SEC
+                                * channel_rx_cnt[i] / rx_round_total;
+        } else {
+            channel_dwell[i] += BASE_DWELL_WEIGHTED_CENT_SEC / FREQ_NUM;
+        }
+    }
+}
+
+/**
+ * Retunes the radio to the channel at index `base_channel`.
+ */
+void set_channel() {
+    rfm75_write_reg(RF_CH, FREQ_MIN + base_channel);
+}
+
+/**
+ * Moves to the next channel in the hopping sequence, and beacons on it.
+ *
+ * When we wrap back around to the first channel, that's the end of a round,
+ * so we report our reception counts and re-weight the dwell times.
+ */
+void next_channel() {
+    base_channel++;
+    if (base_channel == FREQ_NUM) {
+        base_channel = 0;
+        send_channel_stats();
+        compute_channel_dwell();
+        for (uint8_t i=0; i<FREQ_NUM; i++) {
+            channel_rx_total[i] += channel_rx_cnt[i];
+            channel_rx_cnt[i] = 0;
+        }
+    }
+    set_channel();
+    // Let everyone on this channel know we're here, so they send us their
+    //  progress while we're listening.
+    beacon();
+}
+
 void main (void) {
     WDTCTL = WDTPW | WDTHOLD; // Hold WDT
 
@@ -248,7 +354,10 @@ void main (void) {
 
     rfm75_init(35, &radio_rx_done, &radio_tx_done);
     rfm75_post();
+    compute_channel_dwell();
+    set_channel();
     __bis_SR_register(GIE);
+    beacon();
 
     radio_stats_payload stats = {0};
     stats.badges_seen_count = 0x00AA;
@@ -277,6 +386,7 @@ void main (void) {
     uint16_t badge_id = 0x00AF;
 
     uint16_t cent_secs_waiting = 0;
+    uint16_t cent_secs_on_channel = 0;
 
     while (1) {
         // Interrupt catch when receiving data.
@@ -292,10 +402,19 @@ void main (void) {
         if (f_time_loop) {
             f_time_loop = 0;
 
-            // Increment wait period timer.
+            // Increment wait period timers.
             cent_secs_waiting++;
-            // When we've waited the allotted time
-            if (BASE_BEACON_INTERVAL_CENT_SEC == cent_secs_waiting) {
+            cent_secs_on_channel++;
+
+            if (cent_secs_on_channel >= channel_dwell[base_channel]
+                    && rfm75_tx_avail()) {
+                // Done with this channel, and we're not in the middle of
+                //  sending anything, so it's safe to retune. Moving to the
+                //  next channel also beacons.
+                next_channel();
+                cent_secs_on_channel = 0;
+                cent_secs_waiting = 0;
+            } else if (cent_secs_waiting >= BASE_BEACON_INTERVAL_CENT_SEC) {
                 // Send out a beacon to all nearby badges.
                 beacon();
                 cent_secs_waiting = 0;
@@ -39,6 +39,12 @@ void send_stats_payload(uint16_t badge_id, radio_stats_payload *payload);
 void send_debug_payload(uint16_t badge_id, unsigned char* message);
 void beacon();
 
+// Channel hopping functions
+void send_channel_stats();
+void compute_channel_dwell();
+void set_channel();
+void next_channel();
+
 void TIMER_ISR();
 
 #endif /* BASE_MAIN_H_ */
@@ -58,17 +58,20 @@ uint16_t stored_state_id = 0;
 uint16_t last_state_id = 0;
 #pragma PERSISTENT(game_curr_state_id)
 uint16_t game_curr_state_id = 0;
+#pragma PERSISTENT(closed_states)
+/// Bitfield of the game states that have been closed, by state ID.
+uint8_t closed_states[CLOSED_STATES_LEN] = {0};
 
 #pragma PERSISTENT(led_ring_anim_bg)
-/// Pointer to saved animation (if we're doing a temporary one).
+/// The background animation, to restore after sleep or a reboot.
 const led_ring_animation_t *led_ring_anim_bg = 0;
 
 #pragma PERSISTENT(led_ring_anim_pad_loops_bg)
-/// Saved value of `led_ring_anim_pad_loops` for backgrounds.
+/// Saved `pad_loops` of the background's LED layer.
 uint8_t led_ring_anim_pad_loops_bg = 0;
 
 #pragma PERSISTENT(led_anim_type_bg)
-/// Saved value of `led_anim_type` for backgrounds.
+/// Saved `type` of the background's LED layer.
 uint8_t led_anim_type_bg = 0;
 
 uint8_t badge_seen(uint16_t id) {
@@ -10,6 +10,10 @@
 #define BADGE_H_
 
 #include "leds.h"
+#include "state_definitions.h"
+
+/// Bytes in the `closed_states` bitfield: one bit per game state.
+#define CLOSED_STATES_LEN ((all_states_len+7)/8)
 
 // Non-persistent:
 extern uint8_t unlock_radio_status;
@@ -23,6 +27,7 @@ extern char person_names[QC15_BADGES_IN_SYSTEM][QC15_PERSON_NAME_LEN];
 extern uint16_t stored_state_id;
 extern uint16_t last_state_id;
 extern uint16_t game_curr_state_id;
+extern uint8_t closed_states[CLOSED_STATES_LEN];
 extern const led_ring_animation_t *led_ring_anim_bg;
 extern uint8_t led_ring_anim_pad_loops_bg;
 extern uint8_t led_anim_type_bg;
@@ -20,11 +20,10 @@
 #include "led_animations.h"
 
 #include "badge.h"
+#include "game.h"
 
 #define PART_SIZE 80
 
-uint8_t s_part_solved = 0;
-
 uint8_t is_solved(uint8_t code_id) {
 //    uint8_t code_part_unlocks[6][CODE_SEGMENT_REP_LEN];
     uint8_t bits_decoded;
@@ -123,11 +122,12 @@ void decode_download(uint16_t downloaded_id) {
 
     decode_random_chars(part_id, chars_to_decode);
 
-    // We ONLY emit s_part_solved on a download, because that's the only time
+    // We ONLY post this special on a download, because that's the only time
     //  the game is ready to consume it.
     if (is_solved(part_id)) {
-        s_part_solved = 0x80 | part_id;
-        led_set_anim(&anim_dl_done, 0, 7, 0);
+        game_post_special(SPECIAL_CONNECT_SUCCESS_DONE);
+        led_set_layer(LED_LAYER_NOTIFY, &anim_dl_done, 0, 7, 0,
+                      LED_BLEND_REPLACE, LED_MASK_RING);
     }
 }
 
@@ -140,7 +140,8 @@ void decode_upload() {
     // This wasn't a game action, so there's no reason to tell our state
     //  machine about it. It would just cause spurious notifications.
     if (is_solved(3)) {
-        led_set_anim(&anim_dl_done, 0, 7, 0);
+        led_set_layer(LED_LAYER_NOTIFY, &anim_dl_done, 0, 7, 0,
+                      LED_BLEND_REPLACE, LED_MASK_RING);
     }
 }
 
@@ -159,7 +160,8 @@ void decode_event(uint8_t event_id) {
         }
     }
     if (is_solved(2)) {
-        led_set_anim(&anim_dl_done, 0, 7, 0);
+        led_set_layer(LED_LAYER_NOTIFY, &anim_dl_done, 0, 7, 0,
+                      LED_BLEND_REPLACE, LED_MASK_RING);
     }
     // This wasn't a game action, so there's no reason to tell our state
     //  machine about it. It would just cause spurious notifications.
@@ -0,0 +1,166 @@
+/// A small set-associative read-through cache for the SPI flash.
+/**
+ ** The game engine reads the same handful of actions, texts, and states over
+ ** and over again (every time we check whether an action leads to a closed
+ ** state, every time we pick a random choice, every time the user scrolls
+ ** through the inputs). Each of those reads is a status poll plus a command
+ ** and address header on the SPI bus before we even get to the data, so we
+ ** keep recently used flash lines around in FRAM and serve reads from them
+ ** when we can.
+ **
+ ** The line data lives in FRAM because we don't have the SRAM to spare for
+ ** it. The tags live in SRAM, so the cache always comes up empty after a
+ ** reset, and never serves stale data from a previous boot.
+ **
+ ** Anything that changes the contents of the flash MUST call
+ ** `flash_cache_invalidate()` for the affected range. The write and erase
+ ** functions in s25fs.c already do this.
+ **
+ ** \file flash_cache.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "flash_cache.h"
+#include "s25fs.h"
+
+#define FLASH_CACHE_SET_MASK (FLASH_CACHE_SETS - 1)
+#define FLASH_CACHE_OFFSET_MASK (FLASH_CACHE_LINE_SIZE - 1)
+
+/// Number of reads that were served entirely out of the cache.
+uint32_t flash_cache_hits = 0;
+/// Number of line fills we had to do from the flash chip.
+uint32_t flash_cache_misses = 0;
+
+/// The cached data itself.
+#pragma PERSISTENT(flash_cache_lines)
+uint8_t flash_cache_lines[FLASH_CACHE_SETS][FLASH_CACHE_WAYS][FLASH_CACHE_LINE_SIZE] = {0};
+/// One more than the flash line number held in each way, or 0 if empty.
+/**
+ ** The offset by one means the zeroed SRAM we get out of reset is already a
+ ** valid, empty cache, even if something reads or writes the flash before
+ ** `flash_cache_init()` has been called.
+ */
+uint32_t flash_cache_tags[FLASH_CACHE_SETS][FLASH_CACHE_WAYS];
+/// How many accesses to this set since each way was last used.
+uint8_t flash_cache_age[FLASH_CACHE_SETS][FLASH_CACHE_WAYS];
+
+/// Mark the whole cache as empty.
+void flash_cache_invalidate_all() {
+    for (uint8_t set=0; set<FLASH_CACHE_SETS; set++) {
+        for (uint8_t way=0; way<FLASH_CACHE_WAYS; way++) {
+            flash_cache_tags[set][way] = FLASH_CACHE_TAG_INVALID;
+            flash_cache_age[set][way] = 0xFF;
+        }
+    }
+}
+
+void flash_cache_init() {
+    flash_cache_invalidate_all();
+    flash_cache_hits = 0;
+    flash_cache_misses = 0;
+}
+
+/// Drop any cached lines that overlap the given range of the flash.
+void flash_cache_invalidate(uint32_t address, uint32_t len_bytes) {
+    if (!len_bytes)
+        return;
+
+    uint32_t first_line = address / FLASH_CACHE_LINE_SIZE;
+    uint32_t last_line = (address + len_bytes - 1) / FLASH_CACHE_LINE_SIZE;
+
+    if (last_line - first_line >= FLASH_CACHE_SETS*FLASH_CACHE_WAYS) {
+        // Big range (e.g. a block erase); checking every tag is cheaper than
+        //  walking every line in the range.
+        for (uint8_t set=0; set<FLASH_CACHE_SETS; set++) {
+            for (uint8_t way=0; way<FLASH_CACHE_WAYS; way++) {
+                if (flash_cache_tags[set][way] > first_line &&
+                        flash_cache_tags[set][way] <= last_line+1) {
+                    flash_cache_tags[set][way] = FLASH_CACHE_TAG_INVALID;
+                    flash_cache_age[set][way] = 0xFF;
+                }
+            }
+        }
+        return;
+    }
+
+    for (uint32_t line=first_line; line<=last_line; line++) {
+        uint8_t set = line & FLASH_CACHE_SET_MASK;
+        for (uint8_t way=0; way<FLASH_CACHE_WAYS; way++) {
+            if (flash_cache_tags[set][way] == line+1) {
+                flash_cache_tags[set][way] = FLASH_CACHE_TAG_INVALID;
+                flash_cache_age[set][way] = 0xFF;
+            }
+        }
+    }
+}
+
+/// Mark `way` as the most recently used way in `set`.
+void flash_cache_touch(uint8_t set, uint8_t way) {
+    for (uint8_t i=0; i<FLASH_CACHE_WAYS; i++) {
+        if (flash_cache_age[set][i] < 0xFE)
+            flash_cache_age[set][i]++;
+    }
+    flash_cache_age[set][way] = 0;
+}
+
+/// Get a pointer to the cached copy of flash line number `line`.
+/**
+ ** If the line isn't already in the cache, this evicts the least recently
+ ** used (or an empty) way of its set and fills it from the flash.
+ */
+uint8_t *flash_cache_get_line(uint32_t line) {
+    uint8_t set = line & FLASH_CACHE_SET_MASK;
+    uint8_t victim = 0;
+
+    for (uint8_t way=0; way<FLASH_CACHE_WAYS; way++) {
+        if (flash_cache_tags[set][way] == line+1) {
+            flash_cache_touch(set, way);
+            return flash_cache_lines[set][way];
+        }
+        if (flash_cache_age[set][way] > flash_cache_age[set][victim])
+            victim = way;
+    }
+
+    flash_cache_misses++;
+    s25fs_read_data(flash_cache_lines[set][victim],
+                    line * FLASH_CACHE_LINE_SIZE, FLASH_CACHE_LINE_SIZE);
+    flash_cache_tags[set][victim] = line+1;
+    flash_cache_touch(set, victim);
+    return flash_cache_lines[set][victim];
+}
+
+/// Read from the flash, through the cache. Drop-in for `s25fs_read_data()`.
+void flash_cache_read(uint8_t *buffer, uint32_t address, uint16_t len_bytes) {
+    if (len_bytes > FLASH_CACHE_BYPASS_LEN) {
+        // This would just churn the cache.
+        s25fs_read_data(buffer, address, len_bytes);
+        return;
+    }
+
+    uint32_t misses_before = flash_cache_misses;
+    uint16_t offset;
+    uint16_t chunk;
+
+    while (len_bytes) {
+        offset = address & FLASH_CACHE_OFFSET_MASK;
+        chunk = FLASH_CACHE_LINE_SIZE - offset;
+        if (chunk > len_bytes)
+            chunk = len_bytes;
+
+        memcpy(buffer,
+               flash_cache_get_line(address / FLASH_CACHE_LINE_SIZE) + offset,
+               chunk);
+
+        buffer += chunk;
+        address += chunk;
+        len_bytes -= chunk;
+    }
+
+    if (misses_before == flash_cache_misses)
+        flash_cache_hits++;
+}
@@ -0,0 +1,40 @@
+/// Header for the read-through cache in front of the SPI flash.
+/**
+ ** \file flash_cache.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef FLASH_CACHE_H_
+#define FLASH_CACHE_H_
+
+#include <stdint.h>
+
+/// Bytes per cache line. Must be a power of two.
+#ifndef FLASH_CACHE_LINE_SIZE
+#define FLASH_CACHE_LINE_SIZE 64
+#endif
+/// Number of sets. Must be a power of two.
+#ifndef FLASH_CACHE_SETS
+#define FLASH_CACHE_SETS 16
+#endif
+/// Lines per set (associativity).
+#ifndef FLASH_CACHE_WAYS
+#define FLASH_CACHE_WAYS 2
+#endif
+
+/// Reads longer than this skip the cache and go straight to the flash.
+#define FLASH_CACHE_BYPASS_LEN (FLASH_CACHE_LINE_SIZE*FLASH_CACHE_WAYS)
+
+#define FLASH_CACHE_TAG_INVALID 0
+
+extern uint32_t flash_cache_hits;
+extern uint32_t flash_cache_misses;
+
+void flash_cache_init();
+void flash_cache_read(uint8_t *buffer, uint32_t address, uint16_t len_bytes);
+void flash_cache_invalidate(uint32_t address, uint32_t len_bytes);
+void flash_cache_invalidate_all();
+
+#endif /* FLASH_CACHE_H_ */
@@ -49,6 +49,11 @@
  ** 0x300000 - Actions (65.5 kB)
  ** 0x310000 - Text    (65.5 kB)
  ** 0x320000 - States  (65.5 kB)
+ ** 0x330000 - Choice tables (65.5 kB), see select_action_choice() in game.c
+ ** 0x340000 - LED animation keyframes (to 0x3FFFFF), see led_find_keyframes()
+ **            in leds.c
+ **
+ ** 0x400000 - Record store, 8 blocks (0x400000 - 0x47FFFF), see flash_store.c
  **
  ** ...
  ** 0x7C0000 - last block
@@ -74,5 +79,10 @@
 #define FLASH_ADDR_GAME_ACTIONS 0x300000
 #define FLASH_ADDR_GAME_TEXT    0x310000
 #define FLASH_ADDR_GAME_STATES  0x320000
+#define FLASH_ADDR_GAME_CHOICES 0x330000
+
+#define FLASH_ADDR_LED_ANIMS    0x340000
+
+#define FLASH_ADDR_STORE        0x400000
 
 #endif /* FLASH_LAYOUT_H_ */
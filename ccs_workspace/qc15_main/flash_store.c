@@ -0,0 +1,481 @@
+/// A log-structured, wear-leveled record store in the SPI flash.
+/**
+ ** The FRAM on the FR5972 is nice, but there isn't much of it. This module
+ ** keeps small keyed records (up to STORE_MAX_RECORD_LEN bytes each) in a
+ ** ring of STORE_BLOCKS 64 KB blocks of the SPI flash instead.
+ **
+ ** Records are only ever appended. Writing a key again just appends a newer
+ ** copy, and deleting a key appends a tombstone. We never program over data
+ ** that's already been written, so there's no read-modify-erase-write cycle
+ ** for every small change.
+ **
+ ** At boot, `store_init()` reads the block headers and replays every block
+ ** that has records in it, oldest first, to rebuild the index (one flash
+ ** address per key). The index is in FRAM because we can't spare the SRAM,
+ ** but it's rebuilt every boot, so it's never trusted across a reset.
+ **
+ ** Once fewer than STORE_MIN_FREE_BLOCKS blocks are free, `store_poll()`
+ ** compacts the used block with the least live data: it copies the records
+ ** that are still current into the active block, a few per time loop, and
+ ** then erases the old block with an asynchronous flash job so the UI never
+ ** stalls on it. Since that block isn't necessarily the oldest, a tombstone
+ ** is also copied if an older block still has a record for its key;
+ ** otherwise, that record would come back at the next replay. Every block's
+ ** header has an erase counter, and new blocks are always taken from the
+ ** free block with the fewest erases. A block that fails to erase
+ ** STORE_ERASE_TRIES times in a row is left alone until the next boot.
+ **
+ ** The store stays down (reads find nothing, and writes fail) if the flash
+ ** is locked out, or until `store_init()` has been called.
+ **
+ ** \file flash_store.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <msp430.h>
+
+#include "qc15.h"
+#include "util.h"
+#include "s25fs.h"
+#include "flash_cache.h"
+#include "flash_layout.h"
+#include "flash_store.h"
+
+#define STORE_BLOCK_NONE 0xFF
+
+/// How many times each block has been erased (from the block headers).
+uint32_t store_erase_counts[STORE_BLOCKS] = {0,};
+/// Number of blocks that are formatted and ready to take records.
+uint16_t store_free_blocks = 0;
+/// What the background compaction is currently doing.
+uint8_t store_state = STORE_STATE_IDLE;
+/// Whether `store_init()` has set the store up, with the flash usable.
+uint8_t store_ready = 0;
+
+/// STORE_BLOCK_FREE, STORE_BLOCK_USED, or STORE_BLOCK_DIRTY for each block.
+uint8_t store_block_state[STORE_BLOCKS] = {0,};
+/// The sequence number of each used block.
+uint32_t store_block_seq[STORE_BLOCKS] = {0,};
+/// The highest sequence number we've handed out.
+uint32_t store_seq_max = 0;
+/// Bitfield of the keys each used block has data records (not tombstones) for.
+uint8_t store_block_keys[STORE_BLOCKS][STORE_MAX_KEYS / 8] = {{0,},};
+
+/// The block we're currently appending records to.
+uint8_t store_active = STORE_BLOCK_NONE;
+/// Offset within the active block where the next record goes.
+uint32_t store_write_offset = 0;
+
+/// Block being compacted or erased by `store_poll()`.
+uint8_t store_work_block = STORE_BLOCK_NONE;
+/// Offset of the next record to consider in the block being compacted.
+uint32_t store_work_offset = 0;
+/// The result of our own erase job, as `s25fs_job_erase_block()` leaves it.
+uint8_t store_erase_result = S25FS_JOB_PENDING;
+/// Failed erases of each block in a row.
+uint8_t store_erase_failures[STORE_BLOCKS] = {0,};
+
+/// Flash address of the current record for each key, or STORE_ADDR_NONE.
+#pragma PERSISTENT(store_index)
+uint32_t store_index[STORE_MAX_KEYS] = {0,};
+/// Data length of the current record for each key.
+#pragma PERSISTENT(store_index_len)
+uint8_t store_index_len[STORE_MAX_KEYS] = {0,};
+
+/// Scratch space for assembling and checking one whole record.
+#pragma PERSISTENT(store_buf)
+uint8_t store_buf[STORE_MAX_RECORD_LEN + STORE_RECORD_OVERHEAD] = {0,};
+
+uint32_t store_block_addr(uint8_t block) {
+    return FLASH_ADDR_STORE + (uint32_t) block * STORE_BLOCK_SIZE;
+}
+
+/// Write the header of a freshly erased block, making it a free block.
+uint8_t store_format(uint8_t block) {
+    store_block_header_t header;
+
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = STORE_MAGIC;
+    header.erase_count = store_erase_counts[block];
+    header.crc = crc16_compute((uint8_t *) &header.erase_count,
+                               sizeof(header.erase_count));
+
+    // Leave seq (and everything after it) erased.
+    if (!s25fs_write_stream(store_block_addr(block), (uint8_t *) &header,
+                            offsetof(store_block_header_t, seq))) {
+        store_block_state[block] = STORE_BLOCK_DIRTY;
+        return 0;
+    }
+
+    store_block_state[block] = STORE_BLOCK_FREE;
+    store_free_blocks++;
+    return 1;
+}
+
+/// Start appending records to the least-worn free block.
+uint8_t store_open_block() {
+    uint8_t block = STORE_BLOCK_NONE;
+    uint32_t seq;
+
+    for (uint8_t i=0; i<STORE_BLOCKS; i++) {
+        if (store_block_state[i] != STORE_BLOCK_FREE)
+            continue;
+        if (block == STORE_BLOCK_NONE
+                || store_erase_counts[i] < store_erase_counts[block])
+            block = i;
+    }
+
+    if (block == STORE_BLOCK_NONE)
+        return 0;
+
+    seq = store_seq_max + 1;
+    store_free_blocks--;
+    if (!s25fs_write_stream(store_block_addr(block)
+                                + offsetof(store_block_header_t, seq),
+                            (uint8_t *) &seq, sizeof(seq))) {
+        store_block_state[block] = STORE_BLOCK_DIRTY;
+        return 0;
+    }
+
+    store_seq_max = seq;
+    store_block_seq[block] = seq;
+    store_block_state[block] = STORE_BLOCK_USED;
+    memset(store_block_keys[block], 0, sizeof(store_block_keys[block]));
+    store_active = block;
+    store_write_offset = sizeof(store_block_header_t);
+    return 1;
+}
+
+/// Point the index at a record we just wrote or found.
+void store_index_record(uint32_t address) {
+    store_record_header_t *record = (store_record_header_t *) store_buf;
+    uint8_t block = (address - FLASH_ADDR_STORE) / STORE_BLOCK_SIZE;
+
+    if (record->flags & STORE_FLAG_TOMBSTONE) {
+        store_index[record->key] = STORE_ADDR_NONE;
+    } else {
+        store_index[record->key] = address;
+        store_index_len[record->key] = record->len;
+        store_block_keys[block][record->key / 8] |= 1 << (record->key % 8);
+    }
+}
+
+/// Append the complete record in `store_buf` to the active block.
+uint8_t store_append_buf() {
+    store_record_header_t *record = (store_record_header_t *) store_buf;
+    uint16_t size = record->len + STORE_RECORD_OVERHEAD;
+    uint32_t address;
+
+    if (store_active == STORE_BLOCK_NONE
+            || store_write_offset + size > STORE_BLOCK_SIZE) {
+        if (!store_open_block())
+            return 0;
+    }
+
+    address = store_block_addr(store_active) + store_write_offset;
+    if (!s25fs_write_stream(address, store_buf, size)) {
+        // Whatever's there now is garbage, and we'll stop replaying this
+        //  block when we get to it. So don't write anything else here.
+        store_write_offset = STORE_BLOCK_SIZE;
+        return 0;
+    }
+
+    store_write_offset += size;
+    store_index_record(address);
+    return 1;
+}
+
+/// Load the record at `address` into `store_buf`, returning 1 if it's valid.
+/**
+ ** Returns 0 at the end of the written part of a block, and also if the
+ ** record is damaged (e.g. we lost power halfway through writing it).
+ */
+uint8_t store_load_record(uint32_t address, uint32_t block_end) {
+    store_record_header_t *record = (store_record_header_t *) store_buf;
+
+    if (address + STORE_RECORD_OVERHEAD > block_end)
+        return 0;
+
+    s25fs_read_data(store_buf, address, sizeof(store_record_header_t));
+    if (record->key == STORE_KEY_END
+            || record->key >= STORE_MAX_KEYS
+            || record->len > STORE_MAX_RECORD_LEN
+            || address + record->len + STORE_RECORD_OVERHEAD > block_end)
+        return 0;
+
+    s25fs_read_data(store_buf + sizeof(store_record_header_t),
+                    address + sizeof(store_record_header_t),
+                    record->len + 2);
+    return crc16_check_buffer(store_buf,
+                              sizeof(store_record_header_t) + record->len);
+}
+
+/// Replay every record in a used block into the index.
+/**
+ ** Returns the offset just past the last valid record. If the block ends
+ ** in a damaged record, it's treated as full.
+ */
+uint32_t store_replay_block(uint8_t block) {
+    uint32_t base = store_block_addr(block);
+    uint32_t offset = sizeof(store_block_header_t);
+    store_record_header_t *record = (store_record_header_t *) store_buf;
+
+    while (store_load_record(base + offset, base + STORE_BLOCK_SIZE)) {
+        store_index_record(base + offset);
+        offset += record->len + STORE_RECORD_OVERHEAD;
+    }
+
+    if (record->key != STORE_KEY_END)
+        return STORE_BLOCK_SIZE;
+    return offset;
+}
+
+/// Read the block headers and rebuild the index. Call once at boot, after
+///  the flash POST has set `global_flash_lockout`.
+void store_init() {
+    store_block_header_t header;
+    uint8_t replayed[STORE_BLOCKS] = {0,};
+    uint8_t next;
+    uint32_t offset;
+
+    for (uint8_t i=0; i<STORE_MAX_KEYS; i++) {
+        store_index[i] = STORE_ADDR_NONE;
+    }
+    memset(store_block_keys, 0, sizeof(store_block_keys));
+
+    store_free_blocks = 0;
+    store_seq_max = 0;
+    store_active = STORE_BLOCK_NONE;
+    store_state = STORE_STATE_IDLE;
+    store_ready = 0;
+    memset(store_erase_failures, 0, sizeof(store_erase_failures));
+
+    if (global_flash_lockout)
+        return;
+
+    for (uint8_t i=0; i<STORE_BLOCKS; i++) {
+        s25fs_read_data((uint8_t *) &header, store_block_addr(i),
+                        sizeof(header));
+        if (header.magic != STORE_MAGIC
+                || header.crc != crc16_compute(
+                        (uint8_t *) &header.erase_count,
+                        sizeof(header.erase_count))) {
+            // Never formatted, or interrupted mid-format. It'll be erased
+            //  in the background. We've lost its erase count, if it had one.
+            store_erase_counts[i] = 0;
+            store_block_state[i] = STORE_BLOCK_DIRTY;
+            continue;
+        }
+
+        store_erase_counts[i] = header.erase_count;
+        if (header.seq == STORE_SEQ_FREE) {
+            store_block_state[i] = STORE_BLOCK_FREE;
+            store_free_blocks++;
+        } else {
+            store_block_state[i] = STORE_BLOCK_USED;
+            store_block_seq[i] = header.seq;
+            if (header.seq > store_seq_max)
+                store_seq_max = header.seq;
+        }
+    }
+
+    // Replay the used blocks from oldest to newest, so that the newest copy
+    //  of each record is the one left in the index.
+    while (1) {
+        next = STORE_BLOCK_NONE;
+        for (uint8_t i=0; i<STORE_BLOCKS; i++) {
+            if (store_block_state[i] != STORE_BLOCK_USED || replayed[i])
+                continue;
+            if (next == STORE_BLOCK_NONE
+                    || store_block_seq[i] < store_block_seq[next])
+                next = i;
+        }
+        if (next == STORE_BLOCK_NONE)
+            break;
+
+        offset = store_replay_block(next);
+        replayed[next] = 1;
+        // The newest block is the one we keep appending to.
+        store_active = next;
+        store_write_offset = offset;
+    }
+    store_ready = 1;
+}
+
+/// Read the current record for `key` into `buffer`, returning its length.
+/**
+ ** At most `len` bytes are copied. Returns 0 if there is no such record.
+ */
+uint8_t store_read(uint16_t key, uint8_t *buffer, uint8_t len) {
+    if (!store_ready || key >= STORE_MAX_KEYS
+            || store_index[key] == STORE_ADDR_NONE)
+        return 0;
+
+    if (len > store_index_len[key])
+        len = store_index_len[key];
+
+    flash_cache_read(buffer,
+                     store_index[key] + sizeof(store_record_header_t), len);
+    return len;
+}
+
+uint8_t store_put(uint16_t key, uint8_t *buffer, uint8_t len, uint8_t flags) {
+    store_record_header_t *record = (store_record_header_t *) store_buf;
+
+    if (!store_ready || key >= STORE_MAX_KEYS || len > STORE_MAX_RECORD_LEN)
+        return 0;
+
+    record->key = key;
+    record->len = len;
+    record->flags = flags;
+    memcpy(store_buf + sizeof(store_record_header_t), buffer, len);
+    crc16_append_buffer(store_buf, sizeof(store_record_header_t) + len);
+    return store_append_buf();
+}
+
+/// Store `len` bytes from `buffer` as the new value of `key`.
+/**
+ ** Returns 1 on success. Returns 0 if the key or length is out of range, if
+ ** there's no room until compaction frees up a block, or if the flash
+ ** reported a program error.
+ */
+uint8_t store_write(uint16_t key, uint8_t *buffer, uint8_t len) {
+    return store_put(key, buffer, len, 0);
+}
+
+/// Remove `key` from the store, returning 1 on success.
+uint8_t store_delete(uint16_t key) {
+    if (!store_ready)
+        return 0;
+    if (key >= STORE_MAX_KEYS || store_index[key] == STORE_ADDR_NONE)
+        return 1;
+    return store_put(key, 0, 0, STORE_FLAG_TOMBSTONE);
+}
+
+/// Pick the used block (other than the active one) with the least live data.
+uint8_t store_pick_victim() {
+    uint32_t live[STORE_BLOCKS] = {0,};
+    uint8_t victim = STORE_BLOCK_NONE;
+    uint8_t block;
+
+    for (uint8_t i=0; i<STORE_MAX_KEYS; i++) {
+        if (store_index[i] == STORE_ADDR_NONE)
+            continue;
+        block = (store_index[i] - FLASH_ADDR_STORE) / STORE_BLOCK_SIZE;
+        live[block] += store_index_len[i] + STORE_RECORD_OVERHEAD;
+    }
+
+    for (uint8_t i=0; i<STORE_BLOCKS; i++) {
+        if (store_block_state[i] != STORE_BLOCK_USED || i == store_active)
+            continue;
+        if (victim == STORE_BLOCK_NONE
+                || live[i] < live[victim]
+                || (live[i] == live[victim]
+                        && store_block_seq[i] < store_block_seq[victim]))
+            victim = i;
+    }
+
+    return victim;
+}
+
+/// Whether a used block older than `block` has a data record for `key`.
+uint8_t store_key_in_older_block(uint16_t key, uint8_t block) {
+    for (uint8_t i=0; i<STORE_BLOCKS; i++) {
+        if (i == block || store_block_state[i] != STORE_BLOCK_USED
+                || store_block_seq[i] > store_block_seq[block])
+            continue;
+        if (store_block_keys[i][key / 8] & (1 << (key % 8)))
+            return 1;
+    }
+    return 0;
+}
+
+/// Copy up to STORE_COPIES_PER_TICK live records out of the victim block.
+/**
+ ** Returns 1 once every record in the block has been dealt with.
+ */
+uint8_t store_compact_step() {
+    uint32_t base = store_block_addr(store_work_block);
+    uint32_t address;
+    uint8_t copied = 0;
+    store_record_header_t *record = (store_record_header_t *) store_buf;
+
+    while (copied < STORE_COPIES_PER_TICK) {
+        address = base + store_work_offset;
+        if (!store_load_record(address, base + STORE_BLOCK_SIZE))
+            return 1;
+
+        if (store_index[record->key] == address
+                || ((record->flags & STORE_FLAG_TOMBSTONE)
+                    && store_index[record->key] == STORE_ADDR_NONE
+                    && store_key_in_older_block(record->key,
+                                                store_work_block))) {
+            // Still the current copy of this key, or a deletion that an
+            //  older block doesn't know about yet, so it has to move.
+            if (!store_append_buf())
+                return 0; // Try again next time.
+            copied++;
+        }
+        store_work_offset += record->len + STORE_RECORD_OVERHEAD;
+    }
+    return 0;
+}
+
+/// Do a little bit of background housekeeping. Call this every time loop.
+void store_poll() {
+    if (!store_ready)
+        return;
+
+    switch(store_state) {
+    case STORE_STATE_IDLE:
+        // Blocks that need erasing come first, since they're free space
+        //  that's just waiting for us.
+        for (uint8_t i=0; i<STORE_BLOCKS; i++) {
+            if (store_block_state[i] == STORE_BLOCK_DIRTY) {
+                if (s25fs_job_erase_block(store_block_addr(i),
+                                          &store_erase_result)) {
+                    store_work_block = i;
+                    store_state = STORE_STATE_ERASING;
+                }
+                return;
+            }
+        }
+
+        if (store_free_blocks >= STORE_MIN_FREE_BLOCKS)
+            return;
+
+        store_work_block = store_pick_victim();
+        if (store_work_block == STORE_BLOCK_NONE)
+            return;
+        store_work_offset = sizeof(store_block_header_t);
+        store_state = STORE_STATE_COPYING;
+        break;
+    case STORE_STATE_COPYING:
+        if (!store_compact_step())
+            return;
+        // Everything in that block is either stale or has moved.
+        store_block_state[store_work_block] = STORE_BLOCK_DIRTY;
+        store_state = STORE_STATE_IDLE;
+        break;
+    case STORE_STATE_ERASING:
+        if (store_erase_result == S25FS_JOB_PENDING)
+            return;
+        store_state = STORE_STATE_IDLE;
+        if (!store_erase_result) {
+            // Still dirty, so it'll be erased again, up to a point.
+            if (++store_erase_failures[store_work_block] >= STORE_ERASE_TRIES)
+                store_block_state[store_work_block] = STORE_BLOCK_BAD;
+            return;
+        }
+        store_erase_failures[store_work_block] = 0;
+        store_erase_counts[store_work_block]++;
+        store_format(store_work_block);
+        break;
+    }
+}
@@ -0,0 +1,91 @@
+/// Header for the log-structured record store in the SPI flash.
+/**
+ ** \file flash_store.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef FLASH_STORE_H_
+#define FLASH_STORE_H_
+
+#include <stdint.h>
+
+#include "flash_layout.h"
+
+/// Number of 64 KB flash blocks the store rotates through.
+#define STORE_BLOCKS 8
+#define STORE_BLOCK_SIZE 0x10000
+/// Keys must be less than this. The index has one slot per key.
+#define STORE_MAX_KEYS 64
+/// The most data a single record may hold.
+#define STORE_MAX_RECORD_LEN 128
+/// Compaction starts when fewer than this many blocks are free.
+/**
+ ** This must be at least 2: one to append new records into, and one spare
+ ** for compaction to copy into if the active block fills up mid-copy.
+ */
+#define STORE_MIN_FREE_BLOCKS 2
+/// The most live records compaction will move during a single time loop.
+#define STORE_COPIES_PER_TICK 4
+/// Erase failures in a row before we give up on a block until reboot.
+#define STORE_ERASE_TRIES 3
+
+#define STORE_MAGIC 0x5153 // "QS"
+#define STORE_SEQ_FREE 0xFFFFFFFF
+#define STORE_KEY_END 0xFFFF
+#define STORE_ADDR_NONE 0xFFFFFFFF
+
+#define STORE_FLAG_TOMBSTONE 0x01
+
+/// The header at the start of every block in the store.
+/**
+ ** The first three fields are written when the block is formatted, right
+ ** after it's erased. `seq` is left erased (0xFFFFFFFF) while the block is
+ ** free, and is programmed when the block starts taking records.
+ */
+typedef struct {
+    uint16_t magic;
+    /// CRC16 of `erase_count`.
+    uint16_t crc;
+    /// Number of times this block has been erased by the store.
+    uint32_t erase_count;
+    /// Order in which this block was filled, or STORE_SEQ_FREE.
+    uint32_t seq;
+    uint32_t reserved;
+} store_block_header_t;
+
+/// The header of a record. It's followed by `len` bytes of data and a CRC16.
+/**
+ ** The CRC covers this header and the data. An erased key (STORE_KEY_END)
+ ** marks the end of the written part of the block.
+ */
+typedef struct {
+    uint16_t key;
+    uint8_t len;
+    uint8_t flags;
+} store_record_header_t;
+
+#define STORE_RECORD_OVERHEAD (sizeof(store_record_header_t) + 2)
+
+#define STORE_BLOCK_FREE 0
+#define STORE_BLOCK_USED 1
+#define STORE_BLOCK_DIRTY 2
+/// Wouldn't erase, so we're leaving it alone.
+#define STORE_BLOCK_BAD 3
+
+#define STORE_STATE_IDLE 0
+#define STORE_STATE_COPYING 1
+#define STORE_STATE_ERASING 2
+
+extern uint32_t store_erase_counts[STORE_BLOCKS];
+extern uint16_t store_free_blocks;
+extern uint8_t store_state;
+
+void store_init();
+uint8_t store_read(uint16_t key, uint8_t *buffer, uint8_t len);
+uint8_t store_write(uint16_t key, uint8_t *buffer, uint8_t len);
+uint8_t store_delete(uint16_t key);
+void store_poll();
+
+#endif /* FLASH_STORE_H_ */
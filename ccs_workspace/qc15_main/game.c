@@ -18,6 +18,7 @@
 #include <msp430.h>
 
 #include "qc15.h"
+#include "util.h"
 #include "leds.h"
 #include "game.h"
 #include "lcd111.h"
@@ -26,6 +27,7 @@
 #include "badge.h"
 #include "flash_layout.h"
 #include "s25fs.h"
+#include "flash_cache.h"
 #include "menu.h"
 
 #include "led_animations.h"
@@ -33,6 +35,7 @@
 #include "loop_signals.h"
 
 uint8_t start_action_series(uint16_t action_id);
+void game_timers_start();
 
 #define GAME_ACTION_TYPE_ANIM_TEMP 0
 #define GAME_ACTION_TYPE_SET_ANIM_BG 1
@@ -50,6 +53,15 @@ uint8_t start_action_series(uint16_t action_id);
 #define GAME_ACTION_TYPE_TEXT_END 99
 #define GAME_ACTION_TYPE_OTHER 100
 
+/// `chain_end` marker for an action series with more than one state transition.
+#define CHAIN_END_MULTI 0xFFFE
+/// `chain_end` marker for an action series with no state transitions.
+#define CHAIN_END_NONE 0xFFFF
+/// `timer_next` value for a timer that won't fire again in this state.
+#define TIMER_NEVER 0xFFFFFFFF
+/// The bit in `game_specials` for the special event with type ID `id`.
+#define SPECIAL_BIT(id) ((id) < GAME_SPECIAL_COUNT ? (1 << (id)) : 0)
+
 char game_name_buffer[QC15_BADGE_NAME_LEN];
 
 uint8_t text_cursor = 0;
@@ -57,8 +69,6 @@ game_state_t loaded_state;
 game_action_t loaded_action;
 uint16_t state_last_special_event = GAME_NULL;
 game_state_t *current_state;
-uint16_t closed_states[CLOSABLE_STATES] = {0};
-uint8_t num_closed_states = 0;
 
 char loaded_text[25];
 char current_text[25] = "";
@@ -70,39 +80,174 @@ uint32_t game_curr_state_elapsed = 0;
 
 uint8_t text_selection = 0;
 
+/// When each of the current state's timers fires next.
+/**
+ ** These are values of `game_curr_state_elapsed`. They're worked out when
+ ** a state is entered, and moved along each time the timer's time comes (or
+ ** goes by while an action series is blocking the timers), so that firing a
+ ** timer never needs a division. `timer_next_min` is the earliest of them,
+ ** which means that most time loops only need to do one comparison.
+ */
+uint32_t timer_next[MAX_TIMERS];
+uint32_t timer_next_min = TIMER_NEVER;
+
+// `game_process_timers()` keeps one bit per due timer in a uint8_t.
+#if MAX_TIMERS > 8
+#error "MAX_TIMERS is more than game_process_timers() has bits for."
+#endif
+
+/// Special events waiting for the game, one bit per `SPECIAL_` type ID.
+/**
+ ** Most specials happen once: the radio, the name search, or a connection
+ ** posts them with `game_post_special()` or `game_name_search_done()`, and
+ ** firing one uses it up. The rest are conditions (whether any badges are
+ ** nearby, and whether the last name search came up empty), which are set
+ ** and cleared as the condition changes and aren't used up by firing. Either
+ ** way, a special stays pending until a state that handles it gets to it,
+ ** so the game only has to look at them when one of these bits changes.
+ */
+uint8_t game_specials = SPECIAL_BIT(SPECIAL_NAME_NOT_FOUND);
+/// The specials that the current state has handlers for.
+uint8_t state_specials = 0;
+
+/// Where each action series ends up, for `leads_to_closed_state()`.
+/**
+ ** Entry `i` is one more than the ID of the state that the action series
+ ** starting at action `i` transitions to, or one of the `CHAIN_END_` markers.
+ ** 0 means we haven't walked that series yet. Entries are filled in the first
+ ** time each series is checked, so the flash reads that checking costs only
+ ** happen once per series per boot, instead of on every menu button press.
+ ** It's too big for SRAM, so it lives in FRAM, like the flash cache lines.
+ */
+#pragma PERSISTENT(chain_end)
+uint16_t chain_end[ALL_ACTIONS_LEN] = {0};
+
+/// The state we expect to go to next, loaded ahead of time.
+/**
+ ** Most of the time the game is waiting, on the user or on the typewriter,
+ ** and the MCU has nothing to do. `game_prefetch_tick()` uses that time to
+ ** load the state that the selected menu choice leads to, along with the
+ ** first action of its entry series and that action's text, so that when the
+ ** user picks it, `game_set_state()` and the entry series get them from here
+ ** instead of from the flash, and the new state is up in the first tick.
+ **
+ ** Like the flash cache, the data lives in FRAM, and what it holds is kept
+ ** in SRAM (`prefetch_tag`), so it always comes up empty after a reset.
+ */
+typedef struct {
+    uint16_t action_id;
+    uint16_t text_id;
+    game_state_t state;
+    game_action_t action;
+    char text[25];
+} game_prefetch_t;
+
+#pragma PERSISTENT(prefetch)
+game_prefetch_t prefetch = {0};
+/// One more than the ID of the state in `prefetch`, or 0 if it's empty.
+uint16_t prefetch_tag = 0;
+/// The menu choice action series that we last prefetched for.
+uint16_t prefetch_source = GAME_NULL;
+
+/// State transitions whose state was already in `prefetch`.
+uint32_t game_prefetch_hits = 0;
+/// State transitions that had to load their state from the flash.
+uint32_t game_prefetch_misses = 0;
+
 void load_action(game_action_t *dest, uint16_t id) {
-    s25fs_read_data((uint8_t *)dest, FLASH_ADDR_GAME_ACTIONS + id*sizeof(game_action_t),
-                    sizeof(game_action_t));
+    if (prefetch_tag && id == prefetch.action_id) {
+        memcpy(dest, &prefetch.action, sizeof(game_action_t));
+        return;
+    }
+    flash_cache_read((uint8_t *)dest, FLASH_ADDR_GAME_ACTIONS + id*sizeof(game_action_t),
+                     sizeof(game_action_t));
 }
 
 void load_state(game_state_t *dest, uint16_t id) {
-    s25fs_read_data((uint8_t *)dest, FLASH_ADDR_GAME_STATES + id*sizeof(game_state_t),
-                    sizeof(game_state_t));
+    if (prefetch_tag == id+1) {
+        game_prefetch_hits++;
+        memcpy(dest, &prefetch.state, sizeof(game_state_t));
+        return;
+    }
+    game_prefetch_misses++;
+    flash_cache_read((uint8_t *)dest, FLASH_ADDR_GAME_STATES + id*sizeof(game_state_t),
+                     sizeof(game_state_t));
 }
 
 void load_text(char *dest, uint16_t id) {
-    s25fs_read_data((uint8_t *)dest, FLASH_ADDR_GAME_TEXT + id*25,
-                    24);
-    dest[25] = 0x00; // Make SURE FOR SURE it's null-terminated.
+    if (prefetch_tag && id == prefetch.text_id) {
+        memcpy(dest, prefetch.text, sizeof(prefetch.text));
+        return;
+    }
+    flash_cache_read((uint8_t *)dest, FLASH_ADDR_GAME_TEXT + id*25,
+                     24);
+    dest[24] = 0x00; // Make SURE FOR SURE it's null-terminated.
 }
 
 uint8_t state_is_closed(uint16_t state_id) {
-    for (uint8_t i=0; i<num_closed_states; i++) {
-        if (closed_states[i] == state_id)
+    if (state_id >= all_states_len)
+        return 0;
+    return check_id_buf(state_id, closed_states);
+}
+
+void close_state(uint16_t state_id) {
+    if (state_id >= all_states_len)
+        return;
+    set_id_buf(state_id, closed_states);
+}
+
+/// Return 1 if any state at all has been closed.
+uint8_t any_state_closed() {
+    for (uint8_t i=0; i<CLOSED_STATES_LEN; i++) {
+        if (closed_states[i])
             return 1;
     }
     return 0;
 }
 
-void close_state(uint16_t state_id) {
-    if (!state_is_closed(state_id)) {
-        closed_states[num_closed_states] = state_id;
-        num_closed_states++;
-    }
+/// Return the number of states that have been closed.
+uint16_t closed_state_count() {
+    return buffer_rank(closed_states, CLOSED_STATES_LEN);
+}
+
+/// Walk an action series to find which state it ends up in, for `chain_end`.
+uint16_t find_chain_end(uint16_t action_id) {
+    game_action_t action;
+    uint16_t end = CHAIN_END_NONE;
+    do {
+        load_action(&action, action_id);
+        if (action.type == GAME_ACTION_TYPE_STATE_TRANSITION) {
+            if (end != CHAIN_END_NONE && end != action.detail+1)
+                return CHAIN_END_MULTI;
+            end = action.detail+1;
+        }
+        action_id = action.next_action_id;
+    } while (action_id != GAME_NULL);
+    return end;
 }
 
 uint8_t leads_to_closed_state(uint16_t action_id) {
     game_action_t action;
+    uint16_t end;
+
+    if (action_id == GAME_NULL || !any_state_closed())
+        return 0;
+
+    if (action_id < ALL_ACTIONS_LEN) {
+        if (!chain_end[action_id])
+            chain_end[action_id] = find_chain_end(action_id);
+        end = chain_end[action_id];
+    } else {
+        end = find_chain_end(action_id);
+    }
+
+    if (end == CHAIN_END_NONE)
+        return 0;
+    if (end != CHAIN_END_MULTI)
+        return state_is_closed(end-1);
+
+    // This series has more than one transition in it, so we can't tell from
+    //  `chain_end` alone. Any of them being closed counts.
     do {
         load_action(&action, action_id);
         if (action.type == GAME_ACTION_TYPE_STATE_TRANSITION &&
@@ -113,62 +258,74 @@ uint8_t leads_to_closed_state(uint16_t action_id) {
     return 0;
 }
 
+/// Post a special event for the game to handle.
+void game_post_special(uint16_t type_id) {
+    game_specials |= SPECIAL_BIT(type_id);
+}
+
+/// Update the badges nearby specials, after `badges_nearby` or `freq_set` changes.
+void game_update_nearby() {
+    if (badges_nearby==0 && badge_conf.freq_set) {
+        game_specials |= SPECIAL_BIT(SPECIAL_BADGESNEARBY0);
+        game_specials &= ~SPECIAL_BIT(SPECIAL_BADGESNEARBYSOME);
+    } else {
+        game_specials |= SPECIAL_BIT(SPECIAL_BADGESNEARBYSOME);
+        game_specials &= ~SPECIAL_BIT(SPECIAL_BADGESNEARBY0);
+    }
+}
+
+/// Post the result of a name search.
+void game_name_search_done(uint8_t found) {
+    if (found) {
+        game_specials |= SPECIAL_BIT(SPECIAL_NAME_FOUND);
+        game_specials &= ~SPECIAL_BIT(SPECIAL_NAME_NOT_FOUND);
+    } else {
+        game_specials |= SPECIAL_BIT(SPECIAL_NAME_NOT_FOUND);
+        game_specials &= ~SPECIAL_BIT(SPECIAL_NAME_FOUND);
+    }
+}
+
 /// Check if a special event should fire, and fire it, returning 1 if it fired.
 uint8_t game_process_special() {
-    uint8_t fire_special = 0;
-    for (uint8_t i=0; i<current_state->other_series_len; i++) {
-        // The following is effectively a bigass OR, since every if statement
-        //  has a similar (if not identical) body. But it's more readable like
-        //  this.
+    uint16_t type_id;
+
+    // The last special that fired in this state can't fire again until a
+    //  different one does, so if nothing else this state handles is pending,
+    //  there's nothing to do.
+    if (!(game_specials & state_specials &
+            ~SPECIAL_BIT(state_last_special_event)))
+        return 0;
 
-        if (current_state->other_series[i].type_id == state_last_special_event)
+    for (uint8_t i=0; i<current_state->other_series_len; i++) {
+        type_id = current_state->other_series[i].type_id;
+        if (type_id == state_last_special_event ||
+                !(game_specials & SPECIAL_BIT(type_id)))
             continue;
 
-        if (current_state->other_series[i].type_id == SPECIAL_BADGESNEARBY0 &&
-                (badges_nearby==0 && badge_conf.freq_set)) {
-            fire_special = 1;
-        }
-        if (current_state->other_series[i].type_id == SPECIAL_BADGESNEARBYSOME &&
-                (badges_nearby>0 || !badge_conf.freq_set)) {
-            fire_special = 1;
-        }
-        if (current_state->other_series[i].type_id == SPECIAL_NAME_FOUND &&
-                s_game_checkname_success) {
-            s_game_checkname_success = 0;
-            fire_special = 1;
-        }
-        if (current_state->other_series[i].type_id == SPECIAL_NAME_NOT_FOUND &&
-                !s_game_checkname_success) {
-            fire_special = 1;
-        }
-        if (current_state->other_series[i].type_id == SPECIAL_CONNECT_SUCCESS_NEW &&
-                s_gd_success == 2) {
-            s_gd_success = 0;
-            led_set_anim(&anim_dl_done, 0, 0, 0);
-            fire_special = 1;
-        }
-        if (current_state->other_series[i].type_id == SPECIAL_CONNECT_SUCCESS_OLD &&
-                s_gd_success == 1) {
-            s_gd_success = 0;
-            led_set_anim(&anim_dl, 0, 0, 0);
-            fire_special = 1;
-        }
-        if (current_state->other_series[i].type_id == SPECIAL_CONNECT_FAILURE &&
-                s_gd_failure) {
-            s_gd_failure = 0;
-            fire_special = 1;
-        }
-        if (current_state->other_series[i].type_id == SPECIAL_CONNECT_SUCCESS_DONE &&
-                s_part_solved) {
-            s_part_solved = 0;
-            fire_special = 1;
-        }
-        if (fire_special) {
-            fire_special = 0;
-            state_last_special_event = current_state->other_series[i].type_id;
-            if (start_action_series(current_state->other_series[i].result_action_id))
-                return 1;
+        // The specials that happen once are used up by firing.
+        switch (type_id) {
+        case SPECIAL_NAME_FOUND:
+            game_name_search_done(0);
+            break;
+        case SPECIAL_CONNECT_SUCCESS_NEW:
+            game_specials &= ~SPECIAL_BIT(type_id);
+            led_set_layer(LED_LAYER_NOTIFY, &anim_dl_done, 0, 0, 0,
+                          LED_BLEND_REPLACE, LED_MASK_RING);
+            break;
+        case SPECIAL_CONNECT_SUCCESS_OLD:
+            game_specials &= ~SPECIAL_BIT(type_id);
+            led_set_layer(LED_LAYER_NOTIFY, &anim_dl, 0, 0, 0,
+                          LED_BLEND_ADD, LED_MASK_ALL);
+            break;
+        case SPECIAL_CONNECT_FAILURE:
+        case SPECIAL_CONNECT_SUCCESS_DONE:
+            game_specials &= ~SPECIAL_BIT(type_id);
+            break;
         }
+
+        state_last_special_event = type_id;
+        if (start_action_series(current_state->other_series[i].result_action_id))
+            return 1;
     }
     return 0;
 }
@@ -192,11 +349,25 @@ void game_set_state(uint16_t state_id, uint8_t keep_previous) {
     current_state = &loaded_state;
     game_curr_state_id = state_id;
     state_last_special_event = GAME_NULL;
+    prefetch_source = GAME_NULL;
+    state_specials = 0;
+    for (uint8_t i=0; i<current_state->other_series_len && i<MAX_OTHERS; i++)
+        state_specials |= SPECIAL_BIT(current_state->other_series[i].type_id);
+    game_timers_start();
 
     start_action_series(current_state->entry_series_id);
 }
 
+/// Forget anything remembered about the game content from before this boot.
+void game_init() {
+    memset(chain_end, 0, sizeof(chain_end));
+    prefetch_tag = 0;
+    prefetch_source = GAME_NULL;
+}
+
 void game_begin() {
+    // The badge config, and so `freq_set`, is loaded by now.
+    game_update_nearby();
     game_set_state(game_curr_state_id, 1);
 }
 
@@ -296,15 +467,9 @@ void do_action(game_action_t *action) {
     case GAME_ACTION_TYPE_ANIM_TEMP:
         // Set a temporary animation
         if (action->detail >= GAME_ANIMS_LEN || action->detail == GAME_NULL) {
-            if (led_ring_anim_bg) {
-                // If we have a background animation stored, that this one
-                //  was briefly superseding, then go ahead and start it
-                //  up again.
-                led_set_anim(led_ring_anim_bg, led_anim_type_bg,
-                             0xff, led_ring_anim_pad_loops_bg);
-            } else {
-                led_set_anim_none(0);
-            }
+            // Stop the temporary animation; the background animation, if
+            //  there is one, is still going underneath it.
+            led_set_layer_none(LED_LAYER_TEMP);
         } else {
             led_set_anim(&all_animations[action->detail], 0,
                          action->duration, 0);
@@ -403,6 +568,42 @@ void do_action(game_action_t *action) {
     }
 }
 
+/// Look up which action a random value picks, in the choice tables.
+/**
+ ** The content compiler builds a table for every choice set, which maps the
+ ** same random values to the same choices as walking the set does, but only
+ ** takes a read of the directory and a read of the table, rather than a read
+ ** of every choice up to the one that gets picked.
+ **
+ ** Returns the ID of the picked action, or GAME_NULL if this set isn't in
+ ** the tables and needs to be walked.
+ */
+uint16_t choice_table_pick(uint16_t first_choice_id, uint16_t random_value) {
+    game_choice_set_t set;
+    game_choice_t choices[GAME_CHOICES_MAX];
+
+    if (first_choice_id >= ALL_ACTIONS_LEN)
+        return GAME_NULL;
+
+    flash_cache_read((uint8_t *) &set,
+                     FLASH_ADDR_GAME_CHOICES +
+                     first_choice_id*sizeof(game_choice_set_t),
+                     sizeof(game_choice_set_t));
+    if (!set.len || set.len > GAME_CHOICES_MAX)
+        return GAME_NULL;
+
+    flash_cache_read((uint8_t *) choices,
+                     FLASH_ADDR_GAME_CHOICES +
+                     ALL_ACTIONS_LEN*sizeof(game_choice_set_t) +
+                     set.first*sizeof(game_choice_t),
+                     set.len*sizeof(game_choice_t));
+    for (uint8_t i=0; i<set.len-1; i++) {
+        if (random_value < choices[i].upper)
+            return choices[i].action_id;
+    }
+    return choices[set.len-1].action_id;
+}
+
 /// Place the next action choice in `loaded_action`.
 void select_action_choice(uint16_t first_choice_id) {
     // This function is SIDE EFFECT CITY!
@@ -415,6 +616,15 @@ void select_action_choice(uint16_t first_choice_id) {
 
     uint16_t random_value = rand() % loaded_action.choice_total;
     uint16_t total_choices = 0;
+    uint16_t choice_id = choice_table_pick(first_choice_id, random_value);
+
+    if (choice_id != GAME_NULL) {
+        if (choice_id != first_choice_id)
+            load_action(&loaded_action, choice_id);
+        return;
+    }
+
+    // No table for this set, so walk it.
 
     do {
         total_choices += loaded_action.choice_share;
@@ -546,35 +756,122 @@ void game_process_user_in() {
     }
 }
 
+/// Schedule the first firing of each of the current state's timers.
+void game_timers_start() {
+    timer_next_min = TIMER_NEVER;
+    for (uint8_t i=0; i<current_state->timer_series_len && i<MAX_TIMERS; i++) {
+        // Timers don't fire at time 0, so a timer with no duration never
+        //  fires at all.
+        if (current_state->timer_series[i].duration)
+            timer_next[i] = current_state->timer_series[i].duration;
+        else
+            timer_next[i] = TIMER_NEVER;
+
+        if (timer_next[i] < timer_next_min)
+            timer_next_min = timer_next[i];
+    }
+}
+
 void game_process_timers() {
-    // Check whether any of our timers need to fire.
-    for (uint8_t i=0; i<current_state->timer_series_len; i++) {
-        // If the current elapsed time is equal to the timer duration,
-        //  OR if it's a recurring timer and the elapsed time is equal to
-        //  zero modulo the duration, then this timer is allowed to fire.
-        // Note that this method is quite sensitive to the order in which
-        //  the timers populate their array. So it's important that the
-        //  instructions, above, on how to order them be followed.
-        if (!game_curr_state_elapsed)
-            continue; // We don't fire timers at time 0.
-        // If we did, it would be *chaos* because we evaluate
-        // whether a timer should fire by checking whether the
-        // current state time elapsed is 0, mod the duration.
-        // (which, of course, 0 always is.)
-        if ((game_curr_state_elapsed == current_state->timer_series[i].duration) ||
-                (current_state->timer_series[i].recurring &&
-                        ((game_curr_state_elapsed % current_state->timer_series[i].duration) == 0))) {
-            // Time `i` should fire, unless it's closed.
-            if (start_action_series(
-                    current_state->timer_series[i].result_action_id))
-            {
-                break;
-            }
+    uint8_t due = 0;
+    game_timer_t *timer;
+
+    if (game_curr_state_elapsed < timer_next_min)
+        return; // Nothing is due yet.
+
+    // Find the timers that are due now, and move every timer whose time has
+    //  come or gone along to its next firing. A non-recurring timer fires
+    //  only when the elapsed time equals its duration, and a recurring one
+    //  whenever the elapsed time is a multiple of its duration. If an action
+    //  series was running when a timer was due, it missed its chance; this
+    //  catches it up.
+    timer_next_min = TIMER_NEVER;
+    for (uint8_t i=0; i<current_state->timer_series_len && i<MAX_TIMERS; i++) {
+        timer = &current_state->timer_series[i];
+        while (timer_next[i] <= game_curr_state_elapsed) {
+            if (timer_next[i] == game_curr_state_elapsed)
+                due |= 1 << i;
+            if (timer->recurring)
+                timer_next[i] += timer->duration;
+            else
+                timer_next[i] = TIMER_NEVER;
+        }
+
+        if (timer_next[i] < timer_next_min)
+            timer_next_min = timer_next[i];
+    }
+
+    // Fire the first due timer whose action series isn't closed. If it
+    //  changes the state, game_set_state() reschedules the timers.
+    for (uint8_t i=0; due; i++, due >>= 1) {
+        if ((due & 1) && start_action_series(
+                current_state->timer_series[i].result_action_id))
+        {
+            break;
         }
     }
 }
 
+/// Load the state the selected menu choice leads to into `prefetch`.
+void game_prefetch_tick() {
+    uint16_t action_id;
+    uint16_t end;
+
+    if (!current_state->input_series_len)
+        return;
+
+    // Until the user has moved through the menu, guess the first choice.
+    action_id = current_state->input_series[
+            text_selection ? text_selection-1 : 0].result_action_id;
+    if (action_id == prefetch_source)
+        return; // Already done.
+    prefetch_source = action_id;
+    if (action_id >= ALL_ACTIONS_LEN)
+        return;
+
+    if (!chain_end[action_id])
+        chain_end[action_id] = find_chain_end(action_id);
+    end = chain_end[action_id];
+    if (end == CHAIN_END_NONE || end == CHAIN_END_MULTI ||
+            end-1 >= all_states_len || state_is_closed(end-1) ||
+            prefetch_tag == end)
+        return;
+
+    prefetch_tag = 0; // It's not valid until we're done filling it.
+    prefetch.action_id = GAME_NULL;
+    prefetch.text_id = GAME_NULL;
+    flash_cache_read((uint8_t *) &prefetch.state,
+                     FLASH_ADDR_GAME_STATES + (end-1)*sizeof(game_state_t),
+                     sizeof(game_state_t));
+
+    action_id = prefetch.state.entry_series_id;
+    if (action_id < ALL_ACTIONS_LEN) {
+        flash_cache_read((uint8_t *) &prefetch.action,
+                         FLASH_ADDR_GAME_ACTIONS +
+                         action_id*sizeof(game_action_t),
+                         sizeof(game_action_t));
+        prefetch.action_id = action_id;
+        if (is_text_type(prefetch.action.type)) {
+            flash_cache_read((uint8_t *) prefetch.text,
+                             FLASH_ADDR_GAME_TEXT + prefetch.action.detail*25,
+                             24);
+            prefetch.text[24] = 0x00;
+            prefetch.text_id = prefetch.action.detail;
+        }
+        // And have start_action_series() check for closed states without
+        //  going to the flash, too.
+        if (!chain_end[action_id])
+            chain_end[action_id] = find_chain_end(action_id);
+    }
+
+    prefetch_tag = end;
+}
+
 void game_clock_tick() {
+    // Every flash read counts as a cache hit or a miss, so if this sum is
+    //  the same at the end of the tick, the game didn't need the flash.
+    uint32_t flash_reads = flash_cache_hits + flash_cache_misses;
+
     if (in_action_series) {
         game_curr_action_elapsed++;
         game_action_sequence_tick();
@@ -604,6 +901,12 @@ void game_clock_tick() {
         game_process_timers();
     }
 
+    // If we're just waiting for the user or the typewriter, get ready for
+    //  what they're likely to do next.
+    if ((!in_action_series || is_text_type(loaded_action.type)) &&
+            flash_reads == flash_cache_hits + flash_cache_misses)
+        game_prefetch_tick();
+
 }
 
 // Display the currently appropriate game display.
@@ -38,6 +38,34 @@ typedef struct {
     uint16_t choice_total;
 } game_action_t;
 
+/// Choice sets bigger than this aren't put in the choice tables.
+#define GAME_CHOICES_MAX 16
+
+/// Where to find a choice set's table, in the choice tables' directory.
+/**
+ ** The directory has one of these for every action, at
+ ** `FLASH_ADDR_GAME_CHOICES`. It's only filled in for actions that are the
+ ** first choice in a choice set; for everything else (or if there's no
+ ** table in the flash at all) `len` is 0 or 0xFFFF.
+ */
+typedef struct {
+    /// Index of the first of this set's entries, after the directory.
+    uint16_t first;
+    /// Number of choices in this set.
+    uint16_t len;
+} game_choice_set_t;
+
+/// One choice in a choice set's table.
+typedef struct {
+    /// Random values (mod `choice_total`) below this pick this choice.
+    /**
+     ** This is the running total of `choice_share` up through this choice,
+     ** except for the last choice, which is always 0xFFFF.
+     */
+    uint16_t upper;
+    uint16_t action_id;
+} game_choice_t;
+
 typedef struct {
     /// The duration of this timer, in 1/32 of seconds.
     uint32_t duration;
@@ -60,8 +88,10 @@ typedef struct {
     uint16_t entry_series_id;
     /// All applicable timers for this state.
     /**
-     ** These MUST be sorted from MOST specific to LEAST specific. That is,
-     ** any NON-recurring timers must come first, followed by recurring timers
+     ** If several timers come due on the same time loop, only the first of
+     ** them (in this order) whose action series isn't closed fires. So these
+     ** should be sorted from MOST specific to LEAST specific. That is,
+     ** any NON-recurring timers come first, followed by recurring timers
      ** from largest to smallest interval.
      */
     uint8_t timer_series_len;
@@ -73,10 +103,25 @@ typedef struct {
     game_other_in_t other_series[MAX_OTHERS];
 } game_state_t;
 
+/// The number of special event types, each of which is a bit in `game_specials`.
+#define GAME_SPECIAL_COUNT 8
+
 extern char game_name_buffer[QC15_BADGE_NAME_LEN];
-extern uint8_t s_game_checkname_success;
+extern uint8_t game_specials;
+extern uint32_t game_prefetch_hits;
+extern uint32_t game_prefetch_misses;
 extern uint8_t s_turn_on_file_lights;
 
+uint8_t state_is_closed(uint16_t state_id);
+void close_state(uint16_t state_id);
+uint8_t any_state_closed();
+uint16_t closed_state_count();
+
+void game_post_special(uint16_t type_id);
+void game_update_nearby();
+void game_name_search_done(uint8_t found);
+
+void game_init();
 void game_begin();
 void game_handle_loop();
 void game_render_current();
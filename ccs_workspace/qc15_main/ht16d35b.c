@@ -11,6 +11,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include <driverlib.h>
 #include <msp430.h>
@@ -51,19 +52,106 @@
 #define HTCMD_SW_RESET      0xCC
 /// The number of RGB (3-channel) LEDs in the system.
 #define HT16D_LED_COUNT 24
+/// The rows we don't use (see `ht16d_init()`), which never need sending.
+#define HT16D_ROWS_UNUSED ((1UL<<21) | (1UL<<22) | (1UL<<26) | (1UL<<27))
+/// Unchanged rows that `ht16d_send_gray()` will resend to save a write.
+/**
+ ** Every write to the display memory costs a START, the I2C address, the
+ ** command and the display address before any data, and a STOP after it, so
+ ** resending a few unchanged rows between two changed ones is cheaper than
+ ** splitting them into two writes.
+ */
+#define HT16D_ROW_GAP_MAX 3
+/// The most runs of changed rows one COM can have, which is one write each.
+#define HT16D_COM_WRITES_MAX ((28 + HT16D_ROW_GAP_MAX + 1) / (HT16D_ROW_GAP_MAX + 2))
+/// `ht16d_frame_sending` or `ht16d_frame_queued` when there's no such frame.
+#define HT16D_FRAME_NONE 0xFF
+
+/// The display memory writes for one call to `ht16d_send_gray()`.
+typedef struct {
+    /// The writes, back to back, each a command, an address, and data.
+    uint8_t data[3*30];
+    uint8_t write_len[3*HT16D_COM_WRITES_MAX];
+    uint8_t writes;
+    /// Whether this writes every row, so that we'll know what's shown after.
+    uint8_t full;
+} ht16d_frame_t;
 
 /// 8-bit values for the RGB LEDs, ring first, then line.
 /**
  ** This is a 24-element array of 3-tuples of RGB color (1 byte / 8 bits per
  ** channel). Note that, in this array, all 8 bits are significant; the
- ** right-shifting by two is done in `led_send_gray()`, to send 6-bit data to
- ** the LED controller, because it only has 6 bits of grayscale.
+ ** conversion to 6 bits, through `ht16d_gamma`, is done in
+ ** `ht16d_send_gray()`, because the LED controller only has 6 bits of
+ ** grayscale.
  **
  ** The first 18 3-tuples are the outer ring, and the last 6 tuples are the
  ** line between the LCD screens.
  */
 uint8_t ht16d_gs_values[HT16D_LED_COUNT][3] = {0,};
 
+/// 8-bit channel value to 6-bit grayscale, gamma 2.2.
+/**
+ ** Generated by scripts/gamma_lut.py.
+ */
+const uint8_t ht16d_gamma[256] = {
+     0,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+     1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+     1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  3,  3,  3,  3,  3,
+     3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  4,  4,  4,  5,  5,  5,
+     5,  5,  5,  5,  5,  6,  6,  6,  6,  6,  6,  7,  7,  7,  7,  7,
+     7,  8,  8,  8,  8,  8,  8,  9,  9,  9,  9,  9, 10, 10, 10, 10,
+    10, 11, 11, 11, 11, 11, 12, 12, 12, 12, 12, 13, 13, 13, 13, 14,
+    14, 14, 14, 15, 15, 15, 15, 16, 16, 16, 16, 17, 17, 17, 17, 18,
+    18, 18, 18, 19, 19, 19, 20, 20, 20, 20, 21, 21, 21, 22, 22, 22,
+    23, 23, 23, 24, 24, 24, 25, 25, 25, 25, 26, 26, 26, 27, 27, 28,
+    28, 28, 29, 29, 29, 30, 30, 30, 31, 31, 31, 32, 32, 33, 33, 33,
+    34, 34, 35, 35, 35, 36, 36, 37, 37, 37, 38, 38, 39, 39, 39, 40,
+    40, 41, 41, 42, 42, 42, 43, 43, 44, 44, 45, 45, 46, 46, 46, 47,
+    47, 48, 48, 49, 49, 50, 50, 51, 51, 52, 52, 53, 53, 54, 54, 55,
+    55, 56, 56, 57, 57, 58, 58, 59, 59, 60, 60, 61, 61, 62, 62, 63,
+};
+
+/// The 6-bit values in the LED controller's display memory, COM by ROW.
+/**
+ ** This is what `ht16d_send_gray()` last sent, so that it can send only what
+ ** has changed since. It's only good while `ht16d_sent_gray_valid` is set,
+ ** which it isn't after `ht16d_init()` resets the controller, or after the
+ ** controller NACKs a write, until a full frame starts.
+ */
+uint8_t ht16d_sent_gray[3][28];
+uint8_t ht16d_sent_gray_valid = 0;
+/// Display memory bytes that `ht16d_send_gray()` didn't send, because
+///  they hadn't changed.
+uint32_t ht16d_bytes_saved = 0;
+
+/// Frames for the I2C ISR to send, so the main loop doesn't wait on them.
+/**
+ ** `ht16d_send_gray()` works out a frame in whichever of these isn't being
+ ** sent, and then either starts sending it, or queues it for the ISR to start
+ ** when the current one is done. If a queued frame hasn't started by the time
+ ** the next one comes along, it's out of date, and gets replaced (that's an
+ ** overrun). Nothing is lost that way, because `ht16d_sent_gray` is only
+ ** updated when a frame starts, so the new frame carries all of the changes
+ ** since the one being sent.
+ */
+ht16d_frame_t ht16d_frames[2];
+/// The frame the ISR is sending, or `HT16D_FRAME_NONE`.
+volatile uint8_t ht16d_frame_sending = HT16D_FRAME_NONE;
+/// The frame for the ISR to send next, or `HT16D_FRAME_NONE`.
+volatile uint8_t ht16d_frame_queued = HT16D_FRAME_NONE;
+/// Which write of the frame being sent the ISR is on.
+volatile uint8_t ht16d_tx_write = 0;
+/// The next byte of the frame being sent.
+volatile uint8_t ht16d_tx_index = 0;
+/// Where the current write ends in the frame being sent.
+volatile uint8_t ht16d_tx_write_end = 0;
+/// Frames the ISR has finished sending.
+volatile uint32_t ht16d_frames_done = 0;
+/// Frames replaced by a newer frame before they could be sent.
+uint32_t ht16d_frames_overrun = 0;
+
 /// Correlate our LED_ID,COLOR to COL,ROW.
 /**
  ** Note that the HT16D35B does include a feature to handle this mapping for us
@@ -94,7 +182,13 @@ void ht16d_init_io() {
 }
 
 /// Transmit a `len` byte array `txdat` to the HT16D35B.
+/**
+ ** This waits for any frames that the ISR is sending to finish first, so
+ ** everything reaches the controller in the order it was sent.
+ */
 void ht16d_send_array(uint8_t txdat[], uint8_t len) {
+    while (ht16d_frame_sending != HT16D_FRAME_NONE);
+
     // START
     UCB0CTLW0 |= UCTR; // Transmit mode.
 
@@ -139,6 +233,8 @@ void ht16_d_send_cmd_dat(uint8_t cmd, uint8_t dat) {
 
 /// Read 21 bytes of the status register into the supplied byte pointer.
 void ht16d_read_reg(uint8_t reg[]) {
+    while (ht16d_frame_sending != HT16D_FRAME_NONE);
+
     // START
     UCB0CTLW0 |= UCTR; // Transmit.
     UCB0CTLW0 |=  UCTXSTT; // Send a START.
@@ -214,6 +310,8 @@ void ht16d_init() {
 
     // SW Reset (HTCMD_SW_RESET)
     ht16d_send_cmd_single(HTCMD_SW_RESET);
+    // We don't know what's in the display memory now.
+    ht16d_sent_gray_valid = 0;
 
     // Set global brightness
     ht16_d_send_cmd_dat(HTCMD_GLOBAL_BRTNS, HT16D_BRIGHTNESS_DEFAULT);
@@ -260,31 +358,160 @@ void ht16d_set_global_brightness(uint8_t brightness) {
     ht16_d_send_cmd_dat(HTCMD_GLOBAL_BRTNS, brightness);
 }
 
-/// Transmit the data currently in `led_values` to the LED controller.
+/// Start an I2C write of `len` bytes from the frame being sent, for the ISR.
+void ht16d_tx_begin_write(uint8_t len) {
+    UCB0CTLW0 |= UCTR; // Transmit mode.
+
+    UCB0CTLW0 |= UCSWRST; // Stop the I2C engine (clears STPIFG, too)
+    UCB0CTLW1 &= ~UCASTP_3; // Clear the auto-stop bits.
+    UCB0CTLW1 |= UCASTP_2; // Auto-stop.
+    UCB0TBCNT_L = len;
+    UCB0CTLW0 &= ~UCSWRST; // Re-start engine.
+
+    // The reset cleared the interrupt enables, so set them now.
+    UCB0IFG &= ~(UCTXIFG | UCNACKIFG);
+    UCB0IE |= UCTXIE0 | UCSTPIE | UCNACKIE;
+    UCB0CTLW0 |= UCTXSTT; // Send a START.
+}
+
+/// Update `ht16d_sent_gray` to what a frame will leave in the display memory.
+void ht16d_frame_commit(ht16d_frame_t *frame) {
+    uint8_t index = 0;
+    uint8_t address;
+
+    for (uint8_t i=0; i<frame->writes; i++) {
+        address = frame->data[index+1];
+        memcpy(&ht16d_sent_gray[address/0x20][address%0x20],
+               &frame->data[index+2], frame->write_len[i]-2);
+        index += frame->write_len[i];
+    }
+    if (frame->full)
+        ht16d_sent_gray_valid = 1;
+}
+
+/// Start sending frame `frame_id`. Call with interrupts disabled.
+void ht16d_frame_begin(uint8_t frame_id) {
+    ht16d_frame_t *frame = &ht16d_frames[frame_id];
+
+    ht16d_frame_commit(frame);
+    ht16d_frame_sending = frame_id;
+    ht16d_tx_write = 0;
+    ht16d_tx_index = 0;
+    ht16d_tx_write_end = frame->write_len[0];
+    ht16d_tx_begin_write(frame->write_len[0]);
+}
+
+/// Return 1 if ROW of COM `col` needs sending to show the values in `gray`.
+uint8_t ht16d_row_changed(uint8_t col, uint8_t row, uint8_t gray[]) {
+    if (!ht16d_sent_gray_valid)
+        return 1;
+    if (HT16D_ROWS_UNUSED & (1UL<<row))
+        return 0;
+    return gray[row] != ht16d_sent_gray[col][row];
+}
+
+/// Work out the writes that update the display memory to `led_values`.
 /**
  ** Here, and only here, we also convert the LED channel brightness values
  ** from 8-bit to 6-bit.
+ **
+ ** Only the rows whose 6-bit values have changed since the last frame are
+ ** written, in one write per run of changed rows.
  */
-void ht16d_send_gray() {
+void ht16d_build_frame(ht16d_frame_t *frame) {
     // the array, in this case, is:
     // COM0,ROW0 ... ROW27
     // COM1,ROW0 ...
+    // with each COM starting at 0x20*COM.
 
-    // So we only need to write the first three COMs.
+    // So we only need to write the first three COMs. The controller
+    //  increments the address as we write, so a run of rows takes one write.
 
-    uint8_t light_array[30] = {HTCMD_WRITE_DISPLAY, 0x00, 0};
+    uint8_t gray[28];
+    uint8_t first, last, row;
+    uint8_t len = 0;
 
+    frame->writes = 0;
+    frame->full = !ht16d_sent_gray_valid;
     for (uint8_t col=0; col<3; col++) {
-        light_array[1] = 0x20*col;
-        for (uint8_t row=0; row<28; row++) {
+        for (row=0; row<28; row++) {
             uint8_t led_num = ht16d_col_mapping[col][row][0];
             uint8_t rgb_num = ht16d_col_mapping[col][row][1];
 
-            light_array[row+2] = ht16d_gs_values[led_num][rgb_num]>>2;
+            gray[row] = ht16d_gamma[ht16d_gs_values[led_num][rgb_num]];
         }
 
-        ht16d_send_array(light_array, 30);
+        row = 0;
+        while (1) {
+            // Find the start of the next run of changed rows...
+            while (row<28 && !ht16d_row_changed(col, row, gray))
+                row++;
+            if (row == 28)
+                break;
+            first = last = row;
+            // ...and its end, carrying short gaps of unchanged rows.
+            for (row++; row<28 && row-last-1 <= HT16D_ROW_GAP_MAX; row++) {
+                if (ht16d_row_changed(col, row, gray))
+                    last = row;
+            }
+            row = last+1;
+
+            frame->data[len] = HTCMD_WRITE_DISPLAY;
+            frame->data[len+1] = 0x20*col + first;
+            memcpy(&frame->data[len+2], &gray[first], last-first+1);
+            frame->write_len[frame->writes] = last-first+3;
+            len += frame->write_len[frame->writes];
+            frame->writes++;
+        }
+    }
+
+    ht16d_bytes_saved += 3*30 - len;
+}
+
+/// Transmit the data currently in `led_values` to the LED controller.
+/**
+ ** If interrupts are enabled, this hands the frame to the I2C ISR and
+ ** returns without waiting for it to go out. If nothing has changed, there
+ ** is no I2C traffic at all.
+ */
+void ht16d_send_gray() {
+    uint8_t gie = __get_SR_register() & GIE;
+    uint8_t frame_id;
+    uint8_t index = 0;
+
+    // Any frame still in the queue is out of date now. With it out of the
+    //  queue, the ISR won't touch `ht16d_sent_gray` while we compare to it.
+    __disable_interrupt();
+    if (ht16d_frame_queued != HT16D_FRAME_NONE) {
+        ht16d_frame_queued = HT16D_FRAME_NONE;
+        ht16d_frames_overrun++;
+    }
+    frame_id = ht16d_frame_sending == 0 ? 1 : 0;
+    if (gie)
+        __enable_interrupt();
+
+    ht16d_build_frame(&ht16d_frames[frame_id]);
+    if (!ht16d_frames[frame_id].writes)
+        return;
+
+    if (!gie) {
+        // The ISR can't run (e.g. in `ht16d_init()`), so send it the slow
+        //  way.
+        ht16d_frame_commit(&ht16d_frames[frame_id]);
+        for (uint8_t i=0; i<ht16d_frames[frame_id].writes; i++) {
+            ht16d_send_array(&ht16d_frames[frame_id].data[index],
+                             ht16d_frames[frame_id].write_len[i]);
+            index += ht16d_frames[frame_id].write_len[i];
+        }
+        return;
     }
+
+    __disable_interrupt();
+    if (ht16d_frame_sending == HT16D_FRAME_NONE)
+        ht16d_frame_begin(frame_id);
+    else
+        ht16d_frame_queued = frame_id;
+    __enable_interrupt();
 }
 
 /// Set some of the colors, but don't send them to the LED controller.
@@ -337,3 +564,49 @@ void ht16d_all_one_color_ring_only(uint8_t r, uint8_t g, uint8_t b) {
     }
     ht16d_send_gray();
 }
+
+/// The I2C ISR, which sends the frames queued by `ht16d_send_gray()`.
+#pragma vector=USCI_B0_VECTOR
+__interrupt
+void HT16D_I2C_ISR() {
+    ht16d_frame_t *frame = &ht16d_frames[ht16d_frame_sending & 0x01];
+    uint8_t next;
+
+    switch (__even_in_range(UCB0IV, USCI_I2C_UCBIT9IFG)) {
+    case USCI_I2C_UCNACKIFG:
+        // The controller didn't answer. Give up on this write; the STOP
+        //  moves us along to the next one. We don't know what it's showing
+        //  now, so the next frame sends everything.
+        ht16d_sent_gray_valid = 0;
+        UCB0IE &= ~UCTXIE0;
+        UCB0CTLW0 |= UCTXSTP;
+        break;
+    case USCI_I2C_UCTXIFG0:
+        UCB0TXBUF = frame->data[ht16d_tx_index++];
+        if (ht16d_tx_index == ht16d_tx_write_end)
+            UCB0IE &= ~UCTXIE0; // The auto-stop takes it from here.
+        break;
+    case USCI_I2C_UCSTPIFG:
+        UCB0CTLW1 &= ~UCASTP_3; // Disable auto-stop.
+        ht16d_tx_index = ht16d_tx_write_end;
+        ht16d_tx_write++;
+        if (ht16d_tx_write < frame->writes) {
+            ht16d_tx_write_end += frame->write_len[ht16d_tx_write];
+            ht16d_tx_begin_write(frame->write_len[ht16d_tx_write]);
+            break;
+        }
+
+        // That's the whole frame.
+        ht16d_frames_done++;
+        UCB0IE &= ~(UCTXIE0 | UCSTPIE | UCNACKIE);
+        next = ht16d_frame_queued;
+        ht16d_frame_queued = HT16D_FRAME_NONE;
+        if (next != HT16D_FRAME_NONE)
+            ht16d_frame_begin(next);
+        else
+            ht16d_frame_sending = HT16D_FRAME_NONE;
+        break;
+    default:
+        break;
+    }
+}
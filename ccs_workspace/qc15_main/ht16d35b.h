@@ -28,6 +28,10 @@ typedef struct {
     uint16_t b;
 } rgbcolor16_t;
 
+extern uint32_t ht16d_bytes_saved;
+extern volatile uint32_t ht16d_frames_done;
+extern uint32_t ht16d_frames_overrun;
+
 void ht16d_init_io();
 void ht16d_init();
 uint8_t ht16d_post();
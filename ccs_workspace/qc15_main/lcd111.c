@@ -33,6 +33,19 @@
 #include "lcd111.h"
 #include "util.h"
 
+/// Unchanged characters that `lcd111_set_text()` will rewrite, rather than
+///  move the cursor (two commands) to skip.
+#define LCD111_SKIP_MIN 3
+
+/// What's on each display (by LCD_BTM/LCD_TOP), as far as we know.
+static char lcd111_shadow[2][LCD111_COLS];
+/// Whether each display's `lcd111_shadow` is known to be right.
+static uint8_t lcd111_shadow_valid[2] = {0, 0};
+/// Each display's data address, where the next character goes.
+static uint8_t lcd111_address[2] = {0, 0};
+/// Each display's cursor type, or 0xFF until `lcd111_init()` sets it.
+static uint8_t lcd111_cursor[2] = {0xFF, 0xFF};
+
 /// Initialize the shift register IO, and initialize (but not enable) the EUSCI.
 void lcd111_sr_init_io() {
     // Shift register:
@@ -111,9 +124,25 @@ void lcd111_wr(uint8_t lcd_id, uint8_t byte, uint8_t is_data) {
     lcd111_sr_out(0xff);
 }
 
+/// Blank the shadow of a display that's just been cleared.
+void lcd111_shadow_clear(uint8_t lcd_id) {
+    for (uint8_t i=0; i<LCD111_COLS; i++)
+        lcd111_shadow[lcd_id][i] = ' ';
+    lcd111_shadow_valid[lcd_id] = 1;
+    lcd111_address[lcd_id] = 0;
+}
+
 /// Issue a command to one of the LCDs.
 void lcd111_command(uint8_t lcd_id, uint8_t command) {
     lcd111_wr(lcd_id, command, 0);
+
+    // Keep track of what the command does to the display's state:
+    if (command == LCD111_CMD_CLR)
+        lcd111_shadow_clear(lcd_id);
+    else if ((command & 0b11100000) == 0b11100000)
+        lcd111_address[lcd_id] = command & 0b00011111;
+    else if ((command & 0b11111000) == 0b00001000)
+        lcd111_cursor[lcd_id] = command & 0b0111;
     // We may need to do some additional waiting here. MOST commands take only
     //  10 cycles (of the LCD's onboard clock) to execute, in which case we
     //  DON'T need to do additional waiting. However, CL (clear display)
@@ -132,10 +161,15 @@ void lcd111_standby(uint8_t lcd_id) {
 void lcd111_wake(uint8_t lcd_id) {
     // power control: ON
     lcd111_command(lcd_id, 0b00011100);
+    // Don't count on the display keeping its text through standby.
+    lcd111_shadow_valid[lcd_id] = 0;
 }
 
 void lcd111_data(uint8_t lcd_id, uint8_t data) {
     lcd111_wr(lcd_id, data, 1);
+    if (lcd111_address[lcd_id] < LCD111_COLS)
+        lcd111_shadow[lcd_id][lcd111_address[lcd_id]] = data;
+    lcd111_address[lcd_id]++;
     // All data operations take only 10 cycles (of the LCD's onboard clock)
     //  to run, so we don't need to add any additional waiting here.
 }
@@ -146,6 +180,10 @@ void lcd111_sr_init() {
 }
 
 void lcd111_init() {
+    // We don't know what's on the displays until we clear them.
+    lcd111_shadow_valid[0] = 0;
+    lcd111_shadow_valid[1] = 0;
+
     lcd111_sr_init();
     lcd111_sr_out(0xff);
     // Pulse reset LOW, for at least 10 ms.
@@ -159,12 +197,14 @@ void lcd111_init() {
     lcd111_command(0, 0x28); // Display lines: 2, no doubling
     lcd111_command(0, 0x4f); // Contrast: dark
     lcd111_command(0, 0xe0); // Data address: 0
+    lcd111_command(0, 0x08); // Cursor: none
 
     lcd111_command(1, 0x1c); // Power control: on
     lcd111_command(1, 0x14); // Display control: on
     lcd111_command(1, 0x28); // Display lines: 2, no doubling
     lcd111_command(1, 0x4f); // Contrast: dark
     lcd111_command(1, 0xe0); // Data address: 0
+    lcd111_command(1, 0x08); // Cursor: none
 }
 
 /// Select cursor type. BIT2 inverting, BIT1 8th raster-row, BIT0 blink
@@ -177,11 +217,16 @@ void lcd111_cursor_type(uint8_t lcd_id, uint8_t cursor_type) {
     lcd111_command(lcd_id, 0b00001000 | cursor_type);
 }
 
+/// Set the data address to `address`, which may be one past the end.
+void lcd111_address_set(uint8_t lcd_id, uint8_t address) {
+    lcd111_command(lcd_id, 0b11000000); // upper part to 0 (unused in these)
+    lcd111_command(lcd_id, 0b11100000 | address);
+}
+
 /// Set the cursor position to `pos`.
 void lcd111_cursor_pos(uint8_t lcd_id, uint8_t pos) {
     if (pos > 23) pos = 23;
-    lcd111_command(lcd_id, 0b11000000); // upper part to 0 (unused in these)
-    lcd111_command(lcd_id, 0b11100000 | pos);
+    lcd111_address_set(lcd_id, pos);
 }
 
 /// Clear the display and reset the address to 0.
@@ -190,8 +235,15 @@ void lcd111_clear(uint8_t lcd_id) {
 }
 
 /// Faster version of `lcd111_clear()` if it will be >4ms before it gets text.
+/**
+ ** The display drops anything sent in the 4 ms that the clear takes, so we
+ ** don't count on knowing what's on it afterward: the next
+ ** `lcd111_set_text()` clears it again, and waits.
+ */
 void lcd111_clear_nodelay(uint8_t lcd_id) {
     lcd111_wr(lcd_id, LCD111_CMD_CLR, 0);
+    lcd111_shadow_valid[lcd_id] = 0;
+    lcd111_address[lcd_id] = 0;
 }
 
 /// Place `character` at the current cursor position in the LCD.
@@ -200,9 +252,6 @@ void lcd111_put_char(uint8_t lcd_id, char character) {
 }
 
 /// Put a text buffer into the display, for `len` characters or until NULL.
-/**
- ** This is actually _much faster_ than lcd111_set_text().
- */
 void lcd111_put_text(uint8_t lcd_id, char *text, uint8_t len) {
     uint8_t i=0;
     while (text[i] && i<len) {
@@ -211,10 +260,6 @@ void lcd111_put_text(uint8_t lcd_id, char *text, uint8_t len) {
 }
 
 /// Put `text` into the display until NULL, then pad with blanks to `len`.
-/**
- ** This is actually _much faster_ than lcd111_set_text(), so please use this
- ** whenever it's practical.
- */
 void lcd111_put_text_pad(uint8_t lcd_id, char *text, uint8_t len) {
     uint8_t i=0;
     while (text[i] && i<len) {
@@ -226,7 +271,66 @@ void lcd111_put_text_pad(uint8_t lcd_id, char *text, uint8_t len) {
     }
 }
 
+/// Show `text` on the display, instead of whatever's on it.
+/**
+ ** This looks the same as clearing the display and writing `text`, but it
+ ** only writes the characters that are different from what's on the display
+ ** already (in `lcd111_shadow`), moving the cursor over any long stretches
+ ** that aren't. So it doesn't need the clear command, or the 4 ms wait
+ ** after it, except the first time, before we know what's on the display.
+ ** Afterward, if the cursor is showing, it goes where writing the whole
+ ** text would have left it.
+ */
 void lcd111_set_text(uint8_t lcd_id, char *text) {
-    lcd111_clear(lcd_id);
-    lcd111_put_text(lcd_id, text, 24);
+    char *shadow = lcd111_shadow[lcd_id];
+    char target[LCD111_COLS];
+    uint8_t len = 0;
+    uint8_t i = 0;
+    uint8_t end;
+    uint8_t same;
+
+    if (!lcd111_shadow_valid[lcd_id]) {
+        lcd111_clear(lcd_id);
+        lcd111_put_text(lcd_id, text, LCD111_COLS);
+        return;
+    }
+
+    while (len < LCD111_COLS && text[len]) {
+        target[len] = text[len];
+        len++;
+    }
+    for (i=len; i<LCD111_COLS; i++)
+        target[i] = ' ';
+
+    i = 0;
+    while (i < LCD111_COLS) {
+        if (target[i] == shadow[i]) {
+            i++;
+            continue;
+        }
+
+        // Find the end of the changed span, running through any short
+        //  stretches of unchanged characters.
+        end = i + 1;
+        same = 0;
+        for (uint8_t j=end; j<LCD111_COLS && same<LCD111_SKIP_MIN; j++) {
+            if (target[j] == shadow[j]) {
+                same++;
+            } else {
+                end = j + 1;
+                same = 0;
+            }
+        }
+
+        if (lcd111_address[lcd_id] != i)
+            lcd111_address_set(lcd_id, i);
+        while (i < end) {
+            lcd111_data(lcd_id, target[i]);
+            i++;
+        }
+    }
+
+    if (lcd111_cursor[lcd_id] != LCD111_CURSOR_NONE &&
+            lcd111_address[lcd_id] != len)
+        lcd111_address_set(lcd_id, len);
 }
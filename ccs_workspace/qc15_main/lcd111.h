@@ -20,6 +20,8 @@
 #define LCD_TOP 1
 #define LCD_BTM 0
 
+#define LCD111_COLS 24
+
 void lcd111_init_io();
 void lcd111_init();
 void lcd111_standby(uint8_t lcd_id);
@@ -13,6 +13,16 @@
 #define SPIN_SPEED 2
 #define SAME_SPEED 32
 
+// The badge plays these from their keyframes in the flash (see
+//  `led_find_keyframes()` in leds.c), so it only has the colors of the one
+//  it falls back on when those are no good. The keyframe compiler
+//  (host/anim_compiler.c) builds with LED_ANIM_COLORS, to work them out.
+#ifdef LED_ANIM_COLORS
+#define ANIM_COLORS(colors) (colors)
+#else
+#define ANIM_COLORS(colors) 0
+#endif
+
 const rgbcolor_t flag_rainbow_colors[] = {
       {255, 0, 0}, // Red
       {255, 24, 0x00}, // Orange
@@ -22,6 +32,7 @@ const rgbcolor_t flag_rainbow_colors[] = {
       {128, 0, 128}, // Purple
 };
 
+#ifdef LED_ANIM_COLORS
 const rgbcolor_t flag_bi_colors[] = {
         {0xff, 0x00, 0xb0},
         {0,0,0},
@@ -363,7 +374,13 @@ const rgbcolor_t pink_colors[] = { // "light white fade" (normal)
         {128, 0, 128},
 };
 
+#endif
+
 /// Special case fall-back animation.
+/**
+ ** This is also what plays in place of any animation whose keyframes in the
+ ** flash are missing or bad, so it keeps its colors on the badge.
+ */
 const led_ring_animation_t anim_rainbow_spin = {
         &flag_rainbow_colors[0],
         6,
@@ -375,7 +392,7 @@ const led_ring_animation_t anim_rainbow_spin = {
 // The first FLAG_COUNT of these are the flag ones.
 const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
     {
-     &flag_rainbow_colors[0],
+     ANIM_COLORS(flag_rainbow_colors),
      6,
      DEFAULT_FLAG_ANIM_SPEED,
      HT16D_BRIGHTNESS_DEFAULT,
@@ -383,7 +400,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
      "Rainbow"
     },
     {
-     &flag_bi_colors[0],
+     ANIM_COLORS(flag_bi_colors),
      4,
      DEFAULT_FLAG_ANIM_SPEED,
      HT16D_BRIGHTNESS_DEFAULT,
@@ -391,7 +408,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
      "Bisexual"
     },
     {
-     &flag_pan_colors[0],
+     ANIM_COLORS(flag_pan_colors),
      4,
      DEFAULT_FLAG_ANIM_SPEED,
      HT16D_BRIGHTNESS_DEFAULT,
@@ -399,7 +416,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
      "Pansexual"
     },
     {
-     &flag_trans_colors[0],
+     ANIM_COLORS(flag_trans_colors),
      9,
      DEFAULT_FLAG_ANIM_SPEED,
      HT16D_BRIGHTNESS_DEFAULT,
@@ -407,7 +424,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
      "Trans",
     },
     {
-     &flag_ace_colors[0],
+     ANIM_COLORS(flag_ace_colors),
      9,
      DEFAULT_FLAG_ANIM_SPEED,
      HT16D_BRIGHTNESS_DEFAULT,
@@ -415,7 +432,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
      "Asexual",
     },
     {
-     &flag_ally_colors[0],
+     ANIM_COLORS(flag_ally_colors),
      9,
      DEFAULT_FLAG_ANIM_SPEED,
      HT16D_BRIGHTNESS_DEFAULT,
@@ -423,7 +440,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
      "Ally",
     },
      {
-      &flag_leather_colors[0],
+      ANIM_COLORS(flag_leather_colors),
       12,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -431,7 +448,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Leather"
      },
      {
-      &flag_bear_colors[0],
+      ANIM_COLORS(flag_bear_colors),
       8,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -439,7 +456,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Bear"
      },
      {
-      &flag_blue_colors[0],
+      ANIM_COLORS(flag_blue_colors),
       1,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -447,7 +464,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Blue"
      },
      {
-      &flag_lblue_colors[0],
+      ANIM_COLORS(flag_lblue_colors),
       1,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -455,7 +472,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Light blue"
      },
      {
-      &flag_green_colors[0],
+      ANIM_COLORS(flag_green_colors),
       1,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -463,7 +480,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Green"
      },
      {
-      &flag_red_colors[0],
+      ANIM_COLORS(flag_red_colors),
       1,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -471,7 +488,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Red"
      },
      {
-      &flag_yellow_colors[0],
+      ANIM_COLORS(flag_yellow_colors),
       1,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -479,7 +496,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Yellow"
      },
      {
-      &flag_pink_colors[0],
+      ANIM_COLORS(flag_pink_colors),
       1,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -487,7 +504,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Pink"
      },
     {
-      &flag_white_colors[0],
+      ANIM_COLORS(flag_white_colors),
       1,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -495,7 +512,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "White"
     },
     {
-      flag_newbie_colors,
+      ANIM_COLORS(flag_newbie_colors),
       8,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -503,7 +520,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "QC Newbie"
     },
     {
-      flag_original_colors,
+      ANIM_COLORS(flag_original_colors),
       25,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -511,7 +528,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "QC Original"
     },
     {
-      flag_regular_colors,
+      ANIM_COLORS(flag_regular_colors),
       29,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -519,7 +536,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "QC Regular"
     },
     { // Freezer flag
-      flag_freezer_colors,
+      ANIM_COLORS(flag_freezer_colors),
       18,
       DEFAULT_FLAG_ANIM_SPEED*2,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -527,7 +544,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "Frozen!"
     },
     { // Tech support flag
-      flag_techsupport_colors,
+      ANIM_COLORS(flag_techsupport_colors),
       17,
       DEFAULT_FLAG_ANIM_SPEED,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -538,7 +555,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
     // End of flags, start of others:
 
     { // The first light animation
-      &flag_white_colors[0],
+      ANIM_COLORS(flag_white_colors),
       12,
       4,
       HT16D_BRIGHTNESS_DEFAULT,
@@ -546,7 +563,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
       "firstLights"
     },
     { // ATTN ATTN ATTN!!!
-     &whitediscovery_colors[0],
+     ANIM_COLORS(whitediscovery_colors),
      3,
      6,
      HT16D_BRIGHTNESS_DEFAULT,
@@ -554,14 +571,14 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
      "whitedisc"
     },
     {
-     &blue_colors[0],
+     ANIM_COLORS(blue_colors),
      11,
      SPIN_SPEED,
      HT16D_BRIGHTNESS_DEFAULT,
      LED_ANIM_TYPE_SPIN,
      "spinBlue"
     },(led_ring_animation_t) {
-         .colors = &orange_colors[0],
+         .colors = ANIM_COLORS(orange_colors),
          .len = 11,
          .speed = SPIN_SPEED,
          .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -569,7 +586,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
          .name = "spinOrange"
      },
      (led_ring_animation_t) {
-         .colors = &yellow_colors[0],
+         .colors = ANIM_COLORS(yellow_colors),
          .len = 11,
          .speed = SPIN_SPEED,
          .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -577,7 +594,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
          .name = "spinYellow"
      },
      (led_ring_animation_t) {
-         .colors = &green_colors[0],
+         .colors = ANIM_COLORS(green_colors),
          .len = 11,
          .speed = SPIN_SPEED,
          .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -585,7 +602,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
          .name = "spinGreen"
      },
      (led_ring_animation_t) {
-         .colors = &red_colors[0],
+         .colors = ANIM_COLORS(red_colors),
          .len = 11,
          .speed = SPIN_SPEED,
          .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -593,7 +610,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
          .name = "spinRed"
      },
      (led_ring_animation_t) {
-         .colors = &white_colors[0],
+         .colors = ANIM_COLORS(white_colors),
          .len = 11,
          .speed = SPIN_SPEED,
          .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -601,7 +618,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
          .name="spinWhite"
      },
      (led_ring_animation_t) {
-         .colors = &pink_colors[0],
+         .colors = ANIM_COLORS(pink_colors),
          .len = 11,
          .speed = SPIN_SPEED,
          .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -609,7 +626,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
          .name="spinPink"
      },
     (led_ring_animation_t) {
-        .colors = &blue_colors[0],
+        .colors = ANIM_COLORS(blue_colors),
         .len = 2,
         .speed = SAME_SPEED,
         .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -617,7 +634,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
         .name = "solidBlue"
     },
     (led_ring_animation_t) {
-        .colors = &green_colors[0],
+        .colors = ANIM_COLORS(green_colors),
         .len = 2,
         .speed = SAME_SPEED,
         .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -625,7 +642,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
         .name = "solidGreen"
     },
     (led_ring_animation_t) {
-        .colors = &yellow_colors[0],
+        .colors = ANIM_COLORS(yellow_colors),
         .len = 2,
         .speed = SAME_SPEED,
         .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -633,7 +650,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
         .name = "solidYellow"
     },
     (led_ring_animation_t) {
-        .colors = &orange_colors[0],
+        .colors = ANIM_COLORS(orange_colors),
         .len = 2,
         .speed = SAME_SPEED,
         .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -641,7 +658,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
         .name = "solidOrange"
     },
     (led_ring_animation_t) {
-        .colors = &red_colors[0],
+        .colors = ANIM_COLORS(red_colors),
         .len = 2,
         .speed = SAME_SPEED,
         .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -649,7 +666,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
         .name = "solidRed"
     },
     (led_ring_animation_t) {
-        .colors = &white_colors[0],
+        .colors = ANIM_COLORS(white_colors),
         .len = 2,
         .speed = SAME_SPEED,
         .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -661,7 +678,7 @@ const led_ring_animation_t all_animations[GAME_ANIMS_LEN] = {
 /////////////////////////////////////////////////////////////
 
 const led_ring_animation_t anim_countdown_tick = (led_ring_animation_t) {
-  .colors = &flag_white_colors[0],
+  .colors = ANIM_COLORS(flag_white_colors),
   .len = 1,
   .speed = 3,
   .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -670,7 +687,7 @@ const led_ring_animation_t anim_countdown_tick = (led_ring_animation_t) {
 };
 
 const led_ring_animation_t anim_countdown_done = (led_ring_animation_t) {
-  .colors = flag_rainbow_colors,
+  .colors = ANIM_COLORS(flag_rainbow_colors),
   .len = 6,
   .speed = 40,
   .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -679,6 +696,7 @@ const led_ring_animation_t anim_countdown_done = (led_ring_animation_t) {
 };
 
 
+#ifdef LED_ANIM_COLORS
 const rgbcolor_t dl_colors[] = {
       {255, 0, 0}, // Red
       {255, 24, 0x00}, // Orange
@@ -696,9 +714,10 @@ const rgbcolor_t dl_colors[] = {
       {255, 200, 196},
       {255, 200, 196},
 };
+#endif
 
 const led_ring_animation_t anim_dl = (led_ring_animation_t) {
-  .colors = flag_white_colors,
+  .colors = ANIM_COLORS(flag_white_colors),
   .len = 1,
   .speed = 12,
   .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -707,7 +726,7 @@ const led_ring_animation_t anim_dl = (led_ring_animation_t) {
 };
 
 const led_ring_animation_t anim_dl_done = (led_ring_animation_t) {
-  .colors = dl_colors,
+  .colors = ANIM_COLORS(dl_colors),
   .len = 15,
   .speed = 1,
   .brightness = HT16D_BRIGHTNESS_DEFAULT,
@@ -716,10 +735,20 @@ const led_ring_animation_t anim_dl_done = (led_ring_animation_t) {
 };
 
 const led_ring_animation_t anim_ul = (led_ring_animation_t) {
-  .colors = flag_green_colors,
+  .colors = ANIM_COLORS(flag_green_colors),
   .len = 1,
   .speed = 12,
   .brightness = HT16D_BRIGHTNESS_DEFAULT,
   .type = LED_ANIM_TYPE_SAME,
   "Upload"
 };
+
+/// The animations that aren't in `all_animations`, in ID order after them.
+const led_ring_animation_t * const led_anims_other[LED_ANIMS_OTHER_LEN] = {
+    &anim_rainbow_spin,
+    &anim_countdown_tick,
+    &anim_countdown_done,
+    &anim_dl,
+    &anim_dl_done,
+    &anim_ul,
+};
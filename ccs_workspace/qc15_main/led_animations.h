@@ -12,6 +12,12 @@
 
 #define FLAG_COUNT 20
 
+/// Animations outside of `all_animations`, which come after them in IDs.
+#define LED_ANIMS_OTHER_LEN 6
+/// Animation IDs, for the keyframes in the flash.
+#define LED_ANIMS_LEN (GAME_ANIMS_LEN + LED_ANIMS_OTHER_LEN)
+#define LED_ANIM_ID_NONE 0xFF
+
 extern const led_ring_animation_t anim_rainbow_spin;
 extern const led_ring_animation_t all_animations[GAME_ANIMS_LEN];
 
@@ -21,4 +27,6 @@ extern const led_ring_animation_t anim_dl_done;
 extern const led_ring_animation_t anim_dl;
 extern const led_ring_animation_t anim_ul;
 
+extern const led_ring_animation_t * const led_anims_other[LED_ANIMS_OTHER_LEN];
+
 #endif /* LED_ANIMATIONS_H_ */
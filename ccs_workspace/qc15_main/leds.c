@@ -10,46 +10,48 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <driverlib.h>
+
 #include "qc15.h"
 #include "codes.h"
 #include "leds.h"
+#include "led_animations.h"
 #include "badge.h"
 #include "util.h"
+#include "s25fs.h"
+#include "flash_cache.h"
+#include "flash_layout.h"
 
 /// Signal to the main loop that a temporary animation has finished.
 uint8_t s_led_anim_done = 0;
 
-/// The type of LED ring animation: FALL, RING, SAME, or NONE.
-uint8_t led_anim_type = 0;
-/// Our position within the current frame transition (fade).
-uint16_t led_ring_anim_step = 0;
-/// Our frame in the current animation (which may include 0-padding)
-uint8_t led_ring_anim_index = 0;
-/// The number of remaining loops in the animation, or 0xFF for background.
-uint8_t led_ring_anim_loops = 0;
-/// The number of unique colors we are set up to do in our animation type.
-uint8_t led_ring_anim_num_leds = 0;
-/// The number of total frames in the animation, plus some 0-padding.
-uint8_t led_ring_anim_len_padded = 0;
-/// Custom pad length.
-uint8_t led_ring_anim_pad_loops = 0;
-///
-uint8_t led_ring_anim_elapsed = 0;
-
-/// Pointer to the current animation.
-const led_ring_animation_t *led_ring_anim_curr;
-
-/// The current colors of the LED ring.
-rgbcolor16_t led_ring_curr[18];
-/// The next frame colors (destination colors) of the LED ring.
-rgbcolor16_t led_ring_dest[18];
-/// The amount to change the ring's value every step.
-rgbdelta_t led_ring_step[18];
+/// The animations playing on the LEDs, from the bottom up.
+led_layer_t led_layers[LED_LAYER_COUNT];
+/// What the layers came out to on each LED, the last time we composed them.
+rgbcolor16_t led_colors[LED_COUNT];
+/// LEDs whose layers have come or gone, and which need composing again.
+uint32_t led_dirty = 0;
+/// LEDs whose color under all the layers (the file lights) has changed.
+uint32_t led_base_changed = 0;
+/// How many LEDs we've composed, for profiling.
+uint32_t led_composed_count = 0;
+/// Time loops to skip before the next frame boundary, while nothing changes.
+uint8_t led_idle_loops = 0;
+/// Time loops skipped so far in the current idle stretch.
+uint8_t led_idle_elapsed = 0;
+/// How many time loops we've skipped, for profiling.
+uint32_t led_frames_skipped = 0;
+/// Animations (by ID) whose keyframes we've checked since boot, and which of
+///  them were bad.
+uint8_t led_keyframes_checked[(LED_ANIMS_LEN + 7) / 8];
+uint8_t led_keyframes_bad[(LED_ANIMS_LEN + 7) / 8];
 
 #define LED_LINE_STEPS_PER_FRAME 32
 
 uint8_t led_line_frame = 0;
 uint8_t led_line_frame_step = 0;
+/// Whether the file lights' current fade has nothing but zero steps.
+uint8_t led_line_still = 0;
 uint8_t led_line_offset[6] = {0,};
 int8_t led_line_direction[6] = {1,1,1,1,1,1};
 rgbcolor16_t led_line_curr[6] = {0,};
@@ -86,17 +88,31 @@ const rgbcolor16_t colors_lessdim[6] = {
 };
 
 void led_init() {
-    memset(led_ring_curr, 0, sizeof(led_ring_curr));
-    memset(led_ring_dest, 0, sizeof(led_ring_dest));
-    memset(led_ring_step, 0, sizeof(led_ring_step));
+    memset(led_layers, 0, sizeof(led_layers));
+    memset(led_colors, 0, sizeof(led_colors));
+    led_dirty = 0;
+    led_base_changed = 0;
+    led_idle_loops = 0;
+    led_idle_elapsed = 0;
+    memset(led_keyframes_checked, 0, sizeof(led_keyframes_checked));
+    memset(led_keyframes_bad, 0, sizeof(led_keyframes_bad));
+}
+
+/// Whether all of `count` steps are zero.
+uint8_t led_steps_zero(rgbdelta_t *step, uint8_t count) {
+    for (uint8_t i=0; i<count; i++) {
+        if (step[i].r | step[i].g | step[i].b)
+            return 0;
+    }
+    return 1;
 }
 
-/// Compute the index of the next frame in the current animation.
-uint8_t next_anim_index(uint8_t index) {
+/// Compute the index of the next frame in a layer's animation.
+uint8_t next_anim_index(led_layer_t *layer, uint8_t index) {
     // If we're not looping, or if we're in the START pad,
     //  or if we're in the ANIMATION itself, then we just need to
     //  increment the index
-    return (index + 1) % led_ring_anim_len_padded;
+    return (index + 1) % layer->len_padded;
 }
 
 /// Place colors into a color frame element, accounting for padding.
@@ -118,79 +134,411 @@ uint8_t next_anim_index(uint8_t index) {
  ** So the math works!
  **
  **/
-void led_stage_color(rgbcolor16_t *dest_color_frame, uint8_t frame_index,
-                     uint8_t led_index) {
+void led_stage_color(led_layer_t *layer, rgbcolor16_t *dest_color_frame,
+                     uint8_t frame_index, uint8_t led_index) {
     uint16_t color_index = 0;
 
     // Here, we do a little bit of sneakiness. We want to shift the pad around,
     //  just a bit, so that at index 0 everything is dark.
     // So if we're passed frame_index 0, we convert it to frame_index
-    //  led_ring_anim_len_padded-1. (basically, we subtract 1 modulo
-    //  led_ring_anim_len_padded).
+    //  len_padded-1. (basically, we subtract 1 modulo len_padded).
 
-    frame_index = (frame_index + led_ring_anim_len_padded - 1)
-                                            % led_ring_anim_len_padded;
+    frame_index = (frame_index + layer->len_padded - 1) % layer->len_padded;
 
     if (frame_index >= led_index) {
         color_index = frame_index - led_index;
     } else {
         // frame_index - led_number < 0, so:
-        color_index = led_ring_anim_len_padded + frame_index - led_index;
+        color_index = layer->len_padded + frame_index - led_index;
     }
 
-    if (color_index >= led_ring_anim_curr->len) {
+    if (color_index >= layer->anim->len) {
         // It's off in the pad.
         memcpy(dest_color_frame, &color_off, sizeof(rgbcolor16_t));
     } else {
         // It's a color!
-        dest_color_frame->r = led_ring_anim_curr->colors[color_index].r << 7;
-        dest_color_frame->g = led_ring_anim_curr->colors[color_index].g << 7;
-        dest_color_frame->b = led_ring_anim_curr->colors[color_index].b << 7;
+        dest_color_frame->r = layer->anim->colors[color_index].r << 7;
+        dest_color_frame->g = layer->anim->colors[color_index].g << 7;
+        dest_color_frame->b = layer->anim->colors[color_index].b << 7;
     }
 }
 
-/// Set up the current frame's color sets (i.e. dest and step).
+/// Work out the reciprocal of `speed` for `led_div_speed()`.
 /**
- ** This function is located in RAM because it has lots of low-performance
- **  and power-hungry division operations.
+ ** The MSP430 has a hardware multiplier, but no divider, so a division is a
+ ** long library call. Instead, we divide by multiplying by 2^shift/speed,
+ ** rounded up, and shifting. With shift at 15 plus the bits in `speed`, that
+ ** gives exactly the same (truncated) result as dividing, for anything up to
+ ** 2^15, which all of our 15-bit color values are. This is the only division
+ ** we do for a whole animation.
  */
-__attribute__((ramfunc))
-void led_load_colors() {
-    for (uint8_t i=0; i<led_ring_anim_num_leds; i++) {
-        led_stage_color(&led_ring_dest[i],
-                        next_anim_index(led_ring_anim_index),
-                        i);
+void led_set_speed(led_layer_t *layer, uint8_t speed) {
+    uint8_t bits = 0;
+
+    if (!speed)
+        speed = 1;
+    while ((1 << bits) < speed)
+        bits++;
+    layer->speed_shift = 15 + bits;
+    layer->speed_recip = (1UL << layer->speed_shift) / speed + 1;
+}
+
+/// Divide a color difference by a layer's animation speed, rounding
+///  toward zero like `/` does.
+int_fast16_t led_div_speed(led_layer_t *layer, int_fast16_t delta) {
+    if (delta < 0)
+        return -(int_fast16_t) (((uint32_t) -delta * layer->speed_recip)
+                                >> layer->speed_shift);
+    return ((uint32_t) delta * layer->speed_recip) >> layer->speed_shift;
+}
 
-        led_ring_step[i].r = ((int_fast16_t) led_ring_dest[i].r - (int_fast16_t)led_ring_curr[i].r) / led_ring_anim_curr->speed;
-        led_ring_step[i].g = ((int_fast16_t) led_ring_dest[i].g - (int_fast16_t)led_ring_curr[i].g) / led_ring_anim_curr->speed;
-        led_ring_step[i].b = ((int_fast16_t) led_ring_dest[i].b - (int_fast16_t)led_ring_curr[i].b) / led_ring_anim_curr->speed;
+/// Get an animation's ID for its keyframes, or LED_ANIM_ID_NONE.
+uint8_t led_anim_id(const led_ring_animation_t *anim) {
+    if (anim >= all_animations && anim < &all_animations[GAME_ANIMS_LEN])
+        return anim - all_animations;
+    for (uint8_t i=0; i<LED_ANIMS_OTHER_LEN; i++) {
+        if (led_anims_other[i] == anim)
+            return GAME_ANIMS_LEN + i;
     }
+    return LED_ANIM_ID_NONE;
 }
 
-/// Send the colors to the underlying controller.
-void led_display_colors() {
-    switch(led_anim_type) {
+/// CRC16 of the frame tables that a layer's keyframes point to.
+/**
+ ** This reads every frame through the layer's `dest` and `step`, so it's
+ ** only for before they're set up.
+ */
+uint16_t led_keyframes_crc(led_layer_t *layer) {
+    led_keyframes_t *keyframes = &layer->keyframes;
+    uint16_t colors_len = layer->num_leds * sizeof(rgbcolor16_t);
+    uint16_t frames = keyframes->len_padded_loop;
+    uint32_t address = keyframes->loop_addr;
+
+    CRC_setSeed(CRC_BASE, QC15_CRC_SEED);
+    for (uint8_t table=0; table<2; table++) {
+        for (uint16_t i=0; i<frames; i++) {
+            s25fs_read_data((uint8_t *) layer->dest, address, colors_len);
+            s25fs_read_data((uint8_t *) layer->step, address + colors_len,
+                            colors_len);
+            for (uint16_t b=0; b<colors_len; b++)
+                CRC_set8BitData(CRC_BASE, ((uint8_t *) layer->dest)[b]);
+            for (uint16_t b=0; b<colors_len; b++)
+                CRC_set8BitData(CRC_BASE, ((uint8_t *) layer->step)[b]);
+            address += colors_len * 2;
+        }
+        if (keyframes->last_addr == keyframes->loop_addr)
+            break;
+        frames = keyframes->len_padded_last;
+        address = keyframes->last_addr;
+    }
+    return CRC_getResult(CRC_BASE);
+}
+
+/// Look up a layer's animation's precompiled frames in the flash.
+/**
+ ** The frames are only good if they were compiled with the same length and
+ ** speed as the animation in the firmware, and if we're playing it the same
+ ** way: with its own type, and the default padding. The first time each
+ ** animation plays after boot, we also read all of its frames back to check
+ ** their CRC, and remember the result, since they don't change while we're
+ ** up. If they're no good, or if the flash is locked out, `led_load_colors()`
+ ** can only work the frames out itself for an animation that we have the
+ ** colors of.
+ */
+void led_find_keyframes(led_layer_t *layer) {
+    uint8_t id = led_anim_id(layer->anim);
+    led_keyframes_t *keyframes = &layer->keyframes;
+
+    layer->keyframes_ok = 0;
+    if (id == LED_ANIM_ID_NONE || (global_flash_lockout & FLASH_LOCKOUT_READ))
+        return;
+    if (check_id_buf(id, led_keyframes_bad))
+        return;
+
+    flash_cache_read((uint8_t *) keyframes,
+                     FLASH_ADDR_LED_ANIMS + id*sizeof(led_keyframes_t),
+                     sizeof(led_keyframes_t));
+    if (keyframes->len != layer->anim->len ||
+            keyframes->speed != layer->anim->speed ||
+            keyframes->type != layer->type ||
+            keyframes->num_leds != layer->num_leds ||
+            keyframes->len_padded_loop !=
+                    layer->anim->len + layer->pad_loops ||
+            keyframes->len_padded_last != layer->len_padded)
+        return;
+    if (!check_id_buf(id, led_keyframes_checked)) {
+        set_id_buf(id, led_keyframes_checked);
+        if (led_keyframes_crc(layer) != keyframes->frames_crc) {
+            set_id_buf(id, led_keyframes_bad);
+            return;
+        }
+    }
+    layer->keyframes_ok = 1;
+}
+
+/// Read frame `index`, at the current padded length, from the keyframes.
+/**
+ ** The frames stream through in order, and each is read once per loop, so
+ ** they go straight to the flash rather than through the cache.
+ */
+void led_read_keyframe(led_layer_t *layer, rgbcolor16_t *dest,
+                       rgbdelta_t *step, uint8_t index) {
+    uint16_t colors_len = layer->num_leds * sizeof(rgbcolor16_t);
+    uint32_t address;
+
+    if (layer->len_padded == layer->keyframes.len_padded_loop)
+        address = layer->keyframes.loop_addr;
+    else
+        address = layer->keyframes.last_addr;
+    address += (uint32_t) index * colors_len * 2;
+
+    s25fs_read_data((uint8_t *) dest, address, colors_len);
+    if (step)
+        s25fs_read_data((uint8_t *) step, address + colors_len, colors_len);
+}
+
+/// Set up a layer's current frame's color sets (i.e. dest and step).
+void led_load_colors(led_layer_t *layer) {
+    if (layer->keyframes_ok) {
+        led_read_keyframe(layer, layer->dest, layer->step, layer->index);
+    } else {
+        for (uint8_t i=0; i<layer->num_leds; i++) {
+            led_stage_color(layer, &layer->dest[i],
+                            next_anim_index(layer, layer->index),
+                            i);
+
+            layer->step[i].r = led_div_speed(layer, (int_fast16_t) layer->dest[i].r - (int_fast16_t)layer->curr[i].r);
+            layer->step[i].g = led_div_speed(layer, (int_fast16_t) layer->dest[i].g - (int_fast16_t)layer->curr[i].g);
+            layer->step[i].b = led_div_speed(layer, (int_fast16_t) layer->dest[i].b - (int_fast16_t)layer->curr[i].b);
+        }
+    }
+    layer->still = led_steps_zero(layer->step, layer->num_leds);
+}
+
+/// Which of a layer's colors goes on LED `led`.
+/**
+ ** SAME animations put their one color everywhere. SPIN animations go
+ ** around the ring, and FALL animations go down both sides of it at once.
+ ** On the center line, the colors are spread out from left to right.
+ */
+uint8_t led_layer_index(led_layer_t *layer, uint8_t led) {
+    if (led >= LED_RING_COUNT)
+        return (led - LED_RING_COUNT) * layer->num_leds / 6;
+    switch(layer->type) {
     case LED_ANIM_TYPE_SAME:
-        ht16d_all_one_color_ring_only(led_ring_curr[0].r >> 8,
-                                    led_ring_curr[0].g >> 8,
-                                    led_ring_curr[0].b >> 8);
-        break;
+        return 0;
     case LED_ANIM_TYPE_FALL:
-        for (uint8_t i=0; i<9; i++) {
-            memcpy(&led_ring_curr[17-i], &led_ring_curr[i], sizeof(rgbcolor16_t));
+        return led < 9 ? led : 17 - led;
+    }
+    return led;
+}
+
+/// Which of the LEDs that `layer` covers show a change in its colors.
+uint32_t led_layer_leds_changed(led_layer_t *layer) {
+    uint32_t leds = 0;
+
+    for (uint8_t led=0; led<LED_COUNT; led++) {
+        if ((layer->mask & (1UL << led)) &&
+                (layer->changed & (1UL << led_layer_index(layer, led))))
+            leds |= 1UL << led;
+    }
+    return leds;
+}
+
+/// Blend `layer`'s color for `led` over `color`.
+void led_blend(rgbcolor16_t *color, led_layer_t *layer, uint8_t led) {
+    rgbcolor16_t *over = &layer->curr[led_layer_index(layer, led)];
+    uint16_t over_rgb[3] = {over->r, over->g, over->b};
+    uint16_t *rgb = (uint16_t *) color;
+
+    for (uint8_t i=0; i<3; i++) {
+        // SAME animations have always gone out at half the value:
+        if (layer->type == LED_ANIM_TYPE_SAME)
+            over_rgb[i] >>= 1;
+
+        if (layer->blend == LED_BLEND_ADD) {
+            rgb[i] = rgb[i] + over_rgb[i] > 0x7FFF ? 0x7FFF
+                                                   : rgb[i] + over_rgb[i];
+        } else if (layer->blend == LED_BLEND_MAX) {
+            if (over_rgb[i] > rgb[i])
+                rgb[i] = over_rgb[i];
+        } else {
+            rgb[i] = over_rgb[i];
         }
-        // fall through...
-    case LED_ANIM_TYPE_SPIN:
-        ht16d_set_colors(0, 18, led_ring_curr);
-        break;
     }
 }
 
-void led_set_anim_none(uint8_t clear_bg) {
-    led_anim_type = LED_ANIM_TYPE_NONE;
-    led_ring_anim_loops = 0;
+/// Work out the color of `led` from the layers, into `led_colors`.
+/**
+ ** We start from the top layer with LED_BLEND_REPLACE over it, since
+ ** nothing under that shows. If there isn't one, we start from the base:
+ ** the file lights on the center line, and off everywhere else.
+ */
+void led_compose_one(uint8_t led) {
+    rgbcolor16_t *color = &led_colors[led];
+    int8_t bottom;
+
+    for (bottom=LED_LAYER_COUNT-1; bottom>=0; bottom--) {
+        if (led_layers[bottom].type &&
+                (led_layers[bottom].mask & (1UL << led)) &&
+                led_layers[bottom].blend == LED_BLEND_REPLACE)
+            break;
+    }
+
+    if (bottom < 0) {
+        if (led >= LED_RING_COUNT && badge_conf.file_lights_on)
+            memcpy(color, &led_line_curr[led - LED_RING_COUNT],
+                   sizeof(rgbcolor16_t));
+        else
+            memcpy(color, &color_off, sizeof(rgbcolor16_t));
+        bottom = 0;
+    }
+
+    for (uint8_t l=bottom; l<LED_LAYER_COUNT; l++) {
+        if (led_layers[l].type && (led_layers[l].mask & (1UL << led)))
+            led_blend(color, &led_layers[l], led);
+    }
+    led_composed_count++;
+}
+
+/// Compose the LEDs whose layers changed, and send them to the controller.
+/**
+ ** A change in a layer only matters on the LEDs it covers that aren't
+ ** hidden by a layer above it, so we look from the top down, and only work
+ ** out the colors of the LEDs where something visible changed. The LED
+ ** controller driver only sends the rows that changed, in turn.
+ */
+void led_compose() {
+    uint32_t dirty = led_dirty;
+    uint32_t covered = 0;
+
+    for (int8_t l=LED_LAYER_COUNT-1; l>=0; l--) {
+        led_layer_t *layer = &led_layers[l];
+
+        if (!layer->type)
+            continue;
+        if (layer->changed)
+            dirty |= led_layer_leds_changed(layer) & ~covered;
+        layer->changed = 0;
+        if (layer->blend == LED_BLEND_REPLACE)
+            covered |= layer->mask;
+    }
+    dirty |= led_base_changed & ~covered;
+    led_dirty = 0;
+    led_base_changed = 0;
+
+    if (!dirty)
+        return;
+    for (uint8_t led=0; led<LED_COUNT; led++) {
+        if (dirty & (1UL << led)) {
+            led_compose_one(led);
+            ht16d_put_colors(led, 1, &led_colors[led]);
+        }
+    }
+    ht16d_send_gray();
+}
+
+/// Set the LED controller's brightness to the top animation's.
+void led_update_brightness() {
+    for (int8_t l=LED_LAYER_COUNT-1; l>=0; l--) {
+        if (led_layers[l].type) {
+            ht16d_set_global_brightness(led_layers[l].anim->brightness);
+            return;
+        }
+    }
+}
+
+/// Catch up on any time loops skipped by `led_timestep()`, and stop skipping.
+/**
+ ** Nothing changed in the skipped time loops, except how far along the
+ ** fades are, so this is all we need before we can change any of them.
+ */
+void led_wake() {
+    if (led_idle_elapsed) {
+        for (uint8_t l=0; l<LED_LAYER_COUNT; l++) {
+            if (led_layers[l].type)
+                led_layers[l].anim_step += led_idle_elapsed;
+        }
+        if (badge_conf.file_lights_on)
+            led_line_frame_step += led_idle_elapsed;
+    }
+    led_idle_elapsed = 0;
+    led_idle_loops = 0;
+}
+
+/// Compose and send every LED again, after something drew on them directly.
+/**
+ ** `led_colors` is what we last sent, and `led_compose()` only sends what
+ ** differs from it, so anything that goes around us to the LED controller
+ ** (like `ht16d_all_one_color()`) has to call this once it's done. That
+ ** also ends any idle stretch, or the repaint would wait for the next frame
+ ** boundary.
+ */
+void led_invalidate() {
+    led_wake();
+    led_dirty = LED_MASK_ALL;
+}
 
-    ht16d_all_one_color_ring_only(0, 0, 0);
+/// Work out how many time loops we can skip until something changes.
+/**
+ ** If every fade in progress has only zero steps (a solid color, or one too
+ ** close to the next for a step), the LEDs will stay exactly as they are
+ ** until the next frame boundary, the soonest of which is when we have to
+ ** wake up.
+ */
+uint8_t led_idle_schedule() {
+    uint8_t loops = 0xFF;
+    uint8_t playing = 0;
+    int16_t left;
+
+    for (uint8_t l=0; l<LED_LAYER_COUNT; l++) {
+        led_layer_t *layer = &led_layers[l];
+
+        if (!layer->type)
+            continue;
+        if (!layer->still)
+            return 0;
+        playing = 1;
+        // The boundary comes on the time loop that brings anim_step to speed.
+        left = (int16_t) layer->anim->speed - 1 - layer->anim_step;
+        if (left <= 0)
+            return 0;
+        if (left < loops)
+            loops = left;
+    }
+    if (badge_conf.file_lights_on) {
+        if (!led_line_still)
+            return 0;
+        playing = 1;
+        left = LED_LINE_STEPS_PER_FRAME - 1 - led_line_frame_step;
+        if (left <= 0)
+            return 0;
+        if (left < loops)
+            loops = left;
+    }
+    // With nothing playing, there's nothing to skip.
+    return playing ? loops : 0;
+}
+
+/// Stop the animation on a layer, showing what's under it.
+void led_set_layer_none(uint8_t layer_id) {
+    led_layer_t *layer = &led_layers[layer_id];
+
+    if (!layer->type)
+        return;
+    led_wake();
+    layer->type = LED_ANIM_TYPE_NONE;
+    layer->loops = 0;
+    led_dirty |= layer->mask;
+    led_update_brightness();
+}
+
+/// Stop all the animations, and turn the ring off.
+void led_set_anim_none(uint8_t clear_bg) {
+    for (uint8_t l=0; l<LED_LAYER_COUNT; l++)
+        led_set_layer_none(l);
+    led_dirty |= LED_MASK_RING;
+    led_compose();
 
     if (clear_bg) {
         // Clear the background animation, too.
@@ -198,6 +546,122 @@ void led_set_anim_none(uint8_t clear_bg) {
     }
 }
 
+/// Set a layer up to play `anim` from the start, with its keyframes if
+///  they're good.
+void led_layer_setup(led_layer_t *layer, const led_ring_animation_t *anim,
+                     uint8_t anim_type, uint8_t extra_padding) {
+    layer->anim = anim;
+    led_set_speed(layer, anim->speed);
+    layer->type = anim_type? anim_type : anim->type;
+    layer->anim_step = 0;
+    layer->index = 0;
+
+    if (layer->type == LED_ANIM_TYPE_SAME) {
+        layer->num_leds = 1;
+    } else if (layer->type == LED_ANIM_TYPE_SPIN) {
+        layer->num_leds = 18;
+    } else if (layer->type == LED_ANIM_TYPE_FALL) {
+        layer->num_leds = 9;
+    }
+
+    // Padding automation and override:
+    if (extra_padding) {
+        layer->pad_loops = extra_padding;
+    } else if (layer->type == LED_ANIM_TYPE_SAME) {
+        layer->pad_loops = 1;
+    } else if (layer->type == LED_ANIM_TYPE_SPIN){
+        layer->pad_loops = layer->num_leds - (anim->len % layer->num_leds);
+    } else {
+        // waterfall
+        if (anim->len >=5)
+            layer->pad_loops = 4;
+        else
+            layer->pad_loops = layer->num_leds - anim->len;
+    }
+
+    // Here, we apply a pad to the animation. This is a number of dummy
+    //  colors at the end of the list of colors, which the function
+    //  `led_stage_color()` interprets as OFF.
+    // Sometimes, our looping logic may allow us to skip some or all of the
+    //  padding colors.
+    layer->len_padded = anim->len + layer->num_leds;
+
+    led_find_keyframes(layer);
+}
+
+/// Start an animation on one of the LED layers.
+/**
+ ** The layers are drawn from the bottom up (LED_LAYER_BG first), each over
+ ** the LEDs in its `mask`, and blended with the layers under it according to
+ ** its `blend`. Whatever else is playing keeps going underneath, and shows
+ ** again when this animation is done, so a temporary animation doesn't
+ ** restart the background.
+ **
+ ** Infinitely-looping animations on LED_LAYER_BG are saved as the
+ ** background (`led_ring_anim_bg`), to restore after sleep or a reboot.
+ **
+ ** See `led_set_anim()` for the rest of the parameters.
+ **
+ ** \param layer_id The layer to play the animation on: LED_LAYER_...
+ ** \param blend How to draw it over the layers below: LED_BLEND_...
+ ** \param mask Which LEDs to draw it on: LED_MASK_..., or any other set of
+ **             bits for LEDs.
+ */
+void led_set_layer(uint8_t layer_id, const led_ring_animation_t *anim,
+                   uint8_t anim_type, uint8_t loops, uint8_t extra_padding,
+                   uint8_t blend, uint32_t mask) {
+    led_layer_t *layer = &led_layers[layer_id];
+
+    led_wake();
+    // Whatever it covered before needs to be drawn again, too:
+    if (layer->type)
+        led_dirty |= layer->mask;
+
+    layer->blend = blend;
+    layer->mask = mask;
+
+    if (loops && loops != 0xFF) {
+        loops--; // It's confusing for a param 1 to play the animation twice.
+    }
+    layer->loops = loops;
+
+    led_layer_setup(layer, anim, anim_type, extra_padding);
+
+    // Immediately save infinitely-looping animations to the background.
+    if (layer_id == LED_LAYER_BG && loops == 0xFF) {
+        led_ring_anim_bg = anim;
+        led_ring_anim_pad_loops_bg = layer->pad_loops;
+        led_anim_type_bg = layer->type;
+    }
+
+    if (!layer->keyframes_ok && !anim->colors) {
+        // We don't have the colors to work this one out from, so play the
+        //  fallback instead. It's still saved as the background above, so
+        //  it can come back if its keyframes are fixed.
+        led_layer_setup(layer, &anim_rainbow_spin, LED_ANIM_TYPE_NONE, 0);
+    }
+
+    // Each animation starts from OFF on its own layer.
+    // This is taken care of by our padding, and some tricky logic inside of
+    //  led_stage_color().
+    if (layer->keyframes_ok) {
+        // The last frame's destination is the first frame.
+        led_read_keyframe(layer, layer->curr, 0, layer->len_padded - 1);
+    } else {
+        for (uint8_t led=0; led<layer->num_leds; led++) {
+            led_stage_color(layer, &layer->curr[led], layer->index, led);
+        }
+    }
+
+    // Set the destination and steps for each of the LEDs in play:
+    led_load_colors(layer);
+
+    // Write the initial colors to the LED controller:
+    led_dirty |= mask;
+    led_compose();
+    led_update_brightness();
+}
+
 /// Set the current LED ring animation.
 /**
  ** By default, this will attempt to insert a sane length of 0-padding between
@@ -216,6 +680,10 @@ void led_set_anim_none(uint8_t clear_bg) {
  ** overriding it may cause undesired behavior. See the description of the
  ** parameter for more details on the constraints.
  **
+ ** Backgrounds play on LED_LAYER_BG, and temporary animations over the whole
+ ** ring on LED_LAYER_TEMP, so the background keeps going under them. Use
+ ** `led_set_layer()` to blend an animation, or to put it on other LEDs.
+ **
  ** \param anim Pointer to the animation to load.
  ** \param anim_type The type of the animation, which may be
  **                  LED_ANIM_TYPE_SPIN, LED_ANIM_TYPE_SAME, or
@@ -240,107 +708,55 @@ void led_set_anim_none(uint8_t clear_bg) {
  */
 void led_set_anim(const led_ring_animation_t *anim, uint8_t anim_type,
                   uint8_t loops, uint8_t extra_padding) {
-    if (led_ring_anim_loops == 0xFF && loops != 0xFF) {
-        // If the current animation is loop-forever (background), and this
-        //  one is not, then we should store it.
-        led_ring_anim_bg = led_ring_anim_curr;
-        led_ring_anim_pad_loops_bg = led_ring_anim_pad_loops;
-        led_anim_type_bg = led_anim_type;
-    }
-
-    led_ring_anim_curr = anim;
-    led_anim_type = anim_type? anim_type : led_ring_anim_curr->type;
-    led_ring_anim_step = 0;
-    led_ring_anim_index = 0;
-
-    if (loops && loops != 0xFF) {
-        loops--; // It's confusing for a param 1 to play the animation twice.
-    }
-    led_ring_anim_loops = loops;
-
-    if (led_anim_type == LED_ANIM_TYPE_SAME) {
-        led_ring_anim_num_leds = 1;
-    } else if (led_anim_type == LED_ANIM_TYPE_SPIN) {
-        led_ring_anim_num_leds = 18;
-    } else if (led_anim_type == LED_ANIM_TYPE_FALL) {
-        led_ring_anim_num_leds = 9;
-    }
-
-    // Padding automation and override:
-    if (extra_padding) {
-        led_ring_anim_pad_loops = extra_padding;
-    } else if (led_anim_type == LED_ANIM_TYPE_SAME) {
-        led_ring_anim_pad_loops = 1;
-    } else if (led_anim_type == LED_ANIM_TYPE_SPIN){
-        led_ring_anim_pad_loops = led_ring_anim_num_leds -
-                (led_ring_anim_curr->len % led_ring_anim_num_leds);
-    } else {
-        // waterfall
-        if (led_ring_anim_curr->len >=5)
-            led_ring_anim_pad_loops = 4;
-        else
-            led_ring_anim_pad_loops = led_ring_anim_num_leds - led_ring_anim_curr->len;
-    }
-
-    // Here, we apply a pad to the animation. This is a number of dummy
-    //  colors at the end of the list of colors, which the function
-    //  `led_stage_color()` interprets as OFF.
-    // Sometimes, our looping logic may allow us to skip some or all of the
-    //  padding colors.
-    led_ring_anim_len_padded = led_ring_anim_curr->len + led_ring_anim_num_leds;
+    led_set_layer(loops == 0xFF ? LED_LAYER_BG : LED_LAYER_TEMP, anim,
+                  anim_type, loops, extra_padding, LED_BLEND_REPLACE,
+                  LED_MASK_RING);
+}
 
-    // We don't allow animations to interleave with each other, so our first
-    //  step is always going to be to set the current colors to OFF.
-    // This is taken care of by our padding, and some tricky logic inside of
-    //  led_stage_color().
-    for (uint8_t led=0; led<led_ring_anim_num_leds; led++) {
-        led_stage_color(&led_ring_curr[led], led_ring_anim_index, led);
+/// Whether any of the first `count` layers (from the bottom) are playing.
+uint8_t led_layers_playing(uint8_t count) {
+    for (uint8_t l=0; l<count; l++) {
+        if (led_layers[l].type)
+            return 1;
     }
-
-    // Immediately save infinitely-looping animations to the background.
-    if (loops == 0xFF) {
-        led_ring_anim_bg = led_ring_anim_curr;
-        led_ring_anim_pad_loops_bg = led_ring_anim_pad_loops;
-        led_anim_type_bg = led_anim_type;
-    }
-
-    // Set the destination and steps for each of the LEDs in play:
-    led_load_colors();
-
-    // Write the initial colors to the LED controller:
-    led_display_colors();
-    // Now, the LEDs are blank. Make our brightness change.
-    ht16d_set_global_brightness(led_ring_anim_curr->brightness);
+    return 0;
 }
 
-void led_ring_timestep() {
-    if (!led_anim_type) {
+/// Move a layer's animation along one time loop.
+void led_layer_timestep(uint8_t layer_id) {
+    led_layer_t *layer = &led_layers[layer_id];
+
+    if (!layer->type) {
         // LED_ANIM_TYPE_NONE
         return;
     }
 
-    led_ring_anim_step++;
-    if (led_ring_anim_step >= led_ring_anim_curr->speed) {
+    layer->anim_step++;
+    if (layer->anim_step >= layer->anim->speed) {
         // fade is complete. Time for the destination.
-        led_ring_anim_step = 0;
+        layer->anim_step = 0;
 
-        led_ring_anim_index++;
+        layer->index++;
 
-        if (led_ring_anim_pad_loops && led_ring_anim_loops &&
-                led_ring_anim_index == led_ring_anim_curr->len) {
-            led_ring_anim_len_padded = led_ring_anim_curr->len + led_ring_anim_pad_loops;
-        } else if (led_ring_anim_pad_loops &&
-                led_ring_anim_index == led_ring_anim_curr->len) {
-            led_ring_anim_len_padded = led_ring_anim_curr->len + led_ring_anim_num_leds;
+        if (layer->pad_loops && layer->loops &&
+                layer->index == layer->anim->len) {
+            layer->len_padded = layer->anim->len + layer->pad_loops;
+        } else if (layer->pad_loops &&
+                layer->index == layer->anim->len) {
+            layer->len_padded = layer->anim->len + layer->num_leds;
         }
 
         // Go ahead and set our current color to the desired destination.
         //  This makes sure that we reach the _exact_ destination color every
         //  time, rather than opening ourselves up to propagation error.
-        memcpy(&led_ring_curr, &led_ring_dest,
-               sizeof(rgbcolor16_t) * led_ring_anim_num_leds);
-
-        led_display_colors();
+        for (uint8_t i=0; i<layer->num_leds; i++) {
+            if (memcmp(&layer->curr[i], &layer->dest[i],
+                       sizeof(rgbcolor16_t))) {
+                memcpy(&layer->curr[i], &layer->dest[i],
+                       sizeof(rgbcolor16_t));
+                layer->changed |= 1UL << i;
+            }
+        }
 
         // We conclude our current animation if, EITHER:
         //  a) We're looping with more loops left to go,
@@ -350,44 +766,39 @@ void led_ring_timestep() {
 
         // We conclude the current cycle of the animation if the next shift
         //  will cause us to overflow off the end of the pad.
-        if (led_ring_anim_index == led_ring_anim_len_padded) {
+        if (layer->index == layer->len_padded) {
             // animation is over.
-            if (led_ring_anim_loops) {
-                if (led_ring_anim_loops != 0xFF) {
-                    led_ring_anim_loops--;
+            if (layer->loops) {
+                if (layer->loops != 0xFF) {
+                    layer->loops--;
                 }
                 // Loop!
-                led_ring_anim_index = 0;
+                layer->index = 0;
             } else {
-                if (led_ring_anim_bg) {
-                    // If we have a background animation stored, that this one
-                    //  was briefly superseding, then go ahead and start it
-                    //  up again.
-                    led_set_anim(led_ring_anim_bg, led_anim_type_bg,
-                                 0xff, led_ring_anim_pad_loops_bg);
-                } else {
-                    led_anim_type = LED_ANIM_TYPE_NONE;
+                // Whatever was under it shows again, without restarting.
+                led_set_layer_none(layer_id);
+                // It's only the end of the animation if there isn't one.
+                if (!led_layers_playing(layer_id))
                     s_led_anim_done = 1;
-                    // No need to load any new colors, since the pad has taken care
-                    //  of turning all the lights off for us.
-                }
                 return;
             }
         }
 
         // Stage the next color sets
         //  i.e., set dest and steps
-        led_load_colors();
+        led_load_colors(layer);
 
     } else {
         // Still fading.
 
-        for (uint8_t i=0; i<led_ring_anim_num_leds; i++) {
-            led_ring_curr[i].r+= led_ring_step[i].r;
-            led_ring_curr[i].g+= led_ring_step[i].g;
-            led_ring_curr[i].b+= led_ring_step[i].b;
+        for (uint8_t i=0; i<layer->num_leds; i++) {
+            if (!(layer->step[i].r | layer->step[i].g | layer->step[i].b))
+                continue;
+            layer->curr[i].r+= layer->step[i].r;
+            layer->curr[i].g+= layer->step[i].g;
+            layer->curr[i].b+= layer->step[i].b;
+            layer->changed |= 1UL << i;
         }
-        led_display_colors();
     }
 }
 
@@ -420,6 +831,7 @@ uint8_t led_line_next_offset(uint8_t file_id) {
 }
 
 void led_activate_file_lights() {
+    led_wake();
     led_line_frame_step = 0;
     led_line_frame = 0;
     for (uint8_t i=0; i<6; i++) {
@@ -434,6 +846,8 @@ void led_activate_file_lights() {
         led_line_step[i].g = ((int_fast16_t) led_line_dest[i].g - (int_fast16_t)led_line_curr[i].g) / LED_LINE_STEPS_PER_FRAME;
         led_line_step[i].b = ((int_fast16_t) led_line_dest[i].b - (int_fast16_t)led_line_curr[i].b) / LED_LINE_STEPS_PER_FRAME;
     }
+    led_line_still = led_steps_zero(led_line_step, 6);
+    led_base_changed |= LED_MASK_LINE;
 }
 
 void led_line_timestep() {
@@ -442,6 +856,7 @@ void led_line_timestep() {
         for (uint8_t i=0; i<6; i++) {
             led_line_curr[i] = led_line_dest[i];
         }
+        led_base_changed |= LED_MASK_LINE;
 
         led_line_frame_step = 0;
         led_line_frame++;
@@ -471,23 +886,45 @@ void led_line_timestep() {
             led_line_step[i].g = ((int_fast16_t) led_line_dest[i].g - (int_fast16_t)led_line_curr[i].g) / LED_LINE_STEPS_PER_FRAME;
             led_line_step[i].b = ((int_fast16_t) led_line_dest[i].b - (int_fast16_t)led_line_curr[i].b) / LED_LINE_STEPS_PER_FRAME;
         }
+        led_line_still = led_steps_zero(led_line_step, 6);
 
     } else {
         for (uint8_t i=0; i<6; i++) {
+            if (!(led_line_step[i].r | led_line_step[i].g | led_line_step[i].b))
+                continue;
             led_line_curr[i].r+= led_line_step[i].r;
             led_line_curr[i].g+= led_line_step[i].g;
             led_line_curr[i].b+= led_line_step[i].b;
+            led_base_changed |= 1UL << (LED_RING_COUNT + i);
         }
     }
-    ht16d_set_colors(18, 6, led_line_curr);
 }
 
 /// LED timestep function, which should be called 32x per second.
+/**
+ ** When nothing on the LEDs will change until the next frame boundary, we
+ ** skip the time loops until then, without touching the layers or the LED
+ ** controller; see `led_idle_schedule()`. Anything that changes the LEDs
+ ** from outside the layers calls `led_wake()` first, directly or through
+ ** `led_invalidate()`.
+ */
 void led_timestep() {
     if (qc15_mode == QC15_MODE_SLEEP) {
         return;
     }
-    led_ring_timestep();
+    if (led_idle_loops) {
+        led_idle_loops--;
+        led_idle_elapsed++;
+        led_frames_skipped++;
+        return;
+    }
+    led_wake();
+
+    for (uint8_t l=0; l<LED_LAYER_COUNT; l++)
+        led_layer_timestep(l);
     if (badge_conf.file_lights_on)
         led_line_timestep();
+    led_compose();
+
+    led_idle_loops = led_idle_schedule();
 }
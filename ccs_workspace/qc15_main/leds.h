@@ -20,13 +20,41 @@
 
 #define DEFAULT_FLAG_ANIM_SPEED 10
 
+/// All the LEDs: the ring (edge lighting), then the center line (up lighting).
+#define LED_COUNT 24
+#define LED_RING_COUNT 18
+
+// LED masks, with one bit per LED, in the order above:
+#define LED_MASK_RING 0x0003FFFFUL
+#define LED_MASK_LINE 0x00FC0000UL
+#define LED_MASK_ALL (LED_MASK_RING | LED_MASK_LINE)
+
+// LED layers, from the bottom up:
+/// The background animation, which loops forever.
+#define LED_LAYER_BG 0
+/// Temporary animations from the game.
+#define LED_LAYER_TEMP 1
+/// Notifications, like uploads and downloads, over everything else.
+#define LED_LAYER_NOTIFY 2
+#define LED_LAYER_COUNT 3
+
+// How a layer goes over the layers below it:
+/// Hide them.
+#define LED_BLEND_REPLACE 0
+/// Add to them, per channel.
+#define LED_BLEND_ADD 1
+/// Take the brighter of the two, per channel.
+#define LED_BLEND_MAX 2
+
 typedef struct {
-    int_fast16_t r;
-    int_fast16_t g;
-    int_fast16_t b;
+    int16_t r;
+    int16_t g;
+    int16_t b;
 } rgbdelta_t;
 
 typedef struct {
+    /// The colors, or null on the badge for all but anim_rainbow_spin, which
+    ///  only has the keyframes in the flash for the rest.
     const rgbcolor_t * colors;
     uint8_t len;
     uint8_t speed; // csecs per frame
@@ -35,6 +63,83 @@ typedef struct {
     char name[17];
 } led_ring_animation_t;
 
+/// Where an animation's precompiled frames are in the flash.
+/**
+ ** There's one of these for each animation, by ID (see `led_anim_id()`), at
+ ** FLASH_ADDR_LED_ANIMS, written by host/anim_compiler. It points to two
+ ** tables of frames, one for each padded length the animation plays at: one
+ ** while it has loops left, and one for its last loop. Frame `i` of a table
+ ** is what `led_load_colors()` would work out at `led_ring_anim_index` `i`:
+ ** `num_leds` destination colors (`rgbcolor16_t`), then `num_leds` steps
+ ** (`rgbdelta_t`).
+ **
+ ** The badge has only these, not the animations' colors. The rest of the
+ ** fields say how the frames were compiled, so we can tell whether they're
+ ** good for the animation as the firmware plays it, and whether they're
+ ** intact.
+ */
+typedef struct {
+    /// CRC16 of the frames: the loop table, then the last loop's table if
+    ///  it's a different one.
+    uint16_t frames_crc;
+    uint8_t len;
+    uint8_t speed;
+    uint8_t type;
+    uint8_t num_leds;
+    uint8_t len_padded_loop;
+    uint8_t len_padded_last;
+    uint32_t loop_addr;
+    uint32_t last_addr;
+} led_keyframes_t;
+
+/// One animation playing on one layer of the LEDs.
+/**
+ ** Each layer has its own animation, fades and keyframes, so that playing
+ ** one over another doesn't disturb it. The layer's colors are per LED in
+ ** play (`num_leds` of them); `led_layer_index()` in leds.c maps the LEDs in
+ ** `mask` onto them.
+ */
+typedef struct {
+    /// The animation being played.
+    const led_ring_animation_t *anim;
+    /// The type it's being played as: FALL, SPIN or SAME, or NONE if the
+    ///  layer isn't playing anything.
+    uint8_t type;
+    /// How it goes over the layers below: LED_BLEND_...
+    uint8_t blend;
+    /// Which LEDs it goes over: LED_MASK_...
+    uint32_t mask;
+    /// Our position within the current frame transition (fade).
+    uint16_t anim_step;
+    /// Our frame in the animation (which may include 0-padding).
+    uint8_t index;
+    /// The number of remaining loops, or 0xFF to loop forever.
+    uint8_t loops;
+    /// The number of unique colors we are set up to do in our animation type.
+    uint8_t num_leds;
+    /// The number of total frames in the animation, plus some 0-padding.
+    uint8_t len_padded;
+    /// Custom pad length.
+    uint8_t pad_loops;
+    /// Multiplier and shift for dividing by the animation's speed.
+    uint16_t speed_recip;
+    uint8_t speed_shift;
+    /// Whether to play the animation from `keyframes`.
+    uint8_t keyframes_ok;
+    /// Whether every step in the current fade is zero, so nothing changes
+    ///  until the next frame.
+    uint8_t still;
+    led_keyframes_t keyframes;
+    /// Which of `curr` (by bit) changed since the layers were last composed.
+    uint32_t changed;
+    /// The current colors.
+    rgbcolor16_t curr[LED_RING_COUNT];
+    /// The next frame's colors (destination colors).
+    rgbcolor16_t dest[LED_RING_COUNT];
+    /// The amount to change the colors every step.
+    rgbdelta_t step[LED_RING_COUNT];
+} led_layer_t;
+
 extern uint8_t s_led_anim_done;
 
 void led_timestep();
@@ -42,6 +147,11 @@ void led_off();
 void led_on();
 void led_set_anim(const led_ring_animation_t *anim, uint8_t anim_type, uint8_t loops, uint8_t use_pad_in_loops);
 void led_set_anim_none(uint8_t clear_bg);
+void led_set_layer(uint8_t layer_id, const led_ring_animation_t *anim,
+                   uint8_t anim_type, uint8_t loops, uint8_t extra_padding,
+                   uint8_t blend, uint32_t mask);
+void led_set_layer_none(uint8_t layer_id);
 void led_activate_file_lights();
+void led_invalidate();
 
 #endif /* LEDS_H_ */
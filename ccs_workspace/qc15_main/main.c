@@ -45,6 +45,8 @@
 #include "util.h"
 #include "main_bootstrap.h"
 #include "flash_layout.h"
+#include "flash_cache.h"
+#include "flash_store.h"
 #include "badge.h"
 #include "codes.h"
 #include "led_animations.h"
@@ -64,7 +66,6 @@ uint8_t s_power_off = 0;
 uint8_t s_got_next_id = 0;
 uint8_t s_gd_success = 0;
 uint8_t s_gd_failure = 0;
-uint8_t s_game_checkname_success = 0;
 uint8_t s_turn_on_file_lights = 0;
 
 uint16_t gd_curr_id = 0;
@@ -213,6 +214,8 @@ void init() {
     ht16d_init();
     lcd111_init();
     s25fs_init();
+    flash_cache_init();
+    game_init();
     ipc_init();
     timer_init();
     adc_init();
@@ -302,12 +305,14 @@ void handle_ipc_rx(uint8_t *rx) {
         );
         if (id < QC15_BADGES_IN_SYSTEM && badges_nearby < QC15_BADGES_IN_SYSTEM)
             badges_nearby++;
+        game_update_nearby();
         break;
     case IPC_MSG_GD_DEP:
         // Someone has departed.
         id = rx[1] + ((uint16_t)rx[2] << 8);
         if (id < QC15_BADGES_IN_SYSTEM && badges_nearby)
             badges_nearby--;
+        game_update_nearby();
         break;
     case IPC_MSG_GD_DL:
         // We successfully downloaded from a badge
@@ -320,7 +325,8 @@ void handle_ipc_rx(uint8_t *rx) {
     case IPC_MSG_GD_UL:
         // Someone downloaded from us.
         set_badge_uploaded((uint16_t)rx[1] + ((uint16_t)rx[2] << 8));
-        led_set_anim(&anim_ul, 0, 0, 0);
+        led_set_layer(LED_LAYER_NOTIFY, &anim_ul, 0, 0, 0,
+                      LED_BLEND_ADD, LED_MASK_ALL);
         break;
     case IPC_MSG_ID_INC:
         // We got the ID we asked for.
@@ -339,6 +345,7 @@ void handle_ipc_rx(uint8_t *rx) {
     case IPC_MSG_CALIBRATE_FREQ:
         badge_conf.freq_set = 1;
         badge_conf.freq_center = rx[1];
+        game_update_nearby();
         save_config(0);
         // WDT hold
         WDT_A_hold(WDT_A_BASE);
@@ -346,6 +353,7 @@ void handle_ipc_rx(uint8_t *rx) {
         delay_millis(2000);
         // WDT unhold
         ht16d_all_one_color_ring_only(0x00, 0x00, 0x00);
+        led_invalidate();
         WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__32K;
         break;
     }
@@ -405,6 +413,11 @@ void handle_global_signals() {
         s_clock_tick = 1;
         led_timestep();
         poll_buttons();
+        if (!s25fs_io_held) {
+            // (In flash program mode, the pins belong to the programmer.)
+            s25fs_job_poll();
+            store_poll();
+        }
         if (!badge_conf.freezer_done && !(qc_clock.time & 0xFF))
             poll_temp(); // every 8 seconds, poll the temp.
 
@@ -492,6 +505,7 @@ void cleanup_global_signals() {
     s_down = 0;
     s_up = 0;
     s_clock_tick = 0;
+    s_flash_job_done = 0;
 }
 
 void qc15_set_mode(uint8_t mode) {
@@ -514,6 +528,7 @@ void qc15_set_mode(uint8_t mode) {
         led_set_anim_none(0);
         ht16d_standby();
         ht16d_all_one_color(0, 0, 0);
+        led_invalidate();
         lcd111_clear(LCD_TOP);
         lcd111_clear(LCD_BTM);
         lcd111_cursor_type(LCD_TOP, LCD111_CURSOR_NONE);
@@ -651,7 +666,7 @@ void checkname_handle_loop() {
             // This indicates nobody's around.
             // No joy. Tell the game we failed.
             qc15_mode = QC15_MODE_GAME;
-            s_game_checkname_success = 0;
+            game_name_search_done(0);
             return;
         }
 
@@ -659,12 +674,12 @@ void checkname_handle_loop() {
         //  name?
         // Is this the name we're looking for?
         if (!strcmp("QUEERCON", game_name_buffer)) {
-            s_game_checkname_success = 1;
+            game_name_search_done(1);
             qc15_mode = QC15_MODE_GAME;
             return;
         } else if (!strcmp(person_names[gd_curr_id], game_name_buffer)){
             // We found the name we're looking for. Hooray!
-            s_game_checkname_success = 1;
+            game_name_search_done(1);
             qc15_mode = QC15_MODE_GAME;
             return;
         }
@@ -672,7 +687,7 @@ void checkname_handle_loop() {
         if (gd_curr_id <= gd_starting_id || calls >= QC15_BADGES_IN_SYSTEM) {
             // We're done, and we haven't found the name we're looking for.
             qc15_mode = QC15_MODE_GAME;
-            s_game_checkname_success = 0;
+            game_name_search_done(0);
             return;
         }
 
@@ -720,16 +735,19 @@ void connect_handle_loop() {
     if (s_gd_success) {
         if (set_badge_downloaded(gd_curr_id)) {
             // New!
-            s_gd_success = 2;
+            game_post_special(SPECIAL_CONNECT_SUCCESS_NEW);
         } else {
             // Old.
-            s_gd_success = 1;
+            game_post_special(SPECIAL_CONNECT_SUCCESS_OLD);
         }
 
-        // We specifically do NOT clear these signals here.
+        // The game has its own copy of the result now, as a special.
+        s_gd_success = 0;
         qc15_set_mode(QC15_MODE_GAME);
         return;
     } else if (s_gd_failure) {
+        game_post_special(SPECIAL_CONNECT_FAILURE);
+        s_gd_failure = 0;
         qc15_set_mode(QC15_MODE_GAME);
         return;
     }
@@ -819,6 +837,8 @@ void main (void)
 
     // hold DOWN on turn-on for verbose boot:
     bootstrap(initial_buttons & BIT4); // interrupts required.
+    // Only now do we know whether the flash is locked out.
+    store_init();
 
     // Housekeeping is now concluded. It's time to see the wizard.
     // This function will set active and unlock_radio_status at the
@@ -830,6 +850,7 @@ void main (void)
         // Tell the radio MCU to calibrate its frequency.
         badge_conf.freq_center = 0;
         badge_conf.freq_set = 0;
+        game_update_nearby();
         unlock_radio_status = 0;
         save_config(0);
         unlock_radio_status = 1;
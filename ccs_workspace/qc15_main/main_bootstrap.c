@@ -24,6 +24,7 @@
 #include "loop_signals.h"
 
 #include "flash_layout.h"
+#include "flash_cache.h"
 
 #define POST_MCU 0
 #define POST_LCD 1
@@ -63,8 +64,11 @@ void flash_bootstrap() {
 
     // Cleanup from flash programming mode.
     ht16d_all_one_color(0x00, 0x00, 0x00);
+    led_invalidate();
     s25fs_init_io();
     s25fs_init();
+    // The programmer may have changed anything; the store isn't up yet.
+    flash_cache_init();
 }
 
 void bootstrap(uint8_t fastboot) {
@@ -299,6 +303,8 @@ void bootstrap(uint8_t fastboot) {
         }
     }
 
+    // Nothing composes the LEDs while we're in here, so the colors above
+    //  only need undoing once, on the way out.
     ht16d_all_one_color(0, 0, 0);
-
+    led_invalidate();
 }
@@ -14,16 +14,21 @@
 
 #include "qc15.h"
 #include "flash_layout.h"
+#include "flash_cache.h"
+#include "s25fs.h"
 
 uint8_t flash_status_register = 0;
 
 const uint8_t FLASH_SR_WIP = BIT0;
+/// Erase error (E_ERR) and program error (P_ERR) bits in SR1.
+const uint8_t FLASH_SR_ERR = 0b01100000;
 
 #define FLASH_CMD_WREN 0x06
 #define FLASH_CMD_WRDIS 0x04
 #define FLASH_CMD_READ_STATUS 0x05
 #define FLASH_CMD_READ_ID 0x9F
 #define FLASH_CMD_READ_DATA 0x03
+#define FLASH_CMD_FAST_READ 0x0B // Followed by one dummy byte (8 cycles).
 #define FLASH_CMD_PAGE_PROGRAM 0x02
 #define FLASH_CMD_ERASE_BLOCK 0xD8 // 64k blocks
 #define FLASH_CMD_ERASE_PARAM_SECTOR 0x20 // These are the 4k things
@@ -34,6 +39,8 @@ const uint8_t FLASH_SR_WIP = BIT0;
 #define FLASH_CMD_POWER_DOWN 0xB9
 #define FLASH_CMD_POWER_UP 0xAB
 #define FLASH_CMD_CLSR 0x82
+#define FLASH_CMD_ERASE_SUSPEND 0x75
+#define FLASH_CMD_ERASE_RESUME 0x7A
 
 #define FLASH_REG_ADDR_SR1V 0x800000
 #define FLASH_REG_ADDR_SR2V 0x800001
@@ -46,6 +53,54 @@ const uint8_t FLASH_SR_WIP = BIT0;
 
 #define FLASH_EUSCI_A_BASE EUSCI_A1_BASE
 
+/// Page programs wrap around at the end of each of these.
+#define FLASH_PAGE_SIZE 256
+
+/// Set to 0 to do all reads with the CPU, one byte at a time.
+#ifndef S25FS_USE_DMA
+#define S25FS_USE_DMA 1
+#endif
+/// Reads shorter than this aren't worth setting up the DMA for.
+#define S25FS_DMA_MIN_LEN 8
+
+/// Set by the DMA ISR when the RX channel has received everything.
+volatile uint8_t f_s25fs_dma_done = 0;
+/// Dummy byte that the TX DMA channel clocks out during reads.
+const uint8_t s25fs_dma_dummy = 0xFF;
+
+/// Signal to the main loop that an asynchronous flash job has finished.
+uint8_t s_flash_job_done = 0;
+/// 1 if the most recently finished job succeeded, 0 if it reported an error.
+uint8_t s25fs_job_last_result = 0;
+/// Number of jobs finished since boot, by job type.
+uint16_t s25fs_job_count_done[S25FS_JOB_TYPE_COUNT] = {0,};
+/// Latency of the most recently finished job, in 1/32 s ticks, by job type.
+uint32_t s25fs_job_latency_last[S25FS_JOB_TYPE_COUNT] = {0,};
+/// Worst latency seen since boot, in 1/32 s ticks, by job type.
+uint32_t s25fs_job_latency_max[S25FS_JOB_TYPE_COUNT] = {0,};
+
+/// Circular queue of submitted flash jobs.
+s25fs_job_t s25fs_jobs[S25FS_JOB_QUEUE_LEN];
+/// Index of the oldest job in the queue, which is the only one that can run.
+uint8_t s25fs_job_head = 0;
+/// Number of jobs in the queue, including the running one.
+uint8_t s25fs_job_count = 0;
+/// Whether the job at the head of the queue has been started on the chip.
+uint8_t s25fs_job_active = 0;
+/// Whether we've suspended an in-progress erase in order to do a read.
+uint8_t s25fs_erase_suspended = 0;
+/// The value of `qc_clock.time` when the running job was started.
+uint32_t s25fs_job_started_at = 0;
+/// Number of bytes the running program job is writing to its current page.
+uint16_t s25fs_job_chunk = 0;
+/// Whether `s25fs_hold_io()` has handed the flash to an external programmer.
+uint8_t s25fs_io_held = 0;
+
+/// Statistics for the most recent call to `s25fs_write_stream()`.
+s25fs_write_stats_t s25fs_write_stats_last = {0};
+/// Running totals of `s25fs_write_stream()` statistics since boot.
+s25fs_write_stats_t s25fs_write_stats_total = {0};
+
 void s25fs_usci_a1_send_sync(uint8_t data) {
     while (!(UCA1IFG & UCTXIFG)); // wait for ready to accept a character.
     UCA1TXBUF = data;
@@ -127,13 +182,248 @@ uint8_t s25fs_read_any_register(uint32_t addr) {
     return retval;
 }
 
+/// Spin until the chip reports that it's not busy. Queued jobs aren't started.
 void s25fs_block_while_wip() {
     // Make sure nothing is in progress:
     while (s25fs_get_status() & FLASH_SR_WIP)
         __delay_cycles(100); //This number came from nowhere.
 }
 
+/// Send a command followed by a three-byte address. Caller handles CS#.
+void s25fs_send_cmd_addr(uint8_t cmd, uint32_t address) {
+    s25fs_usci_a1_send_sync(cmd);
+    s25fs_usci_a1_send_sync((address & 0x00FF0000) >> 16); // MSByte of address
+    s25fs_usci_a1_send_sync((address & 0x0000FF00) >> 8); // Middle byte of address
+    s25fs_usci_a1_send_sync((address & 0x000000FF)); // LSByte of address
+}
+
+/// Put the job at the head of the queue onto the chip.
+void s25fs_job_start() {
+    s25fs_job_t *job = &s25fs_jobs[s25fs_job_head];
+
+    s25fs_simple_cmd(FLASH_CMD_WREN);
+    s25fs_begin();
+    switch(job->type) {
+    case S25FS_JOB_ERASE:
+        flash_cache_invalidate(job->address & 0xFF0000, 0x10000);
+        s25fs_send_cmd_addr(FLASH_CMD_ERASE_BLOCK, job->address);
+        break;
+    case S25FS_JOB_PROGRAM:
+        // Only program up to the end of the current page. The rest of the
+        //  job gets its own page program when this one finishes.
+        s25fs_job_chunk = FLASH_PAGE_SIZE
+                          - (job->address & (FLASH_PAGE_SIZE-1));
+        if (s25fs_job_chunk > job->len)
+            s25fs_job_chunk = job->len;
+        flash_cache_invalidate(job->address, s25fs_job_chunk);
+        s25fs_send_cmd_addr(FLASH_CMD_PAGE_PROGRAM, job->address);
+        for (uint16_t i=0; i<s25fs_job_chunk; i++) {
+            s25fs_usci_a1_send_sync(job->buffer[i]);
+        }
+        break;
+    }
+    s25fs_end();
+
+    if (!s25fs_job_active)
+        s25fs_job_started_at = qc_clock.time;
+    s25fs_job_active = 1;
+}
+
+/// Retire the running job, given the status register value that ended it.
+void s25fs_job_finish(uint8_t status) {
+    s25fs_job_t *job = &s25fs_jobs[s25fs_job_head];
+    uint8_t type = job->type;
+    uint32_t latency = qc_clock.time - s25fs_job_started_at;
+
+    s25fs_job_last_result = 1;
+    if (status & FLASH_SR_ERR) {
+        // program or erase error
+        s25fs_simple_cmd(FLASH_CMD_CLSR);
+        s25fs_job_last_result = 0;
+    } else if (type == S25FS_JOB_PROGRAM && job->len > s25fs_job_chunk) {
+        // That was one page of a longer program. Move on to the next page,
+        //  staying active so the latency covers the whole job.
+        job->address += s25fs_job_chunk;
+        job->buffer += s25fs_job_chunk;
+        job->len -= s25fs_job_chunk;
+        s25fs_job_start();
+        return;
+    }
+
+    if (job->result)
+        *job->result = s25fs_job_last_result;
+    s25fs_job_count_done[type]++;
+    s25fs_job_latency_last[type] = latency;
+    if (latency > s25fs_job_latency_max[type])
+        s25fs_job_latency_max[type] = latency;
+
+    s25fs_job_active = 0;
+    s25fs_job_head = (s25fs_job_head + 1) % S25FS_JOB_QUEUE_LEN;
+    s25fs_job_count--;
+    s_flash_job_done = 1;
+}
+
+/// Block until the running job (if any) has finished.
+void s25fs_job_wait_active() {
+    uint8_t status;
+
+    if (!s25fs_job_active)
+        return;
+    do {
+        status = s25fs_get_status();
+    } while (status & FLASH_SR_WIP);
+    s25fs_job_finish(status);
+}
+
+/// Block until every queued job has finished.
+void s25fs_job_flush() {
+    while (s25fs_job_count) {
+        if (!s25fs_job_active) {
+            // Something synchronous may still be going; the chip would
+            //  ignore the job's commands until it's done.
+            s25fs_block_while_wip();
+            s25fs_job_start();
+        }
+        s25fs_job_wait_active();
+    }
+}
+
+/// Finish the queued jobs ahead of a synchronous program, erase, or WRAR.
+/**
+ ** The caller has normally just set the write enable latch, and every job
+ ** uses the latch up, so if any jobs ran, we set it again for the caller.
+ */
+void s25fs_job_drain() {
+    if (!s25fs_job_count)
+        return;
+    s25fs_job_flush();
+    s25fs_wr_en();
+}
+
+/// Check on the flash jobs without blocking. Call this every time loop.
+/**
+ ** This costs one status register read while a job is queued, and nothing
+ ** at all when the queue is empty. When a job finishes, `s_flash_job_done`
+ ** is raised and the next job in the queue (if any) is started. A job isn't
+ ** started while the chip is still busy with a synchronous program or erase;
+ ** it waits for a later poll instead.
+ */
+void s25fs_job_poll() {
+    uint8_t status;
+
+    if (!s25fs_job_count)
+        return;
+
+    status = s25fs_get_status();
+    if (status & FLASH_SR_WIP)
+        return;
+
+    if (s25fs_job_active)
+        s25fs_job_finish(status);
+
+    // Finishing one page of a program starts the next, keeping it active.
+    if (s25fs_job_count && !s25fs_job_active)
+        s25fs_job_start();
+}
+
+uint8_t s25fs_job_submit(uint8_t type, uint32_t address, uint8_t *buffer,
+                         uint16_t len_bytes, uint8_t *result) {
+    if (s25fs_job_count == S25FS_JOB_QUEUE_LEN)
+        return 0;
+
+    s25fs_job_t *job = &s25fs_jobs[(s25fs_job_head + s25fs_job_count)
+                                   % S25FS_JOB_QUEUE_LEN];
+    job->type = type;
+    job->address = address;
+    job->buffer = buffer;
+    job->len = len_bytes;
+    job->result = result;
+    if (result)
+        *result = S25FS_JOB_PENDING;
+    s25fs_job_count++;
+    return 1;
+}
+
+/// Queue an erase of the 64 KB block containing `address`.
+/**
+ ** Returns 1 if the job was queued, or 0 if the queue is full. The erase
+ ** starts at the next `s25fs_job_poll()`. If `result` isn't null, it's set
+ ** to S25FS_JOB_PENDING now, and to the job's result when it's done.
+ */
+uint8_t s25fs_job_erase_block(uint32_t address, uint8_t *result) {
+    return s25fs_job_submit(S25FS_JOB_ERASE, address, 0, 0, result);
+}
+
+/// Queue a program of `len_bytes` bytes from `buffer` to `address`.
+/**
+ ** Returns 1 if the job was queued, or 0 if the queue is full. The data is
+ ** NOT copied, so `buffer` must stay valid until the job has finished. The
+ ** write may cross page boundaries; each page is programmed in turn.
+ ** `result` is as for `s25fs_job_erase_block()`.
+ */
+uint8_t s25fs_job_program(uint32_t address, uint8_t *buffer,
+                          uint16_t len_bytes, uint8_t *result) {
+    return s25fs_job_submit(S25FS_JOB_PROGRAM, address, buffer, len_bytes,
+                            result);
+}
+
+/// Whether any queued job touches the given range of the flash.
+uint8_t s25fs_job_conflicts(uint32_t address, uint32_t len_bytes) {
+    s25fs_job_t *job;
+    uint32_t job_start;
+    uint32_t job_len;
+
+    for (uint8_t i=0; i<s25fs_job_count; i++) {
+        job = &s25fs_jobs[(s25fs_job_head + i) % S25FS_JOB_QUEUE_LEN];
+        if (job->type == S25FS_JOB_ERASE) {
+            job_start = job->address & 0xFF0000;
+            job_len = 0x10000;
+        } else {
+            job_start = job->address;
+            job_len = job->len;
+        }
+        if (address < job_start + job_len && job_start < address + len_bytes)
+            return 1;
+    }
+    return 0;
+}
+
+/// Get the chip ready for a read of the given range.
+/**
+ ** If the read touches anything that a queued job is going to change, we
+ ** have to wait for the jobs to finish so the read sees their results.
+ ** Otherwise, a running erase is suspended for the duration of the read,
+ ** and a running page program (which is quick) is allowed to finish.
+ **
+ ** Note that every suspend pushes the erase back a little, so a steady
+ ** stream of reads will slow an erase down; but the game only reads in
+ ** short bursts once per time loop, so the erase gets most of the bus.
+ */
+void s25fs_read_prepare(uint32_t address, uint32_t len_bytes) {
+    if (s25fs_job_count) {
+        if (s25fs_job_conflicts(address, len_bytes)) {
+            s25fs_job_flush();
+        } else if (s25fs_job_active
+                && s25fs_jobs[s25fs_job_head].type == S25FS_JOB_ERASE) {
+            s25fs_simple_cmd(FLASH_CMD_ERASE_SUSPEND);
+            s25fs_erase_suspended = 1;
+        } else {
+            s25fs_job_wait_active();
+        }
+    }
+    s25fs_block_while_wip();
+}
+
+/// Resume anything that `s25fs_read_prepare()` suspended.
+void s25fs_read_done() {
+    if (s25fs_erase_suspended) {
+        s25fs_simple_cmd(FLASH_CMD_ERASE_RESUME);
+        s25fs_erase_suspended = 0;
+    }
+}
+
 void s25fs_wr_register(uint32_t addr, uint8_t val) {
+    s25fs_job_drain();
     s25fs_block_while_wip();
     s25fs_begin();
     s25fs_usci_a1_send_sync(FLASH_CMD_WRAR);
@@ -145,22 +435,187 @@ void s25fs_wr_register(uint32_t addr, uint8_t val) {
     s25fs_end();
 }
 
+/// Clock `len_bytes` bytes in from the flash using DMA channels 0 and 1.
+/**
+ ** Channel 0 moves each received byte from UCA1RXBUF into `buffer`, and is
+ ** triggered by UCA1RXIFG. Channel 1 feeds a dummy byte into UCA1TXBUF every
+ ** time UCA1TXIFG rises, which is what actually generates the clock. Channel
+ ** 0 has the higher priority, so the RX side can never fall behind the TX
+ ** side. If interrupts are enabled, we sleep in LPM0 (which keeps SMCLK, and
+ ** therefore the SPI clock, running) until the DMA ISR wakes us. Otherwise,
+ ** we just poll the channel 0 flag.
+ **
+ ** The caller is responsible for chip select, and for sending the command.
+ */
+void s25fs_recv_dma(uint8_t *buffer, uint16_t len_bytes) {
+    uint8_t gie = __get_SR_register() & GIE;
+
+    f_s25fs_dma_done = 0;
+
+    // Trigger 16 is UCA1RXIFG, trigger 17 is UCA1TXIFG.
+    DMACTL0 = DMA0TSEL_16 | DMA1TSEL_17;
+    // Round-robin priority would let TX get ahead of RX; we want fixed.
+    DMACTL4 &= ~ROUNDROBIN;
+
+    // RX: UCA1RXBUF -> buffer, byte-wise, incrementing the destination.
+    DMA0CTL = DMADT_0 | DMASRCINCR_0 | DMADSTINCR_3 | DMASRCBYTE | DMADSTBYTE;
+    __data16_write_addr((unsigned short) &DMA0SA,
+                        (unsigned long) &UCA1RXBUF);
+    __data16_write_addr((unsigned short) &DMA0DA,
+                        (unsigned long) buffer);
+    DMA0SZ = len_bytes;
+
+    // TX: the same dummy byte -> UCA1TXBUF, over and over.
+    DMA1CTL = DMADT_0 | DMASRCINCR_0 | DMADSTINCR_0 | DMASRCBYTE | DMADSTBYTE;
+    __data16_write_addr((unsigned short) &DMA1SA,
+                        (unsigned long) &s25fs_dma_dummy);
+    __data16_write_addr((unsigned short) &DMA1DA,
+                        (unsigned long) &UCA1TXBUF);
+    DMA1SZ = len_bytes;
+
+    if (gie)
+        DMA0CTL |= DMAIE;
+    DMA0CTL |= DMAEN;
+    DMA1CTL |= DMAEN;
+
+    // The DMA triggers on the rising edge of UCTXIFG, which is already high
+    //  because the bus is idle. So, give it an edge to start things off.
+    UCA1IFG &= ~UCTXIFG;
+    UCA1IFG |= UCTXIFG;
+
+    if (gie) {
+        __disable_interrupt();
+        while (!f_s25fs_dma_done) {
+            // Atomically go to sleep and re-enable interrupts, so the DMA ISR
+            //  can't sneak in between our check and our sleep.
+            __bis_SR_register(LPM0_bits | GIE);
+            __disable_interrupt();
+        }
+        __enable_interrupt();
+    } else {
+        while (!(DMA0CTL & DMAIFG));
+        DMA0CTL &= ~DMAIFG;
+    }
+
+    DMA0CTL &= ~(DMAEN | DMAIE);
+    DMA1CTL &= ~DMAEN;
+}
+
 void s25fs_read_data(uint8_t* buffer, uint32_t address, uint32_t len_bytes) {
-    s25fs_block_while_wip();
+    s25fs_read_prepare(address, len_bytes);
     s25fs_begin();
-    s25fs_usci_a1_send_sync(FLASH_CMD_READ_DATA);
+    s25fs_usci_a1_send_sync(FLASH_CMD_FAST_READ);
     s25fs_usci_a1_send_sync((address & 0x00FF0000) >> 16); // MSByte of address
     s25fs_usci_a1_send_sync((address & 0x0000FF00) >> 8); // Middle byte of address
     s25fs_usci_a1_send_sync((address & 0x000000FF)); // LSByte of address
+    s25fs_usci_a1_send_sync(0xff); // Dummy byte for the fast read latency.
+#if S25FS_USE_DMA
+    if (len_bytes >= S25FS_DMA_MIN_LEN) {
+        // DMA size registers are only 16 bits.
+        while (len_bytes > 0xFFFF) {
+            s25fs_recv_dma(buffer, 0xFFFF);
+            buffer += 0xFFFF;
+            len_bytes -= 0xFFFF;
+        }
+        s25fs_recv_dma(buffer, len_bytes);
+        s25fs_end();
+        s25fs_read_done();
+        return;
+    }
+#endif
     for (uint32_t i = 0; i < len_bytes; i++) {
         buffer[i] = s25fs_usci_a1_recv_sync(0xff);
     }
     s25fs_end();
+    s25fs_read_done();
+}
+
+/// Get the current time in microseconds, for throughput measurement.
+/**
+ ** This is only used for differences, so it doesn't matter that it wraps.
+ ** Timer A1 counts SMCLK (1 MHz) and rolls over once every time loop.
+ */
+uint32_t s25fs_usecs() {
+    uint32_t ticks;
+    uint16_t usecs;
+
+    // Make sure the time loop ISR didn't fire between our two reads.
+    do {
+        ticks = qc_clock.time;
+        usecs = TA1R;
+    } while (ticks != qc_clock.time);
+
+    return ticks * 31250 + usecs;
+}
+
+/// Write an arbitrary amount of data, returning 1 on success and 0 on failure.
+/**
+ ** The data is split at page boundaries, and each page gets its own write
+ ** enable, page program, and WIP poll. If the chip reports a program error
+ ** on any page, the status register is cleared and we stop right there,
+ ** returning 0; the data before that page has been written, and the data
+ ** after it has not.
+ **
+ ** This blocks until the whole write is done, and records the number of
+ ** bytes, pages, and microseconds it took in `s25fs_write_stats_last`.
+ */
+uint8_t s25fs_write_stream(uint32_t address, uint8_t *buffer,
+                           uint32_t len_bytes) {
+    uint16_t chunk;
+    uint8_t status;
+    uint32_t start_usecs;
+
+    // We set the write enable latch ourselves for every page.
+    s25fs_job_flush();
+    s25fs_block_while_wip();
+    flash_cache_invalidate(address, len_bytes);
+
+    s25fs_write_stats_last.bytes = 0;
+    s25fs_write_stats_last.pages = 0;
+    start_usecs = s25fs_usecs();
+
+    while (len_bytes) {
+        chunk = FLASH_PAGE_SIZE - (address & (FLASH_PAGE_SIZE-1));
+        if (chunk > len_bytes)
+            chunk = len_bytes;
+
+        s25fs_simple_cmd(FLASH_CMD_WREN);
+        s25fs_begin();
+        s25fs_send_cmd_addr(FLASH_CMD_PAGE_PROGRAM, address);
+        for (uint16_t i=0; i<chunk; i++) {
+            s25fs_usci_a1_send_sync(buffer[i]);
+        }
+        s25fs_end();
+
+        do {
+            status = s25fs_get_status();
+        } while (status & FLASH_SR_WIP);
+
+        if (status & FLASH_SR_ERR) {
+            // program error
+            s25fs_simple_cmd(FLASH_CMD_CLSR);
+            return 0;
+        }
+
+        s25fs_write_stats_last.bytes += chunk;
+        s25fs_write_stats_last.pages++;
+        address += chunk;
+        buffer += chunk;
+        len_bytes -= chunk;
+    }
+
+    s25fs_write_stats_last.usecs = s25fs_usecs() - start_usecs;
+    s25fs_write_stats_total.bytes += s25fs_write_stats_last.bytes;
+    s25fs_write_stats_total.pages += s25fs_write_stats_last.pages;
+    s25fs_write_stats_total.usecs += s25fs_write_stats_last.usecs;
+    return 1;
 }
 
 /// Write data to the flash device, blocking if a write is in progress.
 void s25fs_write_data(uint32_t address, uint8_t* buffer, uint32_t len_bytes) {
     // Length may not be any longer than 255.
+    flash_cache_invalidate(address, len_bytes);
+    s25fs_job_drain();
     s25fs_block_while_wip();
     s25fs_begin();
     s25fs_usci_a1_send_sync(FLASH_CMD_PAGE_PROGRAM);
@@ -174,11 +629,15 @@ void s25fs_write_data(uint32_t address, uint8_t* buffer, uint32_t len_bytes) {
 }
 
 void s25fs_erase_chip() {
+    flash_cache_invalidate_all();
+    s25fs_job_drain();
     s25fs_block_while_wip();
     s25fs_simple_cmd(FLASH_CMD_CHIP_ERASE);
 }
 
 void s25fs_erase_block_64kb(uint32_t address) {
+    flash_cache_invalidate(address & 0xFF0000, 0x10000);
+    s25fs_job_drain();
     s25fs_block_while_wip();
     s25fs_begin();
     s25fs_usci_a1_send_sync(FLASH_CMD_ERASE_BLOCK);
@@ -192,6 +651,7 @@ void s25fs_erase_block_64kb(uint32_t address) {
 }
 
 void s25fs_sleep() {
+    s25fs_job_flush();
     s25fs_block_while_wip();
     s25fs_simple_cmd(FLASH_CMD_POWER_DOWN);
 }
@@ -229,7 +689,7 @@ uint8_t s25fs_post2() {
     s25fs_wr_en();
     s25fs_erase_block_64kb(FLASH_ADDR_INTENTIONALLY_BLANK);
     do {
-        if (s25fs_get_status() & 0b01100000) {
+        if (s25fs_get_status() & FLASH_SR_ERR) {
             // program or erase error
             s25fs_simple_cmd(FLASH_CMD_CLSR);
             return 0;
@@ -240,7 +700,7 @@ uint8_t s25fs_post2() {
     t = 0xAB;
     s25fs_write_data(FLASH_ADDR_INTENTIONALLY_BLANK, &t, 1);
     do {
-        if (s25fs_get_status() & 0b01100000) {
+        if (s25fs_get_status() & FLASH_SR_ERR) {
             // program or erase error
             s25fs_simple_cmd(FLASH_CMD_CLSR);
             return 0;
@@ -274,6 +734,7 @@ void s25fs_hold_io() {
     //  the device:
     P3OUT |= BIT3; // Bring HOLD# high (device is held when HOLD# is low)
     PJOUT |= BIT3; // Bring WP# high (device write-protected when WP# is low)
+    s25fs_io_held = 1;
 }
 
 void s25fs_init_io() {
@@ -303,9 +764,15 @@ void s25fs_init_io() {
     ucaparam.spiMode = EUSCI_A_SPI_3PIN;
     ucaparam.selectClockSource = EUSCI_A_SPI_CLOCKSOURCE_SMCLK;
     ucaparam.clockSourceFrequency = SMCLK_FREQ_HZ;
-    ucaparam.desiredSpiClock = 500000;
+    // Run the bus as fast as our clock source allows (UCBRx=1). That's only
+    //  1 MHz, twice the old 500 kHz, because eUSCI_A can't clock from MCLK,
+    //  and SMCLK is also divided down for the time loop timer, the LED I2C,
+    //  the LCD SPI, and the IPC UART. So most of the speedup on bulk reads is
+    //  from the DMA keeping the bus busy, not from the clock.
+    ucaparam.desiredSpiClock = SMCLK_FREQ_HZ;
 
     EUSCI_A_SPI_initMaster(EUSCI_A1_BASE, &ucaparam);
+    s25fs_io_held = 0;
 }
 
 void s25fs_init() {
@@ -328,3 +795,19 @@ void s25fs_init() {
 
     // Ok, now we're in a known state. Good to go.
 }
+
+#if S25FS_USE_DMA
+/// DMA ISR, which tells the flash driver that its bulk read is complete.
+#pragma vector=DMA_VECTOR
+__interrupt
+void S25FS_DMA_ISR() {
+    switch (__even_in_range(DMAIV, DMAIV_DMA2IFG)) {
+    case DMAIV_DMA0IFG:
+        f_s25fs_dma_done = 1;
+        LPM_EXIT;
+        break;
+    default:
+        break;
+    }
+}
+#endif
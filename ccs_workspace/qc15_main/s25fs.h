@@ -9,17 +9,72 @@
 #ifndef S25FS_H_
 #define S25FS_H_
 
+#include <stdint.h>
+
+#define S25FS_JOB_ERASE 0
+#define S25FS_JOB_PROGRAM 1
+#define S25FS_JOB_TYPE_COUNT 2
+
+#define S25FS_JOB_QUEUE_LEN 4
+/// A job's result while it's still queued or running.
+#define S25FS_JOB_PENDING 0xFF
+
+/// An erase or program operation waiting to run (or running) on the flash.
+typedef struct {
+    /// S25FS_JOB_ERASE or S25FS_JOB_PROGRAM.
+    uint8_t type;
+    /// Address to program, or any address inside the block to erase.
+    uint32_t address;
+    /// Data to program, which must stay valid until the job is done.
+    uint8_t *buffer;
+    /// Number of bytes to program.
+    uint16_t len;
+    /// Where to put the job's result when it's done (1 if it succeeded, 0
+    ///  if it reported an error), or null.
+    uint8_t *result;
+} s25fs_job_t;
+
+/// Throughput statistics for `s25fs_write_stream()`.
+typedef struct {
+    /// Bytes successfully programmed.
+    uint32_t bytes;
+    /// Pages programmed (each with its own WREN and WIP poll).
+    uint32_t pages;
+    /// Wall time spent, in microseconds.
+    uint32_t usecs;
+} s25fs_write_stats_t;
+
+extern s25fs_write_stats_t s25fs_write_stats_last;
+extern s25fs_write_stats_t s25fs_write_stats_total;
+
+extern uint8_t s_flash_job_done;
+extern uint8_t s25fs_job_last_result;
+extern uint16_t s25fs_job_count_done[S25FS_JOB_TYPE_COUNT];
+extern uint32_t s25fs_job_latency_last[S25FS_JOB_TYPE_COUNT];
+extern uint32_t s25fs_job_latency_max[S25FS_JOB_TYPE_COUNT];
+extern uint8_t s25fs_job_count;
+extern uint8_t s25fs_io_held;
+
 void s25fs_init();
 void s25fs_init_io();
 void s25fs_hold_io();
 uint8_t s25fs_post1();
 uint8_t s25fs_post2();
 void s25fs_erase_block_64kb(uint32_t address);
+void s25fs_erase_chip();
 
 void s25fs_wr_en();
 void s25fs_wr_dis();
 void s25fs_block_while_wip();
 void s25fs_read_data(uint8_t* buffer, uint32_t address, uint32_t len_bytes);
 void s25fs_write_data(uint32_t address, uint8_t* buffer, uint32_t len_bytes);
+uint8_t s25fs_write_stream(uint32_t address, uint8_t *buffer,
+                           uint32_t len_bytes);
+
+uint8_t s25fs_job_erase_block(uint32_t address, uint8_t *result);
+uint8_t s25fs_job_program(uint32_t address, uint8_t *buffer,
+                          uint16_t len_bytes, uint8_t *result);
+void s25fs_job_poll();
+void s25fs_job_flush();
 
 #endif /* S25FS_H_ */
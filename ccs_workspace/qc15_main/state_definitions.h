@@ -86,4 +86,3 @@
 #define OTHER_ACTION_STATUS_MENU 4
 #define OTHER_ACTION_TURN_ON_THE_LIGHTS_TO_REPRESENT_FILE_STATE 5
 #define OTHER_ACTION_SOLVED_A_PART 6
-#define CLOSABLE_STATES 16
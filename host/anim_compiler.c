@@ -0,0 +1,307 @@
+/// Compiler for the LED animations' keyframes in the SPI flash.
+/**
+ ** For every animation with an ID (see `led_anim_id()` in leds.c), this
+ ** works out every frame that `led_load_colors()` can load, at both of the
+ ** padded lengths the animation plays at, using the real leds.c and
+ ** led_animations.c, and writes them to the flash image at
+ ** FLASH_ADDR_LED_ANIMS: a `led_keyframes_t` for each ID, then the frames.
+ ** With those in the flash, the badge loads each frame with two sequential
+ ** reads instead of working it out.
+ **
+ ** The badge doesn't have the animations' colors, only the frames, so this
+ ** is built with the colors (LED_ANIM_COLORS, see led_animations.c) to work
+ ** them out. Each ID gets a CRC of its frames, which the badge checks the
+ ** first time it plays them, and it plays anim_rainbow_spin instead of any
+ ** animation whose frames are missing or bad.
+ **
+ ** Then it checks the result, by playing each animation through leds.c
+ ** twice, once from the keyframes and once working the frames out, and
+ ** comparing the ring's colors after every time loop. It plays each one
+ ** once, with loops, as the background, and as a temporary animation over a
+ ** background. Last, it damages one frame, to check that the badge would
+ ** notice.
+ **
+ ** Usage: anim_compiler [-o keyframes.bin]
+ **
+ ** The flash image is QC15_FLASH_IMAGE (see s25fs_emu.c). `-o` also writes
+ ** the keyframes on their own, for programming at FLASH_ADDR_LED_ANIMS. The
+ ** exit status is 1 if they don't fit, or if a check fails.
+ **
+ ** \file anim_compiler.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <driverlib.h>
+
+#include "qc15.h"
+#include "badge.h"
+#include "codes.h"
+#include "util.h"
+#include "leds.h"
+#include "led_animations.h"
+#include "flash_cache.h"
+#include "flash_layout.h"
+#include "s25fs.h"
+#include "s25fs_emu.h"
+
+/// The keyframes can run up to the record store.
+#define REGION_LEN (FLASH_ADDR_STORE - FLASH_ADDR_LED_ANIMS)
+/// How long to let a looping animation run in the check.
+#define CHECK_TICKS_MAX 4000
+
+// leds.c internals:
+extern led_layer_t led_layers[LED_LAYER_COUNT];
+extern rgbcolor16_t led_colors[LED_COUNT];
+void led_init();
+void led_load_colors(led_layer_t *layer);
+void led_stage_color(led_layer_t *layer, rgbcolor16_t *dest_color_frame,
+                     uint8_t frame_index, uint8_t led_index);
+
+// What leds.c needs from the rest of the badge:
+volatile qc_clock_t qc_clock;
+qc15conf badge_conf;
+uint8_t qc15_mode;
+uint8_t global_flash_lockout;
+const led_ring_animation_t *led_ring_anim_bg;
+uint8_t led_ring_anim_pad_loops_bg;
+uint8_t led_anim_type_bg;
+
+uint8_t is_solved(uint8_t code_id) {
+    return 0;
+}
+
+
+void ht16d_put_colors(uint8_t id_start, uint8_t id_len, rgbcolor16_t* colors) {
+}
+
+void ht16d_send_gray() {
+}
+
+void ht16d_set_global_brightness(uint8_t brightness) {
+}
+
+uint8_t region[REGION_LEN];
+uint32_t region_len;
+uint32_t frames;
+
+const led_ring_animation_t *animation(uint8_t id) {
+    if (id < GAME_ANIMS_LEN)
+        return &all_animations[id];
+    return led_anims_other[id - GAME_ANIMS_LEN];
+}
+
+/// Append every frame of `layer`'s animation at padded length `len_padded`,
+///  returning its address.
+uint32_t compile_table(led_layer_t *layer, uint8_t len_padded) {
+    uint16_t colors_len = layer->num_leds * sizeof(rgbcolor16_t);
+    uint32_t start = region_len;
+
+    layer->len_padded = len_padded;
+    for (uint8_t i=0; i<len_padded; i++) {
+        if (region_len + 2 * colors_len > REGION_LEN) {
+            fprintf(stderr, "anim_compiler: keyframes don't fit in 0x%X "
+                    "bytes\n", REGION_LEN);
+            exit(1);
+        }
+        // As at the end of the fade to frame i:
+        for (uint8_t led=0; led<layer->num_leds; led++)
+            led_stage_color(layer, &layer->curr[led], i, led);
+        layer->index = i;
+        led_load_colors(layer);
+
+        memcpy(&region[region_len], layer->dest, colors_len);
+        memcpy(&region[region_len + colors_len], layer->step, colors_len);
+        region_len += 2 * colors_len;
+        frames++;
+    }
+    return FLASH_ADDR_LED_ANIMS + start;
+}
+
+void compile_animation(uint8_t id, led_keyframes_t *keyframes) {
+    const led_ring_animation_t *anim = animation(id);
+    led_layer_t *layer = &led_layers[LED_LAYER_TEMP];
+
+    // Set everything up the way the badge would play it, working the
+    //  frames out itself:
+    global_flash_lockout = FLASH_LOCKOUT_READ;
+    led_set_anim_none(1);
+    led_set_anim(anim, 0, 0, 0);
+
+    keyframes->len = anim->len;
+    keyframes->speed = anim->speed;
+    keyframes->type = layer->type;
+    keyframes->num_leds = layer->num_leds;
+    keyframes->len_padded_loop = anim->len + layer->pad_loops;
+    keyframes->len_padded_last = anim->len + layer->num_leds;
+
+    keyframes->loop_addr = compile_table(layer, keyframes->len_padded_loop);
+    if (keyframes->len_padded_last == keyframes->len_padded_loop)
+        keyframes->last_addr = keyframes->loop_addr;
+    else
+        keyframes->last_addr = compile_table(layer,
+                                             keyframes->len_padded_last);
+
+    // The tables were just appended, so they're together at the end:
+    CRC_setSeed(CRC_BASE, QC15_CRC_SEED);
+    for (uint8_t *b=&region[keyframes->loop_addr - FLASH_ADDR_LED_ANIMS];
+            b<&region[region_len]; b++)
+        CRC_set8BitData(CRC_BASE, *b);
+    keyframes->frames_crc = CRC_getResult(CRC_BASE);
+}
+
+/// Play `anim` (over `bg`, if there is one), recording the ring's colors.
+/**
+ ** \return The number of time loops recorded in `trace`.
+ */
+uint32_t play(const led_ring_animation_t *anim, uint8_t loops,
+              const led_ring_animation_t *bg, uint8_t use_keyframes,
+              rgbcolor16_t trace[][18], uint8_t *used) {
+    uint8_t layer_id = loops == 0xFF ? LED_LAYER_BG : LED_LAYER_TEMP;
+    uint32_t ticks = 0;
+
+    global_flash_lockout = use_keyframes ? 0 : FLASH_LOCKOUT_READ;
+    led_init();
+    led_set_anim_none(1);
+    s_led_anim_done = 0;
+    *used = 1;
+
+    if (bg) {
+        led_set_anim(bg, 0, 0xFF, 0);
+        *used &= led_layers[LED_LAYER_BG].keyframes_ok;
+    }
+    led_set_anim(anim, 0, loops, 0);
+    *used &= led_layers[layer_id].keyframes_ok;
+
+    while (led_layers[layer_id].type && ticks < CHECK_TICKS_MAX) {
+        led_timestep();
+        memcpy(trace[ticks++], led_colors, sizeof(trace[0]));
+    }
+    return ticks;
+}
+
+rgbcolor16_t trace_computed[CHECK_TICKS_MAX][18];
+rgbcolor16_t trace_keyframes[CHECK_TICKS_MAX][18];
+
+/// Check that playing `anim` from the keyframes looks the same.
+uint8_t check(uint8_t id, uint8_t loops, const led_ring_animation_t *bg) {
+    const led_ring_animation_t *anim = animation(id);
+    uint32_t ticks_computed, ticks_keyframes;
+    uint8_t used;
+
+    ticks_computed = play(anim, loops, bg, 0, trace_computed, &used);
+    // The main loop only hears that the animation is done if nothing else
+    //  is playing under it:
+    if (s_led_anim_done != (loops != 0xFF && !bg)) {
+        printf("animation %u (%s), loops %u: s_led_anim_done is %u\n",
+               id, anim->name, loops, s_led_anim_done);
+        return 0;
+    }
+    ticks_keyframes = play(anim, loops, bg, 1, trace_keyframes, &used);
+
+    if (!used) {
+        printf("animation %u (%s): keyframes not used\n", id, anim->name);
+        return 0;
+    }
+    if (ticks_computed != ticks_keyframes) {
+        printf("animation %u (%s), loops %u: ran %u time loops, not %u\n",
+               id, anim->name, loops, ticks_keyframes, ticks_computed);
+        return 0;
+    }
+    for (uint32_t t=0; t<ticks_computed; t++) {
+        if (memcmp(trace_computed[t], trace_keyframes[t],
+                   sizeof(trace_computed[t]))) {
+            printf("animation %u (%s), loops %u: differs at time loop %u\n",
+                   id, anim->name, loops, t);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/// Check that the badge won't use frames that have gone bad in the flash.
+/**
+ ** This flips a bit in the very last frame, so the CRC has to cover all of
+ ** the last animation's tables to catch it, and puts it back after.
+ */
+uint8_t check_damage(uint8_t *image) {
+    uint8_t *last = image + FLASH_ADDR_LED_ANIMS + region_len - 1;
+    const led_ring_animation_t *anim = animation(LED_ANIMS_LEN - 1);
+    uint8_t noticed;
+
+    global_flash_lockout = 0;
+    led_init();
+    led_set_anim(anim, 0, 0xFF, 0);
+    if (!led_layers[LED_LAYER_BG].keyframes_ok)
+        return 0;
+
+    *last ^= 0x01;
+    flash_cache_invalidate_all();
+    led_init();
+    led_set_anim(anim, 0, 0xFF, 0);
+    noticed = !led_layers[LED_LAYER_BG].keyframes_ok;
+    *last ^= 0x01;
+    flash_cache_invalidate_all();
+    return noticed;
+}
+
+int main(int argc, char *argv[]) {
+    led_keyframes_t keyframes[LED_ANIMS_LEN];
+    const char *out_path = 0;
+    uint8_t *image;
+    uint32_t failures = 0;
+
+    if (argc == 3 && !strcmp(argv[1], "-o")) {
+        out_path = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: anim_compiler [-o keyframes.bin]\n");
+        return 2;
+    }
+
+    s25fs_init_io();
+    s25fs_init();
+    flash_cache_init();
+
+    region_len = sizeof(keyframes);
+    for (uint8_t id=0; id<LED_ANIMS_LEN; id++)
+        compile_animation(id, &keyframes[id]);
+    memcpy(region, keyframes, sizeof(keyframes));
+
+    image = s25fs_emu_image();
+    memset(image + FLASH_ADDR_LED_ANIMS, 0xFF, REGION_LEN);
+    memcpy(image + FLASH_ADDR_LED_ANIMS, region, region_len);
+    flash_cache_invalidate_all();
+    printf("%u animations, %lu frames, %lu bytes at 0x%06X\n", LED_ANIMS_LEN,
+           (unsigned long) frames, (unsigned long) region_len,
+           FLASH_ADDR_LED_ANIMS);
+
+    if (out_path) {
+        FILE *out = fopen(out_path, "wb");
+        if (!out || fwrite(region, 1, region_len, out) != region_len) {
+            perror(out_path);
+            return 1;
+        }
+        fclose(out);
+    }
+
+    for (uint8_t id=0; id<LED_ANIMS_LEN; id++) {
+        failures += !check(id, 0, 0);
+        failures += !check(id, 3, 0);
+        failures += !check(id, 0xFF, 0);
+        failures += !check(id, 2, &all_animations[0]);
+    }
+    printf("check: %lu of %u playbacks differ\n", (unsigned long) failures,
+           4 * LED_ANIMS_LEN);
+
+    if (!check_damage(image)) {
+        printf("check: a damaged frame went unnoticed\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
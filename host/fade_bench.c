@@ -0,0 +1,170 @@
+/// Benchmark and equivalence check for the LED ring's fade steps.
+/**
+ ** led_load_colors() used to divide each color difference by the
+ ** animation's speed: three signed divisions per LED, every frame. It now
+ ** multiplies by a reciprocal that led_set_anim() works out once. This
+ ** checks that led_div_speed() gives exactly what `/` did, for every speed
+ ** and every difference a 15-bit color can have, and then times the real
+ ** led_load_colors() (leds.c) against the old one, which is kept below, on
+ ** every frame of every game animation.
+ **
+ ** The times are in host cycles, where division is done in hardware, so
+ ** they understate the difference on the MSP430, which has a hardware
+ ** multiplier but does division in a library call.
+ **
+ ** Usage: fade_bench [repeats]
+ **
+ ** The exit status is 1 if the two ever disagree.
+ **
+ ** \file fade_bench.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "qc15.h"
+#include "badge.h"
+#include "codes.h"
+#include "leds.h"
+#include "led_animations.h"
+
+// leds.c internals:
+extern led_layer_t led_layers[LED_LAYER_COUNT];
+void led_set_speed(led_layer_t *layer, uint8_t speed);
+int_fast16_t led_div_speed(led_layer_t *layer, int_fast16_t delta);
+void led_load_colors(led_layer_t *layer);
+uint8_t next_anim_index(led_layer_t *layer, uint8_t index);
+void led_stage_color(led_layer_t *layer, rgbcolor16_t *dest_color_frame,
+                     uint8_t frame_index, uint8_t led_index);
+
+// What leds.c needs from the rest of the badge:
+volatile qc_clock_t qc_clock;
+qc15conf badge_conf;
+// This is about working the frames out, so don't play them from the flash.
+uint8_t global_flash_lockout = FLASH_LOCKOUT_READ;
+uint8_t qc15_mode;
+const led_ring_animation_t *led_ring_anim_bg;
+uint8_t led_ring_anim_pad_loops_bg;
+uint8_t led_anim_type_bg;
+
+uint8_t is_solved(uint8_t code_id) {
+    return 0;
+}
+
+
+void ht16d_put_colors(uint8_t id_start, uint8_t id_len, rgbcolor16_t* colors) {
+}
+
+void ht16d_send_gray() {
+}
+
+void ht16d_set_global_brightness(uint8_t brightness) {
+}
+
+/// A timestamp, in cycles where the host has a cycle counter, or ns.
+uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+rgbdelta_t reference_step[18];
+
+/// The old led_load_colors(), into `reference_step`.
+__attribute__((noinline))
+void reference_load_colors(led_layer_t *layer) {
+    for (uint8_t i=0; i<layer->num_leds; i++) {
+        led_stage_color(layer, &layer->dest[i],
+                        next_anim_index(layer, layer->index),
+                        i);
+
+        reference_step[i].r = ((int_fast16_t) layer->dest[i].r - (int_fast16_t)layer->curr[i].r) / layer->anim->speed;
+        reference_step[i].g = ((int_fast16_t) layer->dest[i].g - (int_fast16_t)layer->curr[i].g) / layer->anim->speed;
+        reference_step[i].b = ((int_fast16_t) layer->dest[i].b - (int_fast16_t)layer->curr[i].b) / layer->anim->speed;
+    }
+}
+
+/// Compare led_div_speed() with `/` for every speed and 15-bit difference.
+uint32_t check_division() {
+    led_layer_t *layer = &led_layers[LED_LAYER_BG];
+    uint32_t mismatches = 0;
+
+    for (uint16_t speed=1; speed<256; speed++) {
+        led_set_speed(layer, speed);
+        for (int32_t delta=-0x7fff; delta<=0x7fff; delta++) {
+            if (led_div_speed(layer, delta) == (int_fast16_t) delta / speed)
+                continue;
+            if (mismatches++ < 10)
+                printf("%ld / %u: got %ld\n", (long) delta, speed,
+                       (long) led_div_speed(layer, delta));
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t repeats = argc > 1 ? strtoul(argv[1], 0, 0) : 200;
+    uint32_t mismatches;
+    uint32_t loads = 0;
+    uint64_t cycles_new = 0;
+    uint64_t cycles_old = 0;
+    uint64_t start;
+
+    mismatches = check_division();
+    printf("division: 255 speeds x 65535 differences, %lu mismatches\n",
+           (unsigned long) mismatches);
+
+    for (uint8_t a=0; a<GAME_ANIMS_LEN; a++) {
+        const led_ring_animation_t *anim = &all_animations[a];
+        led_layer_t *layer = &led_layers[LED_LAYER_TEMP];
+
+        led_set_anim(anim, 0, 0, 0);
+        for (uint8_t frame=0; frame<anim->len+layer->num_leds; frame++) {
+            // As led_layer_timestep() does at the end of each fade:
+            memcpy(layer->curr, layer->dest,
+                   sizeof(rgbcolor16_t) * layer->num_leds);
+            layer->index = frame;
+
+            start = now();
+            for (uint32_t i=0; i<repeats; i++)
+                led_load_colors(layer);
+            cycles_new += now() - start;
+
+            start = now();
+            for (uint32_t i=0; i<repeats; i++)
+                reference_load_colors(layer);
+            cycles_old += now() - start;
+
+            loads++;
+            if (memcmp(layer->step, reference_step,
+                       sizeof(rgbdelta_t) * layer->num_leds)) {
+                if (mismatches++ < 20)
+                    printf("%s, frame %u: steps differ\n", anim->name, frame);
+            }
+        }
+    }
+
+    printf("%lu frame loads from %u animations, %lu mismatches\n",
+           (unsigned long) loads, GAME_ANIMS_LEN, (unsigned long) mismatches);
+#if defined(__x86_64__) || defined(__i386__)
+    printf("cycles per load: %.1f with division, %.1f with reciprocals\n",
+#else
+    printf("ns per load: %.1f with division, %.1f with reciprocals\n",
+#endif
+           (double) cycles_old / loads / repeats,
+           (double) cycles_new / loads / repeats);
+    return mismatches ? 1 : 0;
+}
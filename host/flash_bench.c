@@ -0,0 +1,291 @@
+/// Flash bus benchmark for the read cache and the record store.
+/**
+ ** This links the real flash_cache.c and flash_store.c against the S25FS
+ ** emulator, runs them through a few representative workloads, and prints
+ ** where the flash bus time went, broken down by calling function. It also
+ ** checks that everything reads back after a replay, that a deleted key
+ ** stays deleted when its tombstone's block is compacted before an older
+ ** block that still has the key, that a block that won't erase is given up
+ ** on even with other jobs finishing around its erases, and that the store
+ ** leaves the flash alone when it's locked out.
+ **
+ ** Usage: flash_bench [records]
+ **
+ ** The flash image is QC15_FLASH_IMAGE (see s25fs_emu.c); it's reused between
+ ** runs, which exercises the store's boot-time replay.
+ **
+ ** \file flash_bench.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qc15.h"
+#include "s25fs.h"
+#include "flash_cache.h"
+#include "flash_store.h"
+#include "flash_layout.h"
+#include "s25fs_emu.h"
+
+/// 1/32 of a second, in ns.
+#define TICK_NS 31250000ULL
+
+volatile qc_clock_t qc_clock;
+uint8_t global_flash_lockout = 0;
+
+// The store's internals, so we can pick which block gets compacted:
+extern uint8_t store_active;
+extern uint8_t store_work_block;
+extern uint32_t store_work_offset;
+extern uint8_t store_block_state[STORE_BLOCKS];
+extern uint8_t store_erase_result;
+
+/// One pass through the parts of the time loop that touch the flash.
+void tick() {
+    qc_clock.time++;
+    s25fs_emu_advance(TICK_NS);
+    s25fs_job_poll();
+    store_poll();
+}
+
+void section(const char *title) {
+    printf("\n== %s ==\n", title);
+    s25fs_emu_report(stdout);
+    s25fs_emu_reset_stats();
+}
+
+/// Reads in the same pattern as the game engine: small records, with lots
+/// of re-reading of the same few.
+void bench_reads(uint8_t cached) {
+    uint8_t buf[86];
+    uint32_t seed = 1;
+    uint16_t id;
+
+    for (uint16_t i=0; i<2000; i++) {
+        seed = seed * 1103515245 + 12345;
+        // 90% of reads hit the same 32 actions; the rest are anywhere.
+        if ((seed >> 16) % 10)
+            id = (seed >> 8) % 32;
+        else
+            id = (seed >> 8) % 1180;
+        if (cached)
+            flash_cache_read(buf, FLASH_ADDR_GAME_ACTIONS + id*14, 14);
+        else
+            s25fs_read_data(buf, FLASH_ADDR_GAME_ACTIONS + id*14, 14);
+    }
+}
+
+/// Write filler records to other keys until the store opens a new block.
+void fill_block(uint16_t key) {
+    uint8_t block = store_active;
+    uint8_t buf[64];
+
+    memset(buf, 0x5A, sizeof(buf));
+    while (store_active == block) {
+        store_write(key, buf, sizeof(buf));
+    }
+}
+
+/// Delete a key, compact the block holding the tombstone, and reboot.
+/**
+ ** The key's data record is in an older block than its tombstone. The
+ ** tombstone's block is compacted and erased first, so if the tombstone
+ ** isn't carried forward, the replay brings the key back.
+ */
+uint8_t check_delete() {
+    uint16_t key = 0;
+    uint8_t buf[STORE_MAX_RECORD_LEN];
+    uint8_t tombstone_block;
+    uint32_t ticks;
+    uint8_t bad = 0;
+
+    memset(buf, 0xA5, 32);
+    store_write(key, buf, 32);
+    fill_block(key + 1);
+    store_delete(key);
+    tombstone_block = store_active;
+    fill_block(key + 1);
+
+    store_work_block = tombstone_block;
+    store_work_offset = sizeof(store_block_header_t);
+    store_state = STORE_STATE_COPYING;
+    for (ticks=0; ticks<1000 && (store_state != STORE_STATE_IDLE
+            || store_block_state[tombstone_block] != STORE_BLOCK_FREE);
+            ticks++)
+        tick();
+    if (store_block_state[tombstone_block] != STORE_BLOCK_FREE)
+        bad++;
+    if (store_read(key, buf, sizeof(buf)))
+        bad++;
+    store_init();
+    if (store_read(key, buf, sizeof(buf)))
+        bad++;
+    return bad;
+}
+
+/// Make a free block fail to erase, with a program job queued behind each
+///  erase, and check that the store gives up on it after STORE_ERASE_TRIES.
+uint8_t check_bad_block() {
+    uint8_t scratch[16];
+    uint8_t block = STORE_BLOCKS;
+    uint8_t erasing = 0;
+    uint8_t tries = 0;
+    uint8_t bad = 0;
+
+    for (uint8_t i=0; i<STORE_BLOCKS; i++) {
+        if (store_block_state[i] == STORE_BLOCK_FREE && i != store_active)
+            block = i;
+    }
+    if (block == STORE_BLOCKS)
+        return 1;
+
+    memset(scratch, 0, sizeof(scratch));
+    s25fs_emu_bad_block = FLASH_ADDR_STORE + block * STORE_BLOCK_SIZE;
+    store_block_state[block] = STORE_BLOCK_DIRTY;
+    store_free_blocks--;
+    for (uint16_t t=0; t<2000; t++) {
+        tick();
+        if (erasing && store_erase_result != S25FS_JOB_PENDING) {
+            erasing = 0;
+            tries++;
+        }
+        if (store_state == STORE_STATE_ERASING && store_work_block == block
+                && store_erase_result == S25FS_JOB_PENDING && !erasing) {
+            erasing = 1;
+            // This one succeeds, and finishes after the store's erase does.
+            s25fs_job_program(FLASH_ADDR_STORE - sizeof(scratch), scratch,
+                              sizeof(scratch), 0);
+        }
+    }
+    if (store_block_state[block] != STORE_BLOCK_BAD)
+        bad++;
+    if (tries != STORE_ERASE_TRIES)
+        bad++;
+
+    // It's fine again after a reboot, with its header intact.
+    s25fs_emu_bad_block = S25FS_EMU_NO_BLOCK;
+    store_init();
+    if (store_block_state[block] != STORE_BLOCK_FREE)
+        bad++;
+    return bad;
+}
+
+/// Check that a locked-out store doesn't touch the flash.
+uint8_t check_lockout() {
+    uint8_t buf[16];
+    uint64_t programmed = 0;
+    uint8_t bad = 0;
+
+    memset(buf, 0x33, sizeof(buf));
+    global_flash_lockout = FLASH_LOCKOUT_WRITE;
+    store_init();
+    s25fs_emu_reset_stats();
+    // Make work for it, if it were looking:
+    store_block_state[0] = STORE_BLOCK_DIRTY;
+    if (store_write(1, buf, sizeof(buf)) || store_read(1, buf, sizeof(buf)))
+        bad++;
+    for (uint16_t t=0; t<100; t++)
+        tick();
+    for (uint8_t i=0; i<s25fs_emu_caller_count; i++)
+        programmed += s25fs_emu_callers[i].commands;
+    if (programmed || s25fs_job_count)
+        bad++;
+
+    global_flash_lockout = 0;
+    store_init();
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t records = argc > 1 ? strtoul(argv[1], 0, 0) : 20000;
+    uint8_t buf[STORE_MAX_RECORD_LEN];
+    uint8_t expect[STORE_MAX_KEYS];
+    uint32_t ticks;
+    uint32_t failures = 0;
+
+    s25fs_init_io();
+    s25fs_init();
+    flash_cache_init();
+
+    bench_reads(0);
+    section("2000 game-style reads, uncached");
+    bench_reads(1);
+    printf("cache: %lu hits, %lu misses\n",
+           (unsigned long) flash_cache_hits,
+           (unsigned long) flash_cache_misses);
+    section("2000 game-style reads, through flash_cache");
+
+    store_init();
+    section("store_init");
+
+    // Let the background erase anything that needs it.
+    for (ticks=0; ticks<10000 && (store_free_blocks < STORE_BLOCKS - 1); ticks++)
+        tick();
+    printf("%u free blocks after %lu ticks\n", store_free_blocks,
+           (unsigned long) ticks);
+    section("background formatting");
+
+    memset(expect, 0, sizeof(expect));
+    for (uint32_t i=0; i<records; i++) {
+        uint16_t key = i % STORE_MAX_KEYS;
+        uint8_t len = 16 + (i % 48);
+        memset(buf, (uint8_t) i, len);
+        while (!store_write(key, buf, len))
+            tick(); // No room until compaction catches up.
+        expect[key] = (uint8_t) i;
+        if (!(i % 8))
+            tick();
+    }
+    for (ticks=0; ticks<100 || store_state != STORE_STATE_IDLE; ticks++)
+        tick();
+    printf("%lu records written; erase counts:", (unsigned long) records);
+    for (uint8_t i=0; i<STORE_BLOCKS; i++)
+        printf(" %lu", (unsigned long) store_erase_counts[i]);
+    printf("\nwrite_stream: %lu bytes, %lu pages, %lu us\n",
+           (unsigned long) s25fs_write_stats_total.bytes,
+           (unsigned long) s25fs_write_stats_total.pages,
+           (unsigned long) s25fs_write_stats_total.usecs);
+    printf("erase jobs: %u, worst latency %lu ticks\n",
+           s25fs_job_count_done[S25FS_JOB_ERASE],
+           (unsigned long) s25fs_job_latency_max[S25FS_JOB_ERASE]);
+    section("record writes and compaction");
+
+    // Reboot, and make sure the replay finds the newest copy of everything.
+    store_init();
+    section("store_init after writes");
+    for (uint16_t key=0; key<STORE_MAX_KEYS && key<records; key++) {
+        uint8_t len = store_read(key, buf, sizeof(buf));
+        if (!len || buf[0] != expect[key] || buf[len-1] != expect[key])
+            failures++;
+    }
+    printf("readback after replay: %s (%lu bad keys)\n",
+           failures ? "MISMATCH" : "ok", (unsigned long) failures);
+
+    if (check_delete()) {
+        printf("deleted key after compaction and replay: MISMATCH\n");
+        failures++;
+    } else {
+        printf("deleted key after compaction and replay: ok\n");
+    }
+    section("delete, compaction, and replay");
+
+    if (check_bad_block()) {
+        printf("giving up on a block that won't erase: MISMATCH\n");
+        failures++;
+    } else {
+        printf("giving up on a block that won't erase: ok\n");
+    }
+    if (check_lockout()) {
+        printf("store with the flash locked out: MISMATCH\n");
+        failures++;
+    } else {
+        printf("store with the flash locked out: ok\n");
+    }
+
+    return failures ? 1 : 0;
+}
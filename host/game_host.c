@@ -0,0 +1,167 @@
+/// Host stand-ins for the parts of the badge that the game engine calls.
+/**
+ ** The game engine (game.c and the modules it pulls in) expects main.c's
+ ** signals and globals, the LED driver and the radio IPC. This provides
+ ** host versions of those for the tools that link the engine, which log
+ ** what the game asked for with event() instead of doing it.
+ **
+ ** \file game_host.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qc15.h"
+#include "ipc.h"
+#include "leds.h"
+#include "game.h"
+#include "badge.h"
+#include "menu.h"
+#include "led_animations.h"
+#include "flash_cache.h"
+#include "flash_layout.h"
+#include "s25fs_emu.h"
+#include "game_host.h"
+
+// From main.c, which we can't link:
+uint8_t s_clock_tick = 0;
+uint8_t s_buttons = 0;
+uint8_t s_down = 0;
+uint8_t s_up = 0;
+uint8_t s_left = 0;
+uint8_t s_right = 0;
+uint8_t s_power_on = 0;
+uint8_t s_power_off = 0;
+uint8_t s_got_next_id = 0;
+uint8_t s_gd_success = 0;
+uint8_t s_gd_failure = 0;
+uint8_t s_turn_on_file_lights = 0;
+uint16_t gd_curr_id = 0;
+uint16_t gd_curr_connectable = 0;
+uint16_t gd_starting_id = 0;
+uint8_t qc15_mode;
+volatile qc_clock_t qc_clock;
+uint16_t badges_nearby = 0;
+uint8_t global_flash_lockout = 0;
+
+char events[4096];
+uint16_t events_len = 0;
+
+void event(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void event(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    events_len += vsnprintf(events + events_len, sizeof(events) - events_len,
+                            fmt, args);
+    va_end(args);
+    if (events_len >= sizeof(events))
+        events_len = sizeof(events) - 1;
+}
+
+void events_clear() {
+    events_len = 0;
+    events[0] = 0;
+}
+
+/// Name the thing at `addr`, e.g. an animation, with the symbol table.
+const char *symbol_name(const void *addr, char *buf, size_t len) {
+    Dl_info info;
+    if (addr >= (void *) all_animations &&
+            addr < (void *) (all_animations + GAME_ANIMS_LEN)) {
+        snprintf(buf, len, "all_animations[%u]",
+                 (unsigned) ((const led_ring_animation_t *) addr -
+                             all_animations));
+    } else if (dladdr(addr, &info) && info.dli_sname) {
+        snprintf(buf, len, "%s", info.dli_sname);
+    } else {
+        snprintf(buf, len, "%p", addr);
+    }
+    return buf;
+}
+
+// LED stand-ins, which keep the same background bookkeeping as leds.c:
+void led_set_layer(uint8_t layer_id, const led_ring_animation_t *anim,
+                   uint8_t anim_type, uint8_t loops, uint8_t extra_padding,
+                   uint8_t blend, uint32_t mask) {
+    char name[64];
+    event("  led %s%s\n", symbol_name(anim, name, sizeof(name)),
+          layer_id == LED_LAYER_BG ? " (background)" :
+          layer_id == LED_LAYER_NOTIFY ? " (notification)" : "");
+    if (layer_id == LED_LAYER_BG && loops == 0xFF) {
+        led_ring_anim_bg = anim;
+        led_anim_type_bg = anim_type;
+        led_ring_anim_pad_loops_bg = extra_padding;
+    }
+}
+
+void led_set_anim(const led_ring_animation_t *anim, uint8_t anim_type,
+                  uint8_t loops, uint8_t extra_padding) {
+    led_set_layer(loops == 0xFF ? LED_LAYER_BG : LED_LAYER_TEMP, anim,
+                  anim_type, loops, extra_padding, LED_BLEND_REPLACE,
+                  LED_MASK_RING);
+}
+
+void led_set_layer_none(uint8_t layer_id) {
+    event("  led none (layer %u)\n", layer_id);
+}
+
+void led_set_anim_none(uint8_t clear_bg) {
+    event("  led none%s\n", clear_bg ? " (and background)" : "");
+    if (clear_bg)
+        led_ring_anim_bg = 0;
+}
+
+void led_activate_file_lights() {
+    event("  led file lights\n");
+}
+
+// Radio IPC stand-ins; every message goes through the first time.
+uint8_t ipc_tx_op_buf(uint8_t op, uint8_t *tx_buf, uint8_t len) {
+    event("  ipc op 0x%02X, %u bytes\n", op, len);
+    return 1;
+}
+
+uint8_t ipc_tx_byte(uint8_t tx_byte) {
+    event("  ipc 0x%02X\n", tx_byte);
+    return 1;
+}
+
+// The parts of qc15_set_mode() in main.c that the game can reach:
+void qc15_set_mode(uint8_t mode) {
+    switch(mode) {
+    case QC15_MODE_STATUS:
+        enter_menu_status();
+        status_render_choice();
+        break;
+    case QC15_MODE_GAME:
+        game_render_current();
+        break;
+    case QC15_MODE_CONTROLLER:
+        enter_menu_controller();
+        control_render_choice();
+        break;
+    }
+    qc15_mode = mode;
+}
+
+void load_game_image(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    uint8_t *image = s25fs_emu_image() + FLASH_ADDR_GAME_ACTIONS;
+    size_t len = fread(image, 1, GAME_IMAGE_LEN, f);
+    memset(image + len, 0xFF, GAME_IMAGE_LEN - len);
+    fclose(f);
+    flash_cache_invalidate_all();
+}
+
@@ -0,0 +1,43 @@
+/// Header for the host stand-ins that the game engine links against.
+/**
+ ** \file game_host.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef GAME_HOST_H_
+#define GAME_HOST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+/// Game image: actions, text, states, and choices.
+#define GAME_IMAGE_LEN 0x40000
+
+// From game.c and textentry.c, which don't export them:
+extern uint8_t in_action_series;
+extern uint32_t game_curr_action_elapsed;
+extern uint32_t game_curr_state_elapsed;
+extern game_action_t loaded_action;
+extern game_state_t *current_state;
+extern char curr_text[25];
+extern uint8_t text_entry_cursor_pos;
+void game_set_state(uint16_t state_id, uint8_t keep_previous);
+void game_process_timers();
+uint8_t start_action_series(uint16_t action_id);
+uint8_t leads_to_closed_state(uint16_t action_id);
+void game_action_sequence_tick();
+
+/// Events (LED animations, radio messages...) logged since the last reset.
+extern char events[4096];
+extern uint16_t events_len;
+
+void event(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void events_clear();
+const char *symbol_name(const void *addr, char *buf, size_t len);
+void load_game_image(const char *path);
+
+#endif /* GAME_HOST_H_ */
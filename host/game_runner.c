@@ -0,0 +1,442 @@
+/// Headless runner for the badge game state machine.
+/**
+ ** This links the real game engine (game.c, textentry.c, menu.c, and the
+ ** badge.c/codes.c state they lean on) and the real LCD driver against the
+ ** LCD model, the S25FS emulator, and the stand-ins for the LEDs, the radio
+ ** IPC and main.c in game_host.c. Then it drives the game from a script, one
+ ** time loop (1/32 s) at a time, and prints a transcript of what happens.
+ **
+ ** Usage: game_runner [options] script
+ **  -g FILE   game image from scripts/game_compiler.py, loaded at 0x300000
+ **            (otherwise, whatever is in the QC15_FLASH_IMAGE flash image)
+ **  -d FILE   state_definitions.h, to name states in the transcript
+ **  -b ID     badge ID (default 1)
+ **  -q        don't print the per-tick flash and LCD counts
+ **
+ ** The script has one command per line; # starts a comment.
+ **  tick [n]              run n time loops (default 1)
+ **  idle [max]            run until the current action series is over
+ **  up|down|left|right [n]  press and release a button, n times; each
+ **                        press takes one time loop
+ **  type TEXT             enter TEXT (up to the end of the line) into the
+ **                        text entry that's up, with button presses
+ **  nearby N              set the number of badges nearby
+ **  name found|missing    finish a name search
+ **  connect new|old|fail  finish a connection with a new or already
+ **                        connected badge, or fail to
+ **  solved                signal that a connection solved a code part
+ **  state ID              jump straight to a state
+ **  seed N                seed rand(), for choice sets
+ **  expect top|btm TEXT   check what a screen says (trailing blanks ignored)
+ **  expect state ID       check the current state
+ **
+ ** For every time loop that does anything, the transcript shows the game's
+ ** flash reads (reads through the flash cache, and how many of those went
+ ** out on the SPI bus) and the LCD bus writes, and then any state changes,
+ ** mode changes, screen changes, LED animations and radio messages. At the
+ ** end, it sums those up, and reports how many state changes found their
+ ** state already prefetched.
+ **
+ ** The exit status is 1 if any `expect` failed.
+ **
+ ** \file game_runner.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qc15.h"
+#include "ipc.h"
+#include "leds.h"
+#include "lcd111.h"
+#include "game.h"
+#include "badge.h"
+#include "menu.h"
+#include "textentry.h"
+#include "led_animations.h"
+#include "loop_signals.h"
+#include "flash_cache.h"
+#include "flash_layout.h"
+#include "s25fs.h"
+#include "s25fs_emu.h"
+#include "lcd_model.h"
+#include "game_host.h"
+
+/// 1/32 of a second, in ns.
+#define TICK_NS 31250000ULL
+/// The most time loops `idle` will wait by default.
+#define IDLE_MAX 3200
+/// The most presses `type` will make to get to one character.
+#define TYPE_MAX_PRESSES 100
+
+char state_names[all_states_len][48];
+uint8_t quiet = 0;
+uint32_t expect_failures = 0;
+uint32_t script_line = 0;
+
+/// Totals, and the worst single time loop, for the summary.
+uint32_t ticks_run = 0;
+uint64_t total_lookups = 0;
+uint64_t total_bus_reads = 0;
+uint64_t total_lcd_writes = 0;
+uint32_t worst_lookups = 0;
+uint32_t worst_lcd_writes = 0;
+
+void print_screen_text(FILE *out, const char *text, uint8_t len) {
+    for (uint8_t i=0; i<len; i++) {
+        uint8_t c = (uint8_t) text[i];
+        if (c >= ' ' && c < 0x7F && c != '\\')
+            fputc(c, out);
+        else
+            fprintf(out, "\\x%02X", c);
+    }
+}
+
+const char *mode_name(uint8_t mode) {
+    switch (mode) {
+    case QC15_MODE_COUNTDOWN: return "COUNTDOWN";
+    case QC15_MODE_STATUS: return "STATUS";
+    case QC15_MODE_SLEEP: return "SLEEP";
+    case QC15_MODE_TEXTENTRY: return "TEXTENTRY";
+    case QC15_MODE_CONTROLLER: return "CONTROLLER";
+    case QC15_MODE_GAME: return "GAME";
+    case QC15_MODE_GAME_CHECKNAME: return "GAME_CHECKNAME";
+    case QC15_MODE_GAME_CONNECT: return "GAME_CONNECT";
+    }
+    return "?";
+}
+
+const char *state_name(uint16_t state_id) {
+    if (state_id < all_states_len && state_names[state_id][0])
+        return state_names[state_id];
+    return "";
+}
+
+void load_state_names(const char *path) {
+    char line[600];
+    char name[48];
+    unsigned value;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "#define STATE_ID_%47s %u", name, &value) == 2 &&
+                value < all_states_len)
+            strcpy(state_names[value], name);
+    }
+    fclose(f);
+}
+
+/// Total SPI flash commands and bytes so far, from the emulator.
+void flash_bus_totals(uint64_t *commands, uint64_t *bytes) {
+    *commands = 0;
+    *bytes = 0;
+    for (uint8_t i=0; i<s25fs_emu_caller_count; i++) {
+        *commands += s25fs_emu_callers[i].commands;
+        *bytes += s25fs_emu_callers[i].read_bytes;
+    }
+}
+
+/// Run one time loop, the way main() does in the game modes.
+void tick() {
+    uint32_t lookups = flash_cache_hits + flash_cache_misses;
+    uint32_t lcd_writes = lcd_model_writes(LCD_TOP) + lcd_model_writes(LCD_BTM);
+    uint64_t lcd_ns = lcd_model_bus_ns(LCD_TOP) + lcd_model_bus_ns(LCD_BTM);
+    uint64_t bus_cmds, bus_bytes, cmds_after, bytes_after;
+    uint16_t state_before = game_curr_state_id;
+    uint8_t mode_before = qc15_mode;
+    char screens_before[2][LCD_MODEL_COLS+1];
+
+    memcpy(screens_before[0], lcd_model[0].text, sizeof(screens_before[0]));
+    memcpy(screens_before[1], lcd_model[1].text, sizeof(screens_before[1]));
+    flash_bus_totals(&bus_cmds, &bus_bytes);
+
+    qc_clock.time++;
+    s25fs_emu_advance(TICK_NS);
+    s_clock_tick = 1;
+    s25fs_job_poll();
+
+    if (s_turn_on_file_lights) {
+        led_activate_file_lights();
+        s_turn_on_file_lights = 0;
+        badge_conf.file_lights_on = 1;
+    }
+
+    switch(qc15_mode) {
+    case QC15_MODE_STATUS:
+        status_handle_loop();
+        break;
+    case QC15_MODE_GAME:
+        game_handle_loop();
+        break;
+    case QC15_MODE_TEXTENTRY:
+        textentry_handle_loop();
+        break;
+    case QC15_MODE_CONTROLLER:
+        controller_handle_loop();
+        break;
+    default:
+        // Name searches and connections wait for the script.
+        break;
+    }
+
+    s_left = 0;
+    s_right = 0;
+    s_down = 0;
+    s_up = 0;
+    s_clock_tick = 0;
+    s_flash_job_done = 0;
+    ticks_run++;
+
+    lookups = flash_cache_hits + flash_cache_misses - lookups;
+    lcd_writes = lcd_model_writes(LCD_TOP) + lcd_model_writes(LCD_BTM)
+                 - lcd_writes;
+    lcd_ns = lcd_model_bus_ns(LCD_TOP) + lcd_model_bus_ns(LCD_BTM) - lcd_ns;
+    flash_bus_totals(&cmds_after, &bytes_after);
+
+    total_lookups += lookups;
+    total_bus_reads += cmds_after - bus_cmds;
+    total_lcd_writes += lcd_writes;
+    if (lookups > worst_lookups)
+        worst_lookups = lookups;
+    if (lcd_writes > worst_lcd_writes)
+        worst_lcd_writes = lcd_writes;
+
+    if (game_curr_state_id != state_before)
+        event("  state %u %s -> %u %s\n", state_before,
+              state_name(state_before), game_curr_state_id,
+              state_name(game_curr_state_id));
+    if (qc15_mode != mode_before)
+        event("  mode %s -> %s\n", mode_name(mode_before),
+              mode_name(qc15_mode));
+
+    if (!events_len && !lookups && !lcd_writes)
+        return;
+
+    printf("%7lu", (unsigned long) qc_clock.time);
+    if (!quiet)
+        printf("  flash %u (bus %lu, %lu B)  lcd %u (%.1f ms)",
+               lookups, (unsigned long) (cmds_after - bus_cmds),
+               (unsigned long) (bytes_after - bus_bytes), lcd_writes,
+               lcd_ns / 1e6);
+    printf("\n%s", events);
+    events_clear();
+
+    for (uint8_t lcd_id=LCD_TOP+1; lcd_id-- > 0; ) {
+        if (strcmp(screens_before[lcd_id], lcd_model[lcd_id].text)) {
+            printf("  %s |", lcd_id == LCD_TOP ? "top" : "btm");
+            print_screen_text(stdout, lcd_model[lcd_id].text, LCD_MODEL_COLS);
+            printf("|\n");
+        }
+    }
+}
+
+/// Press a button for one time loop.
+void press(uint8_t *signal) {
+    *signal = 1;
+    tick();
+}
+
+uint16_t parse_state(const char *arg) {
+    for (uint16_t i=0; i<all_states_len; i++) {
+        if (!strcasecmp(arg, state_names[i]))
+            return i;
+    }
+    return (uint16_t) strtoul(arg, 0, 0);
+}
+
+void expect_failed(const char *what, const char *wanted, const char *got) {
+    printf("EXPECT FAILED (line %lu): %s is \"%s\", wanted \"%s\"\n",
+           (unsigned long) script_line, what, got, wanted);
+    expect_failures++;
+}
+
+void expect(char *arg) {
+    char *what = strtok(arg, " \t");
+    char *wanted = strtok(0, "");
+    char got[LCD_MODEL_COLS+1];
+    uint8_t lcd_id;
+
+    if (!what)
+        return;
+    if (!wanted)
+        wanted = "";
+
+    if (!strcmp(what, "state")) {
+        if (parse_state(wanted) != game_curr_state_id) {
+            snprintf(got, sizeof(got), "%u", game_curr_state_id);
+            expect_failed("state", wanted, got);
+        }
+        return;
+    }
+
+    lcd_id = strcmp(what, "top") ? LCD_BTM : LCD_TOP;
+    strcpy(got, lcd_model[lcd_id].text);
+    for (int8_t i=LCD_MODEL_COLS-1; i>=0 && got[i] == ' '; i--)
+        got[i] = 0;
+    if (strcmp(got, wanted))
+        expect_failed(what, wanted, got);
+}
+
+/// Enter `text` into the text entry with up and right presses.
+void type_text(const char *text) {
+    for (const char *c = text; *c; c++) {
+        uint16_t presses = 0;
+        while (qc15_mode == QC15_MODE_TEXTENTRY &&
+                curr_text[text_entry_cursor_pos] != *c) {
+            if (++presses > TYPE_MAX_PRESSES) {
+                printf("line %lu: can't type '%c'\n",
+                       (unsigned long) script_line, *c);
+                exit(2);
+            }
+            press(&s_up);
+        }
+        press(&s_right);
+    }
+    // The cursor is now on the ENTER character; select it.
+    if (qc15_mode == QC15_MODE_TEXTENTRY)
+        press(&s_right);
+}
+
+void run_command(char *line) {
+    char *cmd, *arg;
+    uint32_t n;
+
+    line[strcspn(line, "#\r\n")] = 0;
+    cmd = strtok(line, " \t");
+    if (!cmd)
+        return;
+    arg = strtok(0, "");
+    if (arg)
+        arg += strspn(arg, " \t");
+    n = (arg && isdigit((uint8_t) *arg)) ? strtoul(arg, 0, 0) : 1;
+
+    if (!strcmp(cmd, "tick")) {
+        while (n--)
+            tick();
+    } else if (!strcmp(cmd, "idle")) {
+        n = (arg && *arg) ? n : IDLE_MAX;
+        while (n-- && qc15_mode == QC15_MODE_GAME && in_action_series)
+            tick();
+    } else if (!strcmp(cmd, "up")) {
+        while (n--) press(&s_up);
+    } else if (!strcmp(cmd, "down")) {
+        while (n--) press(&s_down);
+    } else if (!strcmp(cmd, "left")) {
+        while (n--) press(&s_left);
+    } else if (!strcmp(cmd, "right")) {
+        while (n--) press(&s_right);
+    } else if (!strcmp(cmd, "type")) {
+        type_text(arg ? arg : "");
+    } else if (!strcmp(cmd, "nearby")) {
+        badges_nearby = n;
+        game_update_nearby();
+    } else if (!strcmp(cmd, "name")) {
+        game_name_search_done(arg && !strcmp(arg, "found"));
+        qc15_mode = QC15_MODE_GAME;
+    } else if (!strcmp(cmd, "connect")) {
+        if (arg && !strcmp(arg, "new"))
+            game_post_special(SPECIAL_CONNECT_SUCCESS_NEW);
+        else if (arg && !strcmp(arg, "old"))
+            game_post_special(SPECIAL_CONNECT_SUCCESS_OLD);
+        else
+            game_post_special(SPECIAL_CONNECT_FAILURE);
+        qc15_mode = QC15_MODE_GAME;
+    } else if (!strcmp(cmd, "solved")) {
+        game_post_special(SPECIAL_CONNECT_SUCCESS_DONE);
+    } else if (!strcmp(cmd, "state")) {
+        game_set_state(parse_state(arg ? arg : "0"), 1);
+    } else if (!strcmp(cmd, "seed")) {
+        srand(n);
+    } else if (!strcmp(cmd, "expect")) {
+        expect(arg ? arg : "");
+    } else {
+        printf("line %lu: unknown command %s\n", (unsigned long) script_line,
+               cmd);
+        exit(2);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char line[256];
+    const char *game_image = 0;
+    uint16_t badge_id = 1;
+    FILE *script;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "g:d:b:q")) != -1) {
+        switch (opt) {
+        case 'g': game_image = optarg; break;
+        case 'd': load_state_names(optarg); break;
+        case 'b': badge_id = strtoul(optarg, 0, 0); break;
+        case 'q': quiet = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-g game.bin] [-d state_definitions.h]"
+                    " [-b badge_id] [-q] script\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "%s: no script\n", argv[0]);
+        return 2;
+    }
+    script = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+    if (!script) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    s25fs_init_io();
+    s25fs_init();
+    flash_cache_init();
+    if (game_image)
+        load_game_image(game_image);
+    lcd_model_reset();
+    lcd111_init();
+    game_init();
+
+    // A fresh badge that's past the countdown, on a working radio channel.
+    memset(&badge_conf, 0, sizeof(badge_conf));
+    badge_conf.badge_id = badge_id;
+    memcpy(badge_conf.badge_name, badge_names[badge_id % QC15_BADGES_IN_SYSTEM],
+           QC15_BADGE_NAME_LEN);
+    strcpy(badge_conf.person_name, "Runner");
+    badge_conf.freq_set = 1;
+    badge_conf.countdown_over = 1;
+    save_config(0);
+
+    // main.c sets the mode first, and renders from a current_state that
+    //  doesn't point anywhere yet; the MSP430 shrugs that off, but we can't.
+    game_begin();
+    qc15_set_mode(QC15_MODE_GAME);
+    tick();
+
+    while (fgets(line, sizeof(line), script)) {
+        script_line++;
+        run_command(line);
+    }
+
+    printf("\n%lu time loops: %lu flash reads (%lu on the bus), "
+           "%lu LCD writes\n", (unsigned long) ticks_run,
+           (unsigned long) total_lookups, (unsigned long) total_bus_reads,
+           (unsigned long) total_lcd_writes);
+    printf("worst time loop: %u flash reads, %u LCD writes\n", worst_lookups,
+           worst_lcd_writes);
+    printf("state prefetch: %lu of %lu state changes hit\n",
+           (unsigned long) game_prefetch_hits,
+           (unsigned long) (game_prefetch_hits + game_prefetch_misses));
+    if (expect_failures)
+        printf("%lu expectation(s) failed\n", (unsigned long) expect_failures);
+    return expect_failures ? 1 : 0;
+}
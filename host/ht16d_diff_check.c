@@ -0,0 +1,198 @@
+/// Check the LED controller driver's diffed frames against full resends.
+/**
+ ** This links the firmware's ht16d35b.c against the controller model
+ ** (ht16d_model.c), with interrupts off, so every frame goes out as it's
+ ** built. After each random change to `ht16d_gs_values`, it sends the
+ ** diffed frame, and then, from the same start, the full frame that
+ ** `ht16d_send_gray()` sends when it doesn't trust `ht16d_sent_gray`, and
+ ** checks that the controller ends up showing the same thing either way.
+ ** Then it puts the diffed result back, so that the next frame diffs
+ ** against what the driver really sent.
+ **
+ ** It also checks the cases that the diffing has to get just right: two
+ ** changed rows with a gap between them, which should be one write while
+ ** the gap is up to HT16D_ROW_GAP_MAX rows and two after that, and changes
+ ** to LED 0's red, which shares its mapping with the unused rows, and
+ ** should still be one write, to its one used row.
+ **
+ ** Usage: ht16d_diff_check [frames]
+ **
+ ** Exits nonzero on any mismatch.
+ **
+ ** \file ht16d_diff_check.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <msp430.h>
+
+#include "ht16d35b.h"
+#include "ht16d_model.h"
+
+// From ht16d35b.c:
+#define HT16D_LED_COUNT 24
+#define HT16D_ROW_GAP_MAX 3
+
+extern uint8_t ht16d_gs_values[HT16D_LED_COUNT][3];
+extern const uint8_t ht16d_gamma[256];
+extern const uint8_t ht16d_col_mapping[3][28][2];
+extern uint8_t ht16d_sent_gray[3][28];
+extern uint8_t ht16d_sent_gray_valid;
+
+uint32_t seed = 1;
+
+uint32_t rnd() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/// Report a check, returning 1 if it failed.
+uint8_t result(const char *what, uint32_t bad) {
+    printf("%-40s %s", what, bad ? "MISMATCH" : "ok");
+    if (bad)
+        printf(" (%lu bad)", (unsigned long) bad);
+    printf("\n");
+    return bad ? 1 : 0;
+}
+
+uint8_t row_unused(uint8_t row) {
+    return row == 21 || row == 22 || row == 26 || row == 27;
+}
+
+/// Change some LEDs, the way a time loop might.
+void random_frame() {
+    uint8_t changes;
+
+    switch (rnd() % 16) {
+    case 0:
+        // Nothing at all.
+        return;
+    case 1:
+        // Everything.
+        for (uint8_t led=0; led<HT16D_LED_COUNT; led++)
+            for (uint8_t rgb=0; rgb<3; rgb++)
+                ht16d_gs_values[led][rgb] = rnd();
+        return;
+    default:
+        changes = 1 + rnd() % 8;
+        while (changes--)
+            ht16d_gs_values[rnd() % HT16D_LED_COUNT][rnd() % 3] = rnd();
+    }
+}
+
+/// Change what `col`, `row` shows to something that looks different.
+void change_row(uint8_t col, uint8_t row) {
+    uint8_t *value = &ht16d_gs_values[ht16d_col_mapping[col][row][0]]
+                                     [ht16d_col_mapping[col][row][1]];
+    uint8_t old = ht16d_gamma[*value];
+
+    while (ht16d_gamma[*value] == old)
+        *value = rnd();
+}
+
+/// Send a frame, and return how many writes it took.
+uint32_t send_writes() {
+    uint32_t writes = ht16d_model.writes;
+
+    ht16d_send_gray();
+    return ht16d_model.writes - writes;
+}
+
+/// Count the used rows that differ between two copies of display memory.
+uint32_t ram_bad(const uint8_t *a, const uint8_t *b) {
+    uint32_t bad = 0;
+
+    for (uint8_t col=0; col<3; col++)
+        for (uint8_t row=0; row<28; row++)
+            if (!row_unused(row) && a[0x20*col + row] != b[0x20*col + row])
+                bad++;
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t frames = 50000;
+    uint32_t bad = 0;
+    uint32_t diff_bytes = 0;
+    uint32_t full_bytes = 0;
+    uint8_t failed = 0;
+    uint8_t diffed[HT16D_MODEL_RAM_LEN];
+    uint8_t sent_gray[3][28];
+    char what[64];
+
+    if (argc > 1)
+        frames = strtoul(argv[1], 0, 0);
+
+    ht16d_model_reset();
+    ht16d_init();
+    ht16d_display_on();
+
+    for (uint32_t f=0; f<frames; f++) {
+        uint32_t bytes;
+
+        random_frame();
+        bytes = ht16d_model.bytes;
+        ht16d_send_gray();
+        diff_bytes += ht16d_model.bytes - bytes;
+        memcpy(diffed, ht16d_model.ram, sizeof(diffed));
+        memcpy(sent_gray, ht16d_sent_gray, sizeof(sent_gray));
+
+        ht16d_sent_gray_valid = 0;
+        bytes = ht16d_model.bytes;
+        ht16d_send_gray();
+        full_bytes += ht16d_model.bytes - bytes;
+        bad += ram_bad(diffed, ht16d_model.ram);
+
+        memcpy(ht16d_model.ram, diffed, sizeof(diffed));
+        memcpy(ht16d_sent_gray, sent_gray, sizeof(sent_gray));
+    }
+    printf("%lu random frames: %lu bytes diffed, %lu bytes resending all\n",
+           (unsigned long) frames, (unsigned long) diff_bytes,
+           (unsigned long) full_bytes);
+    failed |= result("diffed frames against full resends", bad);
+
+    // Two changed rows in COM 1, with `gap` unchanged rows between them.
+    for (uint8_t gap=0; gap<=HT16D_ROW_GAP_MAX+1; gap++) {
+        uint32_t writes;
+
+        send_writes();
+        change_row(1, 2);
+        change_row(1, 3+gap);
+        writes = send_writes();
+        sprintf(what, "gap of %u rows: %lu write(s)", gap,
+                (unsigned long) writes);
+        failed |= result(what, writes != (gap <= HT16D_ROW_GAP_MAX ? 1 : 2));
+    }
+    memcpy(diffed, ht16d_model.ram, sizeof(diffed));
+    ht16d_sent_gray_valid = 0;
+    send_writes();
+    failed |= result("gaps against a full resend",
+                     ram_bad(diffed, ht16d_model.ram));
+
+    // LED 0's red is in COM 2 at row 15, and in all of the unused rows, so
+    //  changing it should be one write of one row, and nothing else.
+    bad = 0;
+    for (uint8_t i=0; i<8; i++) {
+        uint32_t bytes;
+
+        send_writes();
+        memcpy(diffed, ht16d_model.ram, sizeof(diffed));
+        change_row(2, 15);
+        bytes = ht16d_model.bytes;
+        if (send_writes() != 1 || ht16d_model.bytes - bytes != 4)
+            bad++;
+        for (uint8_t col=0; col<3; col++)
+            for (uint8_t row=0; row<28; row++)
+                if (row_unused(row)
+                        && ht16d_model.ram[0x20*col + row] != diffed[0x20*col + row])
+                    bad++;
+    }
+    failed |= result("LED 0 red, and not the unused rows", bad);
+
+    return failed;
+}
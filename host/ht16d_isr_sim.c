@@ -0,0 +1,185 @@
+/// Run the LED controller driver's I2C ISR against random frames.
+/**
+ ** This links the firmware's ht16d35b.c against the controller model
+ ** (ht16d_model.c), brings the controller up the way the badge does, with
+ ** interrupts off, and then turns them on, so that `ht16d_send_gray()`
+ ** hands every frame to `HT16D_I2C_ISR()`. Between frames, the bus gets a
+ ** fixed number of byte times, from far too few for a frame to finish
+ ** (so the queued frames overrun) to plenty (so the bus goes idle). Now and
+ ** then the controller NACKs a write.
+ **
+ ** Every few dozen frames, it lets the bus finish and checks that the
+ ** driver's record of the display memory (`ht16d_sent_gray`, when it claims
+ ** to be good) is what the controller has. Then it sends one more frame, the
+ ** way the next LED change would, and checks that the controller shows
+ ** `ht16d_gs_values`.
+ **
+ ** Usage: ht16d_isr_sim [frames]
+ **
+ ** Exits nonzero on any mismatch.
+ **
+ ** \file ht16d_isr_sim.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <msp430.h>
+
+#include "ht16d35b.h"
+#include "ht16d_model.h"
+
+// From ht16d35b.c:
+#define HT16D_LED_COUNT 24
+#define HT16D_FRAME_NONE 0xFF
+
+/// How often to stop and check, in frames.
+#define CHECK_EVERY 50
+/// About one write in this many is NACKed.
+#define NACK_ODDS 200
+
+extern uint8_t ht16d_gs_values[HT16D_LED_COUNT][3];
+extern const uint8_t ht16d_gamma[256];
+extern const uint8_t ht16d_col_mapping[3][28][2];
+extern uint8_t ht16d_sent_gray[3][28];
+extern uint8_t ht16d_sent_gray_valid;
+extern volatile uint8_t ht16d_frame_sending;
+
+/// Byte times on the bus between frames.
+const uint32_t bus_speeds[] = {1, 8, 30, 90, 200, 100000};
+
+uint32_t seed = 1;
+
+uint32_t rnd() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/// Report a check, returning 1 if it failed.
+uint8_t result(const char *what, uint32_t bad) {
+    printf("%-40s %s", what, bad ? "MISMATCH" : "ok");
+    if (bad)
+        printf(" (%lu bad)", (unsigned long) bad);
+    printf("\n");
+    return bad ? 1 : 0;
+}
+
+/// Change some LEDs, the way a time loop might.
+void random_frame() {
+    uint8_t changes;
+
+    switch (rnd() % 16) {
+    case 0:
+    case 1:
+    case 2:
+        // Nothing at all.
+        return;
+    case 3:
+        // Everything.
+        for (uint8_t led=0; led<HT16D_LED_COUNT; led++)
+            for (uint8_t rgb=0; rgb<3; rgb++)
+                ht16d_gs_values[led][rgb] = rnd();
+        return;
+    default:
+        changes = 1 + rnd() % 6;
+        while (changes--)
+            ht16d_gs_values[rnd() % HT16D_LED_COUNT][rnd() % 3] = rnd();
+    }
+}
+
+/// Let the bus run until the ISR has nothing left to send.
+void drain() {
+    while (ht16d_frame_sending != HT16D_FRAME_NONE || (UCB0CTLW0 & UCTXSTT))
+        ht16d_model_bus_run(1);
+    // The last byte and the STOP.
+    ht16d_model_bus_run(2);
+}
+
+/// Count the used rows where the controller doesn't show `ht16d_gs_values`.
+uint32_t display_bad() {
+    uint32_t bad = 0;
+
+    for (uint8_t col=0; col<3; col++) {
+        for (uint8_t row=0; row<28; row++) {
+            uint8_t led = ht16d_col_mapping[col][row][0];
+            uint8_t rgb = ht16d_col_mapping[col][row][1];
+
+            if (row == 21 || row == 22 || row == 26 || row == 27)
+                continue;
+            if (ht16d_model.ram[0x20*col + row]
+                    != ht16d_gamma[ht16d_gs_values[led][rgb]])
+                bad++;
+        }
+    }
+    return bad;
+}
+
+/// Count the used rows where a valid `ht16d_sent_gray` is wrong.
+uint32_t shadow_bad() {
+    uint32_t bad = 0;
+
+    if (!ht16d_sent_gray_valid)
+        return 0;
+    for (uint8_t col=0; col<3; col++) {
+        for (uint8_t row=0; row<28; row++) {
+            if (row == 21 || row == 22 || row == 26 || row == 27)
+                continue;
+            if (ht16d_model.ram[0x20*col + row] != ht16d_sent_gray[col][row])
+                bad++;
+        }
+    }
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t frames = 50000;
+    uint8_t failed = 0;
+
+    if (argc > 1)
+        frames = strtoul(argv[1], 0, 0);
+
+    for (uint8_t s=0; s<sizeof(bus_speeds)/sizeof(bus_speeds[0]); s++) {
+        uint32_t bad_shadow = 0;
+        uint32_t bad_display = 0;
+
+        host_sr = 0;
+        ht16d_model_reset();
+        ht16d_init();
+        ht16d_display_on();
+        ht16d_frames_done = 0;
+        ht16d_frames_overrun = 0;
+        __enable_interrupt();
+
+        for (uint32_t f=1; f<=frames; f++) {
+            random_frame();
+            ht16d_send_gray();
+            if (!(rnd() % NACK_ODDS))
+                ht16d_model_nack_next = 1;
+            ht16d_model_bus_run(bus_speeds[s]);
+
+            if (f % CHECK_EVERY && f != frames)
+                continue;
+            ht16d_model_nack_next = 0;
+            drain();
+            bad_shadow += shadow_bad();
+            ht16d_send_gray();
+            drain();
+            bad_display += display_bad();
+        }
+
+        printf("%lu byte times a frame: %lu frames sent, %lu overrun, "
+               "%lu NACKed writes\n", (unsigned long) bus_speeds[s],
+               (unsigned long) ht16d_frames_done,
+               (unsigned long) ht16d_frames_overrun,
+               (unsigned long) ht16d_model.nacks);
+        failed |= result("  driver's copy of display memory", bad_shadow);
+        failed |= result("  display memory", bad_display);
+    }
+
+    return failed;
+}
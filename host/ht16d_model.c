@@ -0,0 +1,181 @@
+/// Host model of the HT16D35B LED controller, behind eUSCI_B0's I2C.
+/**
+ ** This sits under the real ht16d35b.c. On the host, interrupts are never
+ ** enabled, so the driver sends everything with `ht16d_send_array()`: it
+ ** sets the byte count for auto-stop in UCB0TBCNT, sends a START, writes
+ ** each byte to UCB0TXBUF once UCTXIFG is set, and then waits for UCSTPIFG.
+ ** The host msp430.h routes UCB0IFG and UCB0TXBUF through here, so we
+ ** collect the bytes, and once the auto-stop count has gone out, treat them
+ ** as one write to the controller. The flags always read as ready.
+ **
+ ** With interrupts on, the driver hands frames to its I2C ISR instead. Then
+ ** the caller lets time pass on the bus with `ht16d_model_bus_run()`, which
+ ** raises the interrupts the ISR has enabled as each byte goes out: TX
+ ** buffer empty, the auto-stop, and, for a write that
+ ** `ht16d_model_nack_next` says to refuse, NACK and then the STOP the ISR
+ ** asks for.
+ **
+ ** The model keeps the controller's display memory, global brightness and
+ ** display state, which is all the firmware changes once it's initialized,
+ ** and counts the writes and the bytes. Reads (`ht16d_read_reg()`) aren't
+ ** modelled.
+ **
+ ** \file ht16d_model.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <msp430.h>
+
+#include "ht16d_model.h"
+
+#define HTCMD_WRITE_DISPLAY 0x80
+#define HTCMD_SYS_OSC_CTL   0x35
+#define HTCMD_GLOBAL_BRTNS  0x37
+
+/// The longest write the driver makes is a whole COM: 2 + 28 bytes.
+#define HT16D_MODEL_WRITE_MAX 64
+
+extern const uint8_t ht16d_col_mapping[3][28][2];
+void HT16D_I2C_ISR();
+
+ht16d_model_t ht16d_model;
+
+/// The current write's bytes, as the driver puts them in UCB0TXBUF.
+volatile uint16_t ht16d_model_tx[HT16D_MODEL_WRITE_MAX];
+uint8_t ht16d_model_tx_len = 0;
+volatile uint16_t ht16d_model_flags;
+/// Whether the interrupt-driven bus is in the middle of a write.
+uint8_t ht16d_model_bus_sending = 0;
+/// Set to have the controller NACK the next write that starts.
+uint8_t ht16d_model_nack_next = 0;
+
+void ht16d_model_reset() {
+    memset(&ht16d_model, 0, sizeof(ht16d_model));
+    ht16d_model_tx_len = 0;
+    ht16d_model_bus_sending = 0;
+    ht16d_model_nack_next = 0;
+}
+
+/// How long the bus has been busy: 9 bits a byte, plus START and STOP.
+uint64_t ht16d_model_bus_ns() {
+    return (ht16d_model.bytes * 9ULL + ht16d_model.writes * 2ULL)
+            * HT16D_MODEL_BIT_NS;
+}
+
+void ht16d_model_write(volatile uint16_t *data, uint8_t len) {
+    ht16d_model.writes++;
+    ht16d_model.bytes += len + 1;
+
+    switch (data[0]) {
+    case HTCMD_WRITE_DISPLAY:
+        for (uint8_t i=2; i<len; i++)
+            ht16d_model.ram[(data[1] + i - 2) % HT16D_MODEL_RAM_LEN] = data[i];
+        break;
+    case HTCMD_GLOBAL_BRTNS:
+        ht16d_model.brightness = data[1];
+        break;
+    case HTCMD_SYS_OSC_CTL:
+        ht16d_model.osc_ctl = data[1];
+        break;
+    }
+    // The rest only set up the controller.
+}
+
+volatile uint16_t *ht16d_model_ifg() {
+    // The auto-stop fires once the whole count has been written.
+    if (ht16d_model_tx_len && ht16d_model_tx_len >= UCB0TBCNT) {
+        ht16d_model_write(ht16d_model_tx, ht16d_model_tx_len);
+        ht16d_model_tx_len = 0;
+    }
+    ht16d_model_flags = UCTXIFG0 | UCSTPIFG;
+    return &ht16d_model_flags;
+}
+
+volatile uint16_t *ht16d_model_txbuf() {
+    if (ht16d_model_tx_len == HT16D_MODEL_WRITE_MAX)
+        ht16d_model_tx_len--;
+    return &ht16d_model_tx[ht16d_model_tx_len++];
+}
+
+/// Run the ISR for interrupt vector `iv`, if `ie` is enabled.
+void ht16d_model_irq(uint16_t iv, uint16_t ie) {
+    if (!(UCB0IE & ie))
+        return;
+    UCB0IV = iv;
+    HT16D_I2C_ISR();
+}
+
+/// Let `byte_times` bytes' worth of time pass on the bus, with interrupts on.
+void ht16d_model_bus_run(uint32_t byte_times) {
+    if (!(host_sr & GIE))
+        return;
+
+    while (byte_times--) {
+        if (!ht16d_model_bus_sending) {
+            // Only the ISR could start a write, so the bus stays idle.
+            if (!(UCB0CTLW0 & UCTXSTT))
+                return;
+            // A START and the address byte.
+            UCB0CTLW0 &= ~UCTXSTT;
+            ht16d_model_tx_len = 0;
+            if (ht16d_model_nack_next) {
+                ht16d_model_nack_next = 0;
+                ht16d_model.nacks++;
+                ht16d_model_irq(USCI_I2C_UCNACKIFG, UCNACKIE);
+                if (UCB0CTLW0 & UCTXSTP) {
+                    UCB0CTLW0 &= ~UCTXSTP;
+                    ht16d_model_irq(USCI_I2C_UCSTPIFG, UCSTPIE);
+                }
+                continue;
+            }
+            ht16d_model_bus_sending = 1;
+            ht16d_model_irq(USCI_I2C_UCTXIFG0, UCTXIE0);
+            continue;
+        }
+
+        // A byte from UCB0TXBUF goes out.
+        if (ht16d_model_tx_len >= UCB0TBCNT) {
+            ht16d_model_write(ht16d_model_tx, ht16d_model_tx_len);
+            ht16d_model_tx_len = 0;
+            ht16d_model_bus_sending = 0;
+            ht16d_model_irq(USCI_I2C_UCSTPIFG, UCSTPIE);
+        } else {
+            ht16d_model_irq(USCI_I2C_UCTXIFG0, UCTXIE0);
+        }
+    }
+}
+
+/// What color `led` (in ht16d_gs_values order) looks like, in sRGB.
+/**
+ ** The controller drives each channel with PWM, at its 6-bit display memory
+ ** value times the global brightness, out of 63 * 64. That's linear light,
+ ** so we gamma-encode it for the screen, so that it looks about as bright as
+ ** the LED does. A display that's off is black.
+ */
+void ht16d_model_led_color(uint8_t led, uint8_t rgb[3]) {
+    memset(rgb, 0, 3);
+    if (ht16d_model.osc_ctl != 0b11)
+        return;
+
+    for (uint8_t col=0; col<3; col++) {
+        for (uint8_t row=0; row<28; row++) {
+            double duty;
+
+            if (ht16d_col_mapping[col][row][0] != led)
+                continue;
+            // Unused rows map to LED 0, red, but they're never written.
+            if (row == 21 || row == 22 || row == 26 || row == 27)
+                continue;
+            duty = (ht16d_model.ram[0x20*col + row] & 0x3F) / 63.0
+                    * ht16d_model.brightness / 64.0;
+            rgb[ht16d_col_mapping[col][row][1]] =
+                    (uint8_t) (255 * pow(duty, 1 / 2.2) + 0.5);
+        }
+    }
+}
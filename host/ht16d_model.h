@@ -0,0 +1,48 @@
+/// Header for the host model of the HT16D35B LED controller.
+/**
+ ** \file ht16d_model.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HT16D_MODEL_H_
+#define HT16D_MODEL_H_
+
+#include <stdint.h>
+
+/// Display memory: four COMs, 0x20 apart, of up to 28 rows each.
+#define HT16D_MODEL_RAM_LEN 0x80
+
+/// What the controller is displaying, and how much bus traffic it has taken.
+/**
+ ** The counters come first, so that the layout is the same with and without
+ ** the firmware's -fpack-struct.
+ */
+typedef struct {
+    /// I2C write transactions.
+    uint32_t writes;
+    /// Bytes on the bus, including each write's address byte.
+    uint32_t bytes;
+    /// Writes refused, because of `ht16d_model_nack_next`.
+    uint32_t nacks;
+    /// Grayscale display memory (6 bits per byte), by 0x20*COM+ROW.
+    uint8_t ram[HT16D_MODEL_RAM_LEN];
+    /// Global brightness, 0 to 64.
+    uint8_t brightness;
+    /// The last system/oscillator control value; 0b11 is display on.
+    uint8_t osc_ctl;
+} ht16d_model_t;
+
+/// One I2C bit at 333 kHz.
+#define HT16D_MODEL_BIT_NS 3000ULL
+
+extern ht16d_model_t ht16d_model;
+extern uint8_t ht16d_model_nack_next;
+
+void ht16d_model_reset();
+void ht16d_model_bus_run(uint32_t byte_times);
+uint64_t ht16d_model_bus_ns();
+void ht16d_model_led_color(uint8_t led, uint8_t rgb[3]);
+
+#endif /* HT16D_MODEL_H_ */
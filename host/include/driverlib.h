@@ -0,0 +1,96 @@
+/// Host stand-in for the parts of MSP430 driverlib the firmware uses.
+/**
+ ** Most of these are no-ops. The CRC functions are a software model of the
+ ** CRC16 module, so CRCs computed on the host match the badge.
+ **
+ ** \file driverlib.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HOST_DRIVERLIB_H_
+#define HOST_DRIVERLIB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "msp430.h"
+
+#define CRC_BASE 0
+
+void CRC_setSeed(uint16_t base, uint16_t seed);
+void CRC_set8BitData(uint16_t base, uint8_t data);
+uint16_t CRC_getResult(uint16_t base);
+
+#define GPIO_PORT_P1 1
+#define GPIO_PORT_P2 2
+#define GPIO_PORT_P3 3
+#define GPIO_PORT_P6 6
+#define GPIO_PORT_P7 7
+#define GPIO_PORT_P9 9
+#define GPIO_PORT_PJ 13
+#define GPIO_PIN0 BIT0
+#define GPIO_PIN1 BIT1
+#define GPIO_PIN2 BIT2
+#define GPIO_PIN3 BIT3
+#define GPIO_PIN4 BIT4
+#define GPIO_PIN5 BIT5
+#define GPIO_PIN6 BIT6
+#define GPIO_PIN7 BIT7
+#define GPIO_PRIMARY_MODULE_FUNCTION 1
+
+#define GPIO_setAsOutputPin(port, pins) ((void) 0)
+#define GPIO_setAsInputPin(port, pins) ((void) 0)
+#define GPIO_setAsPeripheralModuleFunctionOutputPin(port, pins, fn) ((void) 0)
+#define GPIO_setAsPeripheralModuleFunctionInputPin(port, pins, fn) ((void) 0)
+
+// eUSCI_B SPI, which drives the LCDs' shift register. Transmitting is
+//  modelled by lcd_model.c; everything else is a no-op.
+#define EUSCI_B1_BASE 1
+#define EUSCI_B_SPI_PHASE_DATA_CAPTURED_ONFIRST_CHANGED_ON_NEXT 0
+#define EUSCI_B_SPI_CLOCKPOLARITY_INACTIVITY_LOW 0
+#define EUSCI_B_SPI_MSB_FIRST 0
+#define EUSCI_B_SPI_3PIN 0
+#define EUSCI_B_SPI_CLOCKSOURCE_SMCLK 0
+
+typedef struct {
+    uint8_t selectClockSource;
+    uint32_t clockSourceFrequency;
+    uint32_t desiredSpiClock;
+    uint16_t msbFirst;
+    uint16_t clockPhase;
+    uint16_t clockPolarity;
+    uint16_t spiMode;
+} EUSCI_B_SPI_initMasterParam;
+
+#define EUSCI_B_SPI_initMaster(base, param) ((void) (param))
+#define EUSCI_B_SPI_isBusy(base) 0
+void EUSCI_B_SPI_transmitData(uint16_t base, uint8_t data);
+
+// eUSCI_A SPI, which drives the SPI flash. s25fs_bus.c takes the bus clock
+//  from the parameters, and models the registers.
+#define EUSCI_A1_BASE 1
+#define EUSCI_A_SPI_PHASE_DATA_CAPTURED_ONFIRST_CHANGED_ON_NEXT 0
+#define EUSCI_A_SPI_CLOCKPOLARITY_INACTIVITY_LOW 0
+#define EUSCI_A_SPI_MSB_FIRST 0
+#define EUSCI_A_SPI_3PIN 0
+#define EUSCI_A_SPI_CLOCKSOURCE_SMCLK 0
+
+typedef EUSCI_B_SPI_initMasterParam EUSCI_A_SPI_initMasterParam;
+
+void EUSCI_A_SPI_initMaster(uint16_t base, EUSCI_A_SPI_initMasterParam *param);
+#define EUSCI_A_SPI_enable(base) ((void) 0)
+
+// eUSCI_B I2C, which drives the LED controller. ht16d35b.c uses the
+//  registers directly, and ht16d_model.c models them.
+#define EUSCI_B0_BASE 0
+#define EUSCI_B_I2C_enable(base) ((void) 0)
+
+#define WDT_A_BASE 0
+#define WDT_A_hold(base) ((void) 0)
+#define WDT_A_resetTimer(base) ((void) 0)
+
+#define PMM_unlockLPM5() ((void) 0)
+
+#endif /* HOST_DRIVERLIB_H_ */
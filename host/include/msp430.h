@@ -0,0 +1,158 @@
+/// Host stand-in for the TI MSP430 device header.
+/**
+ ** This lets firmware sources from ccs_workspace compile with the host's gcc,
+ ** for the tools in this directory. It declares the peripheral registers the
+ ** compiled firmware touches as plain variables (defined in msp430_host.c),
+ ** and turns the intrinsics into their nearest host equivalents. None of it
+ ** does anything a peripheral would; modules that need real behavior (the
+ ** SPI flash, the LCDs, the LED driver) are replaced or modeled separately.
+ **
+ ** The status register is a plain variable, so interrupts are only "enabled"
+ ** if the firmware enables them, and going into LPM calls `host_lpm_hook`
+ ** (if a model has set it) to run whatever would have woken the CPU up.
+ ** `__delay_cycles()` returns right away, but counts the cycles in
+ ** `host_delay_cycles`, for models that need to know time went by.
+ **
+ ** \file msp430.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HOST_MSP430_H_
+#define HOST_MSP430_H_
+
+#include <stdint.h>
+
+#define BIT0 0x0001
+#define BIT1 0x0002
+#define BIT2 0x0004
+#define BIT3 0x0008
+#define BIT4 0x0010
+#define BIT5 0x0020
+#define BIT6 0x0040
+#define BIT7 0x0080
+#define BIT8 0x0100
+#define BIT9 0x0200
+#define BITA 0x0400
+#define BITB 0x0800
+#define BITC 0x1000
+#define BITD 0x2000
+#define BITE 0x4000
+#define BITF 0x8000
+
+#define GIE 0x0008
+#define LPM0_bits 0x0010
+#define LPM3_bits 0x00D0
+
+#define LPM0
+#define LPM3
+#define LPM0_EXIT
+#define LPM3_EXIT
+
+extern volatile uint16_t host_sr;
+extern volatile uint64_t host_delay_cycles;
+extern void (*host_lpm_hook)();
+void host_bis_SR_register(uint16_t bits);
+void host_data16_write_addr(unsigned short addr, unsigned long val);
+
+#define __interrupt
+#define __delay_cycles(x) ((void) (host_delay_cycles += (x)))
+#define __no_operation() ((void) 0)
+#define __enable_interrupt() ((void) (host_sr |= GIE))
+#define __disable_interrupt() ((void) (host_sr &= ~GIE))
+#define __bis_SR_register(x) host_bis_SR_register(x)
+#define __bic_SR_register(x) ((void) (host_sr &= ~(x)))
+#define __get_SR_register() (host_sr)
+#define __even_in_range(x, y) (x)
+#define __data16_write_addr(addr, val) host_data16_write_addr(addr, val)
+
+// eUSCI_A1 (SPI flash)
+extern volatile uint16_t UCA1CTLW0;
+// The flags, the buffers and chip select go through the flash bus model
+//  (s25fs_bus.c), so it can clock each byte through the chip.
+volatile uint16_t *s25fs_bus_ifg();
+volatile uint16_t *s25fs_bus_txbuf();
+volatile uint16_t *s25fs_bus_rxbuf();
+volatile uint8_t *s25fs_bus_p3out();
+#define UCA1IFG (*s25fs_bus_ifg())
+#define UCA1TXBUF (*s25fs_bus_txbuf())
+#define UCA1RXBUF (*s25fs_bus_rxbuf())
+#define P3OUT (*s25fs_bus_p3out())
+// eUSCI_B0 (LED controller I2C)
+extern volatile uint16_t UCB0IE, UCB0IV, UCB0RXBUF, UCB0CTLW0, UCB0CTLW1,
+                         UCB0BRW, UCB0I2CSA, UCB0TBCNT, UCB0STATW;
+#define UCB0CTL1 UCB0CTLW0
+#define UCB0TBCNT_L UCB0TBCNT
+// The flags and the transmit buffer go through the LED controller model
+//  (ht16d_model.c), so it can see the writes and keep the driver moving.
+volatile uint16_t *ht16d_model_ifg();
+volatile uint16_t *ht16d_model_txbuf();
+#define UCB0IFG (*ht16d_model_ifg())
+#define UCB0TXBUF (*ht16d_model_txbuf())
+// eUSCI_B1 (LCD shift register)
+extern volatile uint16_t UCB1IFG, UCB1TXBUF, UCB1RXBUF, UCB1CTLW0, UCB1STATW;
+#define UCTXIFG 0x0002
+#define UCRXIFG 0x0001
+#define UCTXIFG0 0x0002
+#define UCRXIFG0 0x0001
+#define UCSTPIFG 0x0008
+#define UCNACKIFG 0x0020
+#define UCTXSTT 0x0002
+#define UCTXSTP 0x0004
+#define UCTR 0x0010
+#define UCSWRST 0x0001
+#define UCBUSY 0x0001
+#define UCBBUSY 0x0010
+#define UCMODE_3 0x0600
+#define UCMST 0x0800
+#define UCSSEL__SMCLK 0x0080
+#define UCASTP_0 0x0000
+#define UCASTP_2 0x0008
+#define UCASTP_3 0x000C
+#define UCTXIE0 0x0002
+#define UCSTPIE 0x0008
+#define UCNACKIE 0x0020
+#define USCI_I2C_UCNACKIFG 0x04
+#define USCI_I2C_UCSTPIFG 0x08
+#define USCI_I2C_UCTXIFG0 0x18
+#define USCI_I2C_UCBIT9IFG 0x1E
+
+// DMA. The address registers are wide enough for a host pointer, and the
+//  channel controls go through the flash bus model, which does the transfers.
+extern volatile uint16_t DMACTL0, DMACTL4, DMAIV;
+extern volatile uint16_t DMA0SZ, DMA1SZ;
+extern volatile uintptr_t DMA0SA, DMA0DA, DMA1SA, DMA1DA;
+volatile uint16_t *s25fs_bus_dma0ctl();
+volatile uint16_t *s25fs_bus_dma1ctl();
+#define DMA0CTL (*s25fs_bus_dma0ctl())
+#define DMA1CTL (*s25fs_bus_dma1ctl())
+#define DMA0TSEL_16 16
+#define DMA1TSEL_17 (17 << 8)
+#define ROUNDROBIN 0x0002
+#define DMADT_0 0x0000
+#define DMASRCINCR_0 0x0000
+#define DMADSTINCR_0 0x0000
+#define DMADSTINCR_3 0x0C00
+#define DMASRCBYTE 0x0040
+#define DMADSTBYTE 0x0080
+#define DMAEN 0x0010
+#define DMAIFG 0x0008
+#define DMAIE 0x0004
+#define DMAIV_DMA0IFG 2
+#define DMAIV_DMA2IFG 6
+
+// GPIO
+extern volatile uint8_t P1IN, P1OUT, P1DIR, P1SEL0, P1SEL1, P2IN, P2OUT, P2DIR,
+                        P3IN, P3DIR, P4SEL0, P4SEL1,
+                        P5OUT, P5DIR, P5SEL0, P5SEL1, P6IN, P6OUT, P6DIR,
+                        P7IN, P7OUT, P7DIR, P7REN, P9IN, P9OUT, P9DIR, P9REN,
+                        PJIN, PJOUT, PJDIR;
+
+// Timer A1 (the time loop)
+extern volatile uint16_t TA1R, TA1CCR0, TA1CTL;
+
+// Multiplier (MPY32)
+extern volatile uint16_t MPY, OP2, RESLO, RESHI;
+
+#endif /* HOST_MSP430_H_ */
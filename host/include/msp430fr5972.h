@@ -0,0 +1,9 @@
+/// Host stand-in for the MSP430FR5972 device header.
+/**
+ ** \file msp430fr5972.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include "msp430.h"
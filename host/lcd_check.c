@@ -0,0 +1,220 @@
+/// Check the LCD driver's diffed text updates against clearing and writing.
+/**
+ ** This links the firmware's lcd111.c against the LCD model (lcd_model.c),
+ ** and makes random calls to it: mostly `lcd111_set_text()`, with text that
+ ** is often a few characters off from what's already showing, but also the
+ ** `lcd111_put_*()` calls, cursor moves and types, both kinds of clear, and
+ ** standby and wake. After each call, what the model shows has to be what
+ ** clearing the display and writing everything would have shown, and so
+ ** does the data address, while a cursor is showing it. (Without one,
+ ** `lcd111_set_text()` leaves the address wherever it likes, so we move it
+ ** before putting anything.)
+ **
+ ** `lcd111_clear_nodelay()` is only for when it'll be a while before the
+ ** display gets text, so after one, either `lcd111_set_text()` comes next
+ ** (and has to cope), or we wait out the clear. After a wake, we don't know
+ ** what's on the display, and don't check it, until something puts it right.
+ **
+ ** Usage: lcd_check [calls]
+ **
+ ** Exits nonzero on any mismatch.
+ **
+ ** \file lcd_check.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qc15.h"
+#include "lcd111.h"
+#include "lcd_model.h"
+#include "util.h"
+
+/// `expect_t.address` after `lcd111_set_text()` with no cursor showing.
+#define ADDRESS_UNKNOWN 0xFF
+
+/// What clearing and writing would have left on one display.
+typedef struct {
+    char text[LCD111_COLS];
+    uint8_t address;
+    uint8_t cursor_type;
+    /// Whether we know what's on it (not since a wake).
+    uint8_t known;
+} expect_t;
+
+expect_t expect[2];
+uint32_t seed = 1;
+
+uint32_t rnd() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/// Report a check, returning 1 if it failed.
+uint8_t result(const char *what, uint32_t bad) {
+    printf("%-40s %s", what, bad ? "MISMATCH" : "ok");
+    if (bad)
+        printf(" (%lu bad)", (unsigned long) bad);
+    printf("\n");
+    return bad ? 1 : 0;
+}
+
+/// Random text, mostly from a few characters, so that runs repeat.
+void random_text(char *text, uint8_t len) {
+    const char common[] = "ab  ";
+
+    for (uint8_t i=0; i<len; i++)
+        text[i] = rnd() % 8 ? common[rnd() % 4] : 'A' + rnd() % 26;
+    text[len] = 0;
+}
+
+void expect_clear(expect_t *e) {
+    memset(e->text, ' ', LCD111_COLS);
+    e->address = 0;
+    e->known = 1;
+}
+
+void expect_char(expect_t *e, char c) {
+    if (e->address < LCD111_COLS)
+        e->text[e->address] = c;
+    e->address++;
+}
+
+void expect_set_text(expect_t *e, char *text) {
+    expect_clear(e);
+    for (uint8_t i=0; i<LCD111_COLS && text[i]; i++)
+        expect_char(e, text[i]);
+    if (e->cursor_type == LCD111_CURSOR_NONE)
+        e->address = ADDRESS_UNKNOWN;
+}
+
+/// Make one random call on display `lcd_id`, and expect what it should do.
+void random_call(uint8_t lcd_id) {
+    expect_t *e = &expect[lcd_id];
+    char text[LCD111_COLS + 4];
+    uint8_t len;
+
+    if (e->address == ADDRESS_UNKNOWN && rnd() % 20 < 3) {
+        len = rnd() % LCD111_COLS;
+        lcd111_cursor_pos(lcd_id, len);
+        e->address = len;
+    }
+
+    switch (rnd() % 20) {
+    case 0:
+        if (e->address == ADDRESS_UNKNOWN)
+            break;
+        lcd111_put_char(lcd_id, text[0] = 'a' + rnd() % 3);
+        expect_char(e, text[0]);
+        break;
+    case 1:
+        if (e->address == ADDRESS_UNKNOWN)
+            break;
+        len = rnd() % 8;
+        random_text(text, rnd() % 8);
+        lcd111_put_text(lcd_id, text, len);
+        for (uint8_t i=0; i<len && text[i]; i++)
+            expect_char(e, text[i]);
+        break;
+    case 2:
+        if (e->address == ADDRESS_UNKNOWN)
+            break;
+        len = rnd() % 8;
+        random_text(text, rnd() % 8);
+        lcd111_put_text_pad(lcd_id, text, len);
+        for (uint8_t i=0; i<len; i++)
+            expect_char(e, i < strlen(text) ? text[i] : ' ');
+        break;
+    case 3:
+        len = rnd() % 26;
+        lcd111_cursor_pos(lcd_id, len);
+        e->address = len > 23 ? 23 : len;
+        break;
+    case 4:
+        e->cursor_type = rnd() % 2 ? LCD111_CURSOR_NONE : rnd() % 8;
+        lcd111_cursor_type(lcd_id, e->cursor_type);
+        break;
+    case 5:
+        lcd111_clear(lcd_id);
+        expect_clear(e);
+        break;
+    case 6:
+        lcd111_clear_nodelay(lcd_id);
+        expect_clear(e);
+        if (rnd() % 2) {
+            delay_millis(5);
+        } else {
+            random_text(text, rnd() % 26);
+            lcd111_set_text(lcd_id, text);
+            expect_set_text(e, text);
+        }
+        break;
+    case 7:
+        lcd111_standby(lcd_id);
+        lcd111_wake(lcd_id);
+        e->known = 0;
+        break;
+    default:
+        if (rnd() % 2 && e->known) {
+            // A few characters off from what's showing.
+            memcpy(text, e->text, LCD111_COLS);
+            text[LCD111_COLS] = 0;
+            for (uint8_t i=rnd() % 4; i; i--)
+                text[rnd() % LCD111_COLS] = 'a' + rnd() % 3;
+            if (rnd() % 2)
+                text[rnd() % (LCD111_COLS + 1)] = 0;
+        } else {
+            random_text(text, rnd() % 26);
+        }
+        lcd111_set_text(lcd_id, text);
+        expect_set_text(e, text);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t calls = 200000;
+    uint32_t bad_text = 0;
+    uint32_t bad_cursor = 0;
+    uint32_t writes;
+    uint8_t failed = 0;
+
+    if (argc > 1)
+        calls = strtoul(argv[1], 0, 0);
+
+    lcd_model_reset();
+    lcd111_init();
+    for (uint8_t lcd_id=0; lcd_id<2; lcd_id++) {
+        memset(&expect[lcd_id], 0, sizeof(expect_t));
+        expect[lcd_id].cursor_type = LCD111_CURSOR_NONE;
+    }
+
+    for (uint32_t c=0; c<calls; c++) {
+        uint8_t lcd_id = rnd() % 2;
+        expect_t *e = &expect[lcd_id];
+        lcd_model_t *lcd = &lcd_model[lcd_id];
+
+        random_call(lcd_id);
+        if (e->known && memcmp(lcd->text, e->text, LCD111_COLS))
+            bad_text++;
+        if (lcd->cursor_type != e->cursor_type)
+            bad_cursor++;
+        else if (e->known && e->cursor_type != LCD111_CURSOR_NONE
+                 && e->address != ADDRESS_UNKNOWN && lcd->address != e->address)
+            bad_cursor++;
+    }
+
+    writes = lcd_model_writes(LCD_BTM) + lcd_model_writes(LCD_TOP);
+    printf("%lu calls: %lu writes, %lu clears, %lu writes dropped while "
+           "clearing\n", (unsigned long) calls, (unsigned long) writes,
+           (unsigned long) (lcd_model[0].clears + lcd_model[1].clears),
+           (unsigned long) (lcd_model[0].dropped + lcd_model[1].dropped));
+    failed |= result("text against clearing and writing", bad_text);
+    failed |= result("cursor against clearing and writing", bad_cursor);
+
+    return failed;
+}
@@ -0,0 +1,118 @@
+/// Host model of the two LCD111 displays, behind the LCD shift register.
+/**
+ ** This sits under the real lcd111.c. The driver clocks each byte into the
+ ** 74HC164 shift register over eUSCI_B1 while holding one display's enable
+ ** line (P6.4 for LCD_TOP, P6.3 for LCD_BTM) high, with P6.1 selecting
+ ** data or command, and then shifts out 0xFF to idle the bus. So a byte
+ ** transmitted while an enable line is high is a write to that display, and
+ ** anything else is bus idling.
+ **
+ ** The model keeps each display's character RAM, address counter and cursor
+ ** type, and counts every command and data write, so host harnesses can see
+ ** both what's on the screens and how much it cost to put it there.
+ **
+ ** It also models the two things the driver has to stay out of the way of.
+ ** A display ignores anything written to it for LCD_MODEL_CLEAR_NS after a
+ ** clear; time here is the bus time of the writes so far, plus whatever
+ ** the firmware has spent in `__delay_cycles()`. And a display in standby
+ ** doesn't keep its text, so, taking the worst case, it wakes up showing
+ ** LCD_MODEL_JUNK all the way across.
+ **
+ ** \file lcd_model.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msp430.h>
+#include <driverlib.h>
+
+#include "qc15.h"
+#include "lcd111.h"
+#include "lcd_model.h"
+
+lcd_model_t lcd_model[2];
+/// When each display will be done with its last clear, in bus time.
+static uint64_t lcd_model_clear_done[2];
+
+void lcd_model_clear_ram(lcd_model_t *lcd) {
+    memset(lcd->text, ' ', LCD_MODEL_COLS);
+    lcd->text[LCD_MODEL_COLS] = 0;
+    lcd->address = 0;
+}
+
+void lcd_model_reset() {
+    memset(lcd_model, 0, sizeof(lcd_model));
+    lcd_model_clear_ram(&lcd_model[0]);
+    lcd_model_clear_ram(&lcd_model[1]);
+    lcd_model_clear_done[0] = 0;
+    lcd_model_clear_done[1] = 0;
+}
+
+uint32_t lcd_model_writes(uint8_t lcd_id) {
+    return lcd_model[lcd_id].commands + lcd_model[lcd_id].data;
+}
+
+uint64_t lcd_model_bus_ns(uint8_t lcd_id) {
+    return lcd_model_writes(lcd_id) * LCD_MODEL_WRITE_NS +
+            lcd_model[lcd_id].clears * LCD_MODEL_CLEAR_NS;
+}
+
+/// How long the LCD bus has been going: the writes, and the delays between.
+uint64_t lcd_model_now_ns() {
+    return (lcd_model_writes(LCD_BTM) + lcd_model_writes(LCD_TOP))
+            * LCD_MODEL_WRITE_NS + host_delay_cycles * 1000000ULL / MCLK_FREQ_KHZ;
+}
+
+void lcd_model_command(lcd_model_t *lcd, uint8_t command) {
+    lcd->commands++;
+    if (command == LCD111_CMD_CLR) {
+        lcd->clears++;
+        lcd_model_clear_ram(lcd);
+        lcd_model_clear_done[lcd - lcd_model] = lcd_model_now_ns()
+                                                + LCD_MODEL_CLEAR_NS;
+    } else if ((command & 0b11100000) == 0b11100000) {
+        // Data address, low bits.
+        lcd->address = command & 0b00011111;
+    } else if ((command & 0b11111000) == 0b00001000) {
+        lcd->cursor_type = command & 0b0111;
+    } else if (command == 0b00011100) {
+        lcd->powered = 1;
+    } else if (command == 0b00011010) {
+        lcd->powered = 0;
+        memset(lcd->text, LCD_MODEL_JUNK, LCD_MODEL_COLS);
+    }
+    // Everything else (display control, lines, contrast, the high bits of
+    //  the address) doesn't change what we're modelling.
+}
+
+void lcd_model_data(lcd_model_t *lcd, uint8_t data) {
+    lcd->data++;
+    if (lcd->address < LCD_MODEL_COLS)
+        lcd->text[lcd->address] = (char) data;
+    lcd->address++;
+}
+
+void EUSCI_B_SPI_transmitData(uint16_t base, uint8_t data) {
+    lcd_model_t *lcd;
+
+    if (P6OUT & BIT4)
+        lcd = &lcd_model[LCD_TOP];
+    else if (P6OUT & BIT3)
+        lcd = &lcd_model[LCD_BTM];
+    else
+        return; // Idling the bus.
+
+    if (lcd_model_now_ns() < lcd_model_clear_done[lcd - lcd_model]) {
+        // Still clearing.
+        lcd->dropped++;
+        return;
+    }
+    if (P6OUT & BIT1)
+        lcd_model_data(lcd, data);
+    else
+        lcd_model_command(lcd, data);
+}
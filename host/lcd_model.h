@@ -0,0 +1,47 @@
+/// Header for the host model of the two LCD111 character displays.
+/**
+ ** \file lcd_model.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef LCD_MODEL_H_
+#define LCD_MODEL_H_
+
+#include <stdint.h>
+
+#define LCD_MODEL_COLS 24
+
+/// What one display is showing, and how much bus traffic it has taken.
+typedef struct {
+    /// Display RAM, NUL terminated for convenience.
+    char text[LCD_MODEL_COLS + 1];
+    uint8_t address;
+    uint8_t cursor_type;
+    uint8_t powered;
+    /// Commands written, including clears.
+    uint32_t commands;
+    /// Data (character) bytes written.
+    uint32_t data;
+    /// Clear display commands, each of which stalls the bus for ~4 ms.
+    uint32_t clears;
+    /// Writes ignored because they came too soon after a clear.
+    uint32_t dropped;
+} lcd_model_t;
+
+/// One shift register write takes two bytes at 100 kHz.
+#define LCD_MODEL_WRITE_NS 160000ULL
+/// lcd111_command() waits this long after a clear.
+#define LCD_MODEL_CLEAR_NS 4000000ULL
+/// What's on a display after standby, as far as anyone can count on.
+#define LCD_MODEL_JUNK '#'
+
+/// Indexed by LCD_BTM/LCD_TOP.
+extern lcd_model_t lcd_model[2];
+
+void lcd_model_reset();
+uint32_t lcd_model_writes(uint8_t lcd_id);
+uint64_t lcd_model_bus_ns(uint8_t lcd_id);
+
+#endif /* LCD_MODEL_H_ */
@@ -0,0 +1,453 @@
+/// LED animation renderer and per-frame cost profiler.
+/**
+ ** This runs the real leds.c, led_animations.c and ht16d35b.c, over the LED
+ ** controller model (ht16d_model.c), one time loop (1/32 s) at a time. After
+ ** each time loop, it draws what the controller is displaying, laid out
+ ** about the way the LEDs are on the badge: the 18 edge LEDs around it,
+ ** starting right of top center and going clockwise (so FALL animations
+ ** fall down both sides), and the 6 up-lighting LEDs in a line across the
+ ** middle. The frames go into a PPM image strip, one row per second.
+ **
+ ** It also reports what each time loop cost: the I2C writes and bytes that
+ ** went to the controller, how long they kept the bus busy, and a rough
+ ** estimate of the CPU cycles spent, and flags any time loop that doesn't
+ ** fit in its 1/32 s. The cycle estimate is a per-operation weight (below)
+ ** times how many of each operation leds.c and the driver did; it's an
+ ** estimate from the shape of the loops, not a measurement. Time loops that
+ ** leds.c skipped, because nothing was going to change, are counted too.
+ **
+ ** Usage: led_render [-t same|spin|fall] [-l loops] [-n ticks] [-f]
+ **                   [-b background] [-o strip.ppm] [-s scale] [-q] animation
+ **        led_render -a
+ **
+ ** `animation` is an index into all_animations, the name of one of them
+ ** (e.g. Rainbow), or one of the other animations in led_animations.h by
+ ** its C name (e.g. anim_dl_done). `-t` overrides its type, and `-l` is
+ ** led_set_anim()'s `loops`, so 255 makes it the background, which never
+ ** ends; it's cut off after `-n` time loops (default 30 seconds' worth).
+ ** `-f` turns on the file lights (the center line). `-b` starts another
+ ** animation as the background first, so `animation` plays over it, the way
+ ** it would on the badge, and the background keeps going after it's done. `-q` prints only the summary. `-a` summarizes
+ ** every animation instead.
+ **
+ ** The animations play from the keyframes that anim_compiler writes to the
+ ** flash image (QC15_FLASH_IMAGE, see s25fs_emu.c), as on the badge. Like
+ ** the badge, this only has the colors of anim_rainbow_spin, so without
+ ** keyframes, or with `-t`, that's what plays.
+ **
+ ** To make an animated GIF of the strip, with ImageMagick:
+ **     convert strip.ppm -crop 68x52 +repage -set delay 3 anim.gif
+ **
+ ** The exit status is 1 if any time loop went over budget.
+ **
+ ** \file led_render.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qc15.h"
+#include "badge.h"
+#include "codes.h"
+#include "leds.h"
+#include "led_animations.h"
+#include "ht16d35b.h"
+#include "flash_cache.h"
+#include "s25fs.h"
+#include "ht16d_model.h"
+
+/// 8 MHz MCLK, 32 time loops per second.
+#define TICK_CYCLES 250000UL
+#define TICK_NS 31250000ULL
+
+// Rough MSP430 cycle weights, for the estimate:
+/// The time loop's own LED bookkeeping.
+#define EST_TICK 40
+/// A time loop that leds.c skips, because nothing will change.
+#define EST_IDLE 10
+/// Adding one channel's step during a fade.
+#define EST_FADE_CHANNEL 6
+/// Staging one LED's next color and step, at a frame boundary.
+#define EST_LOAD_LED 150
+/// Or, reading its colors or steps from the keyframes in the flash: sending
+///  the command and address, and setting up the DMA, which the CPU sleeps
+///  through.
+#define EST_KEYFRAME_READ 300
+/// Composing one LED from the layers, and storing it for the controller.
+#define EST_COMPOSE_LED 80
+/// One ht16d_send_gray(): the gamma and diff for 84 rows.
+#define EST_SEND 1000
+/// The I2C ISR, for each byte sent.
+#define EST_I2C_BYTE 30
+
+/// Where the LEDs are, in grid units.
+#define GRID_W 17
+#define GRID_H 13
+const uint8_t led_position[LED_COUNT][2] = {
+    // Edge lighting, right side, top to bottom:
+    {10, 1}, {13, 1}, {15, 2}, {15, 4}, {15, 6}, {15, 8}, {15, 10},
+    {13, 11}, {10, 11},
+    // Left side, bottom to top:
+    {6, 11}, {3, 11}, {1, 10}, {1, 8}, {1, 6}, {1, 4}, {1, 2}, {3, 1},
+    {6, 1},
+    // Up lighting:
+    {3, 6}, {5, 6}, {7, 6}, {9, 6}, {11, 6}, {13, 6},
+};
+
+// leds.c internals:
+extern led_layer_t led_layers[LED_LAYER_COUNT];
+extern uint32_t led_composed_count;
+extern uint32_t led_frames_skipped;
+void led_init();
+
+// What leds.c needs from the rest of the badge:
+volatile qc_clock_t qc_clock;
+qc15conf badge_conf;
+uint8_t global_flash_lockout;
+uint8_t qc15_mode;
+const led_ring_animation_t *led_ring_anim_bg;
+uint8_t led_ring_anim_pad_loops_bg;
+uint8_t led_anim_type_bg;
+
+uint8_t is_solved(uint8_t code_id) {
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    const led_ring_animation_t *anim;
+} named_anim_t;
+
+const named_anim_t other_animations[] = {
+    {"anim_rainbow_spin", &anim_rainbow_spin},
+    {"anim_countdown_tick", &anim_countdown_tick},
+    {"anim_countdown_done", &anim_countdown_done},
+    {"anim_dl", &anim_dl},
+    {"anim_dl_done", &anim_dl_done},
+    {"anim_ul", &anim_ul},
+};
+#define OTHER_ANIMATIONS (sizeof(other_animations) / sizeof(named_anim_t))
+
+/// One time loop's cost.
+typedef struct {
+    uint32_t writes;
+    uint32_t bytes;
+    uint64_t bus_ns;
+    uint32_t cycles;
+    uint8_t load;
+    uint8_t skipped;
+} tick_cost_t;
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t ticks_sending;
+    uint32_t bytes;
+    uint32_t bytes_max;
+    uint64_t bus_ns_max;
+    uint32_t cycles;
+    uint32_t cycles_max;
+    uint32_t over_budget;
+    uint32_t skipped;
+} summary_t;
+
+uint8_t *strip;
+uint32_t strip_frames;
+uint32_t strip_cols = 32;
+uint8_t scale = 4;
+
+const led_ring_animation_t *find_animation(const char *name) {
+    char *end;
+    unsigned long index = strtoul(name, &end, 0);
+
+    if (*name && !*end)
+        return index < GAME_ANIMS_LEN ? &all_animations[index] : 0;
+    for (uint8_t i=0; i<GAME_ANIMS_LEN; i++) {
+        if (!strcmp(all_animations[i].name, name))
+            return &all_animations[i];
+    }
+    for (uint8_t i=0; i<OTHER_ANIMATIONS; i++) {
+        if (!strcmp(other_animations[i].name, name))
+            return other_animations[i].anim;
+    }
+    return 0;
+}
+
+/// Draw what the controller is displaying into frame `frame` of the strip.
+void draw_frame(uint32_t frame) {
+    uint32_t cell_w = GRID_W * scale;
+    uint32_t cell_h = GRID_H * scale;
+    uint32_t width = strip_cols * cell_w;
+    uint32_t x0 = (frame % strip_cols) * cell_w;
+    uint32_t y0 = (frame / strip_cols) * cell_h;
+    uint8_t rgb[3];
+
+    for (uint8_t led=0; led<LED_COUNT; led++) {
+        ht16d_model_led_color(led, rgb);
+        // Off LEDs are dark gray, so you can see where they are.
+        if (!rgb[0] && !rgb[1] && !rgb[2])
+            rgb[0] = rgb[1] = rgb[2] = 0x20;
+        for (uint8_t y=0; y<scale; y++) {
+            for (uint8_t x=0; x<scale; x++) {
+                uint32_t px = x0 + led_position[led][0] * scale + x;
+                uint32_t py = y0 + led_position[led][1] * scale + y;
+                memcpy(&strip[(py * width + px) * 3], rgb, 3);
+            }
+        }
+    }
+}
+
+void write_strip(const char *path, uint32_t frames) {
+    uint32_t width = strip_cols * GRID_W * scale;
+    uint32_t rows = (frames + strip_cols - 1) / strip_cols;
+    uint32_t height = rows * GRID_H * scale;
+    FILE *out = fopen(path, "wb");
+
+    if (!out) {
+        perror(path);
+        exit(2);
+    }
+    fprintf(out, "P6\n%u %u\n255\n", width, height);
+    fwrite(strip, 3, (size_t) width * height, out);
+    fclose(out);
+}
+
+/// Run one time loop, and work out what it cost.
+void tick(tick_cost_t *cost) {
+    uint32_t writes = ht16d_model.writes;
+    uint32_t bytes = ht16d_model.bytes;
+    uint64_t bus_ns = ht16d_model_bus_ns();
+    uint32_t composed = led_composed_count;
+    uint32_t skipped = led_frames_skipped;
+    uint8_t playing[LED_LAYER_COUNT];
+
+    for (uint8_t l=0; l<LED_LAYER_COUNT; l++)
+        playing[l] = led_layers[l].type != LED_ANIM_TYPE_NONE;
+    led_timestep();
+
+    cost->writes = ht16d_model.writes - writes;
+    cost->bytes = ht16d_model.bytes - bytes;
+    cost->bus_ns = ht16d_model_bus_ns() - bus_ns;
+    cost->load = 0;
+    cost->skipped = led_frames_skipped != skipped;
+    if (cost->skipped) {
+        cost->cycles = EST_IDLE;
+        return;
+    }
+    cost->cycles = EST_TICK;
+    for (uint8_t l=0; l<LED_LAYER_COUNT; l++) {
+        led_layer_t *layer = &led_layers[l];
+
+        // A layer that just finished doesn't load anything.
+        if (!playing[l] || layer->type == LED_ANIM_TYPE_NONE)
+            continue;
+        if (layer->anim_step == 0) {
+            cost->load = 1;
+            if (layer->keyframes_ok)
+                cost->cycles += 2 * EST_KEYFRAME_READ;
+            else
+                cost->cycles += EST_LOAD_LED * layer->num_leds;
+        } else {
+            cost->cycles += EST_FADE_CHANNEL * 3 * layer->num_leds;
+        }
+    }
+    if (badge_conf.file_lights_on)
+        cost->cycles += EST_FADE_CHANNEL * 3 * 6;
+    composed = led_composed_count - composed;
+    cost->cycles += EST_COMPOSE_LED * composed;
+    if (composed)
+        cost->cycles += EST_SEND;
+    cost->cycles += EST_I2C_BYTE * cost->bytes;
+}
+
+void summarize(summary_t *summary, tick_cost_t *cost) {
+    summary->ticks++;
+    summary->skipped += cost->skipped;
+    if (cost->bytes)
+        summary->ticks_sending++;
+    summary->bytes += cost->bytes;
+    if (cost->bytes > summary->bytes_max)
+        summary->bytes_max = cost->bytes;
+    if (cost->bus_ns > summary->bus_ns_max)
+        summary->bus_ns_max = cost->bus_ns;
+    summary->cycles += cost->cycles;
+    if (cost->cycles > summary->cycles_max)
+        summary->cycles_max = cost->cycles;
+    if (cost->cycles > TICK_CYCLES || cost->bus_ns > TICK_NS)
+        summary->over_budget++;
+}
+
+/// Start up the LEDs, start `anim` (over `bg`, if there is one), and run it
+///  until it's done.
+void run(const led_ring_animation_t *anim, uint8_t type, uint8_t loops,
+         const led_ring_animation_t *bg, uint32_t ticks_max, uint8_t verbose,
+         summary_t *summary) {
+    tick_cost_t cost;
+
+    memset(summary, 0, sizeof(summary_t));
+    ht16d_model_reset();
+    ht16d_init();
+    led_init();
+    led_ring_anim_bg = 0;
+    if (badge_conf.file_lights_on)
+        led_activate_file_lights();
+    s_led_anim_done = 0;
+    if (bg)
+        led_set_anim(bg, 0, 0xFF, 0);
+    led_set_anim(anim, type, loops, 0);
+
+    if (verbose)
+        printf("tick   time  writes  bytes  bus us   est cycles\n");
+    // The background never ends, so with one, run until `ticks_max`.
+    while ((bg || !s_led_anim_done) && summary->ticks < ticks_max) {
+        tick(&cost);
+        if (strip)
+            draw_frame(summary->ticks);
+        if (verbose)
+            printf("%4u %6.3f %7u %6u %7.1f %12u%s%s%s\n", summary->ticks,
+                   summary->ticks / 32.0, cost.writes, cost.bytes,
+                   cost.bus_ns / 1000.0, cost.cycles,
+                   cost.load ? "  frame" : "",
+                   cost.skipped ? "  skipped" : "",
+                   (cost.cycles > TICK_CYCLES || cost.bus_ns > TICK_NS)
+                           ? "  OVER BUDGET" : "");
+        summarize(summary, &cost);
+    }
+}
+
+void print_summary(const char *name, summary_t *summary) {
+    printf("%-20s %5u %5u %5u %7.1f %5u %8.1f %7.0f %8u %4u\n", name,
+           summary->ticks, summary->skipped, summary->ticks_sending,
+           summary->ticks ? (double) summary->bytes / summary->ticks : 0.0,
+           summary->bytes_max, summary->bus_ns_max / 1000.0,
+           summary->ticks ? (double) summary->cycles / summary->ticks : 0.0,
+           summary->cycles_max, summary->over_budget);
+}
+
+void print_summary_header() {
+    printf("%-20s %5s %5s %5s %7s %5s %8s %7s %8s %4s\n", "animation",
+           "ticks", "skip", "sent", "B/tick", "B max", "bus us", "cycles", "cyc max",
+           "over");
+}
+
+/// Summarize every animation, played once with its own type.
+int run_all(uint32_t ticks_max) {
+    summary_t summary;
+    uint32_t over_budget = 0;
+
+    print_summary_header();
+    for (uint8_t i=0; i<GAME_ANIMS_LEN; i++) {
+        run(&all_animations[i], 0, 0, 0, ticks_max, 0, &summary);
+        print_summary(all_animations[i].name, &summary);
+        over_budget += summary.over_budget;
+    }
+    for (uint8_t i=0; i<OTHER_ANIMATIONS; i++) {
+        run(other_animations[i].anim, 0, 0, 0, ticks_max, 0, &summary);
+        print_summary(other_animations[i].name, &summary);
+        over_budget += summary.over_budget;
+    }
+    return over_budget ? 1 : 0;
+}
+
+void usage() {
+    fprintf(stderr, "usage: led_render [-t same|spin|fall] [-l loops] "
+            "[-n ticks] [-f]\n"
+            "                  [-b background] [-o strip.ppm] [-s scale] "
+            "[-q] animation\n"
+            "       led_render -a\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const led_ring_animation_t *anim;
+    const led_ring_animation_t *bg = 0;
+    const char *out_path = 0;
+    uint32_t ticks_max = 32 * 30;
+    uint8_t type = 0;
+    uint8_t loops = 0;
+    uint8_t verbose = 1;
+    uint8_t all = 0;
+    summary_t summary;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:l:n:fb:o:s:qa")) != -1) {
+        switch (opt) {
+        case 't':
+            if (!strcmp(optarg, "same"))
+                type = LED_ANIM_TYPE_SAME;
+            else if (!strcmp(optarg, "spin"))
+                type = LED_ANIM_TYPE_SPIN;
+            else if (!strcmp(optarg, "fall"))
+                type = LED_ANIM_TYPE_FALL;
+            else
+                usage();
+            break;
+        case 'l':
+            loops = strtoul(optarg, 0, 0);
+            break;
+        case 'n':
+            ticks_max = strtoul(optarg, 0, 0);
+            break;
+        case 'f':
+            badge_conf.file_lights_on = 1;
+            break;
+        case 'b':
+            bg = find_animation(optarg);
+            if (!bg) {
+                fprintf(stderr, "led_render: no animation %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 's':
+            scale = strtoul(optarg, 0, 0);
+            if (!scale)
+                usage();
+            break;
+        case 'q':
+            verbose = 0;
+            break;
+        case 'a':
+            all = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+
+    s25fs_init_io();
+    s25fs_init();
+    flash_cache_init();
+
+    if (all)
+        return run_all(ticks_max);
+    if (optind != argc - 1)
+        usage();
+    anim = find_animation(argv[optind]);
+    if (!anim) {
+        fprintf(stderr, "led_render: no animation %s\n", argv[optind]);
+        return 2;
+    }
+
+    if (out_path) {
+        uint32_t rows = (ticks_max + strip_cols - 1) / strip_cols;
+        strip = calloc((size_t) strip_cols * GRID_W * scale *
+                       rows * GRID_H * scale, 3);
+    }
+    run(anim, type, loops, bg, ticks_max, verbose, &summary);
+    if (out_path)
+        write_strip(out_path, summary.ticks);
+
+    if (verbose)
+        printf("\n");
+    print_summary_header();
+    print_summary(argv[optind], &summary);
+    return summary.over_budget ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/// Register variables and peripheral models backing the host msp430.h.
+/**
+ ** \file msp430_host.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include "msp430.h"
+#include "driverlib.h"
+
+volatile uint16_t UCA1CTLW0;
+volatile uint16_t UCB0IE, UCB0IV, UCB0RXBUF, UCB0CTLW0, UCB0CTLW1, UCB0BRW,
+                  UCB0I2CSA, UCB0TBCNT, UCB0STATW;
+volatile uint16_t UCB1IFG = UCTXIFG, UCB1TXBUF, UCB1RXBUF, UCB1CTLW0,
+                  UCB1STATW;
+
+volatile uint16_t DMACTL0, DMACTL4, DMAIV;
+volatile uint16_t DMA0SZ, DMA1SZ;
+volatile uintptr_t DMA0SA, DMA0DA, DMA1SA, DMA1DA;
+
+volatile uint8_t P1IN, P1OUT, P1DIR, P1SEL0, P1SEL1, P2IN, P2OUT, P2DIR,
+                 P3IN, P3DIR, P4SEL0, P4SEL1,
+                 P5OUT, P5DIR, P5SEL0, P5SEL1, P6IN, P6OUT, P6DIR,
+                 P7IN, P7OUT, P7DIR, P7REN, P9IN = 0xF0, P9OUT, P9DIR, P9REN,
+                 PJIN, PJOUT, PJDIR;
+
+volatile uint16_t TA1R, TA1CCR0, TA1CTL;
+
+volatile uint16_t MPY, OP2, RESLO, RESHI;
+
+/// The status register; only GIE and the LPM bits mean anything here.
+volatile uint16_t host_sr = 0;
+/// Cycles the firmware has spent in `__delay_cycles()`.
+volatile uint64_t host_delay_cycles = 0;
+/// Called when the CPU goes into LPM, to run whatever would wake it up.
+void (*host_lpm_hook)() = 0;
+
+void host_bis_SR_register(uint16_t bits) {
+    host_sr |= bits;
+    if (bits & LPM0_bits) {
+        if (host_lpm_hook)
+            host_lpm_hook();
+        // The ISR that woke us did an LPM_EXIT.
+        host_sr &= ~LPM3_bits;
+    }
+}
+
+/// Write a DMA address register, given the 16-bit address the firmware has.
+/**
+ ** The firmware casts the register's address down to 16 bits, the way it
+ ** would on the MSP430, so find the register whose address ends that way.
+ */
+void host_data16_write_addr(unsigned short addr, unsigned long val) {
+    volatile uintptr_t *regs[] = {&DMA0SA, &DMA0DA, &DMA1SA, &DMA1DA};
+
+    for (uint8_t i=0; i<4; i++) {
+        if ((unsigned short) (uintptr_t) regs[i] == addr)
+            *regs[i] = val;
+    }
+}
+
+/// The CRC16 module's running result.
+static uint16_t crc_result;
+
+void CRC_setSeed(uint16_t base, uint16_t seed) {
+    crc_result = seed;
+}
+
+/// Feed a byte through the CRC16 module, the way writing CRCDI_L does.
+/**
+ ** The module computes CRC-CCITT (polynomial 0x1021), and CRCDI takes each
+ ** byte least significant bit first.
+ */
+void CRC_set8BitData(uint16_t base, uint8_t data) {
+    for (uint8_t i=0; i<8; i++) {
+        uint16_t feedback = ((crc_result >> 15) ^ (data >> i)) & 1;
+        crc_result <<= 1;
+        if (feedback)
+            crc_result ^= 0x1021;
+    }
+}
+
+uint16_t CRC_getResult(uint16_t base) {
+    return crc_result;
+}
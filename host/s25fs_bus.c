@@ -0,0 +1,491 @@
+/// Host model of the S25FS064S, one SPI byte at a time, under the real s25fs.c.
+/**
+ ** s25fs_emu.c stands in for the whole flash driver, which is what most of
+ ** the host tools want. This instead sits under the real driver: the host
+ ** msp430.h routes UCA1IFG, UCA1TXBUF, UCA1RXBUF, P3OUT (for chip select on
+ ** P3.7) and the DMA channel controls through here, so every byte the driver
+ ** clocks, by CPU or by DMA, goes through a command decoder for the chip.
+ **
+ ** The chip follows the same rules as the emulator: programming can only
+ ** clear bits, page programs wrap within their page, erases set a 64 KB block
+ ** to 0xFF, and programs, erases and register writes need the write enable
+ ** latch and leave the chip busy (WIP) for a while. It also enforces what
+ ** the emulator can't see from the API: a command other than a status read
+ ** or an erase suspend while the chip is busy is ignored. Anything the real
+ ** chip would ignore or mangle is counted in `s25fs_bus_violations`.
+ **
+ ** The DMA model checks that the driver has set the channels up the way
+ ** `s25fs_recv_dma()` describes (channel 0 on UCA1RXIFG into the buffer,
+ ** channel 1 on UCA1TXIFG from a dummy byte, fixed priority) and that it has
+ ** kicked UCTXIFG to start them, then does the whole transfer at once. With
+ ** interrupts enabled, that happens when the driver goes into LPM0, and it
+ ** wakes up through the real DMA ISR.
+ **
+ ** \file s25fs_bus.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <msp430.h>
+#include <driverlib.h>
+
+#include "s25fs_bus.h"
+
+#define FLASH_BLOCK_SIZE 0x10000
+#define FLASH_PAGE_SIZE 256
+
+#define FLASH_SR_WIP BIT0
+#define FLASH_SR_WEL BIT1
+
+#define FLASH_CMD_WREN 0x06
+#define FLASH_CMD_WRDIS 0x04
+#define FLASH_CMD_READ_STATUS 0x05
+#define FLASH_CMD_READ_ID 0x9F
+#define FLASH_CMD_READ_DATA 0x03
+#define FLASH_CMD_FAST_READ 0x0B
+#define FLASH_CMD_PAGE_PROGRAM 0x02
+#define FLASH_CMD_ERASE_BLOCK 0xD8
+#define FLASH_CMD_WRAR 0x71
+#define FLASH_CMD_RDAR 0x65
+#define FLASH_CMD_CHIP_ERASE 0xC7
+#define FLASH_CMD_POWER_DOWN 0xB9
+#define FLASH_CMD_POWER_UP 0xAB
+#define FLASH_CMD_CLSR 0x82
+#define FLASH_CMD_ERASE_SUSPEND 0x75
+#define FLASH_CMD_ERASE_RESUME 0x7A
+
+#define FLASH_RDID_VAL_S25FS064S 0x0102174D
+
+/// The flash is selected while P3.7 is low.
+#define BUS_CS BIT7
+/// What UCA1TXBUF holds when there's no byte waiting to go out.
+#define BUS_TX_EMPTY 0xFFFF
+/// How many times the driver can poll a DMA that will never finish.
+#define BUS_STUCK_POLLS 1000000
+
+/// The DMA channel control bits that `s25fs_recv_dma()` should have set.
+#define BUS_DMA_CTL_MASK ~(DMAEN | DMAIE | DMAIFG)
+#define BUS_DMA0_CTL (DMADT_0 | DMASRCINCR_0 | DMADSTINCR_3 | DMASRCBYTE \
+                      | DMADSTBYTE)
+#define BUS_DMA1_CTL (DMADT_0 | DMASRCINCR_0 | DMADSTINCR_0 | DMASRCBYTE \
+                      | DMADSTBYTE)
+
+/// SPI clock, in Hz.
+uint32_t s25fs_bus_spi_hz = 1000000;
+/// Time the chip spends on a page program or register write, in ns.
+uint64_t s25fs_bus_program_ns = 450000;
+/// Time the chip spends on a 64 KB block erase, in ns.
+uint64_t s25fs_bus_erase_ns = 520000000;
+/// Time the chip spends on a chip erase, in ns.
+uint64_t s25fs_bus_chip_erase_ns = 55000000000ULL;
+
+/// The virtual clock, in ns.
+uint64_t s25fs_bus_now = 0;
+/// Commands that the real chip would have ignored or mangled.
+uint32_t s25fs_bus_violations = 0;
+s25fs_bus_stats_t s25fs_bus_stats;
+
+uint8_t *bus_image = 0;
+/// Configuration registers, by the low bits of their address. We don't
+///  distinguish the volatile copies from the non-volatile ones.
+uint8_t bus_regs[8];
+uint64_t bus_busy_until = 0;
+/// Whether the chip is busy with an erase (as opposed to a program).
+uint8_t bus_busy_erase = 0;
+/// Time the erase had left when it was suspended, or 0 if it isn't.
+uint64_t bus_suspended_left = 0;
+/// The block being erased, so reads from it during a suspend can be caught.
+uint32_t bus_erase_addr = 0;
+uint8_t bus_wel = 0;
+uint8_t bus_powered_down = 0;
+
+// The registers we stand in for:
+volatile uint16_t bus_ifg = UCTXIFG;
+volatile uint16_t bus_tx = BUS_TX_EMPTY;
+volatile uint16_t bus_rx = 0;
+volatile uint8_t bus_p3out = BUS_CS;
+volatile uint16_t bus_dma0ctl = 0;
+volatile uint16_t bus_dma1ctl = 0;
+
+/// Whether UCTXIFG has been cleared, so setting it again is a rising edge.
+uint8_t bus_tx_edge = 0;
+/// How long the driver has been waiting on the DMA.
+uint32_t bus_dma_polls = 0;
+
+// The transaction in progress:
+uint8_t bus_selected = 0;
+/// Bytes so far, including the command.
+uint32_t bus_index = 0;
+/// Set if the chip is ignoring this command.
+uint8_t bus_ignored = 0;
+uint8_t bus_cmd = 0;
+uint32_t bus_addr = 0;
+/// The page buffer for a page program; unwritten bytes are 0xFF.
+uint8_t bus_page[FLASH_PAGE_SIZE];
+/// The value byte of a register write.
+uint8_t bus_reg_val = 0;
+
+extern void S25FS_DMA_ISR();
+
+void bus_violation(const char *what) {
+    s25fs_bus_violations++;
+    if (s25fs_bus_violations <= 10)
+        fprintf(stderr, "flash bus: %s (command 0x%02x, address 0x%06x)\n",
+                what, bus_cmd, bus_addr);
+}
+
+/// Whether the chip is in the middle of a program or an unsuspended erase.
+uint8_t s25fs_bus_busy() {
+    return !bus_suspended_left && s25fs_bus_now < bus_busy_until;
+}
+
+uint8_t bus_status() {
+    return (s25fs_bus_busy() ? FLASH_SR_WIP : 0) | (bus_wel ? FLASH_SR_WEL : 0);
+}
+
+/// Common gatekeeping for programs, erases and register writes.
+uint8_t bus_write_allowed() {
+    if (bus_suspended_left) {
+        bus_violation("write command during an erase suspend");
+        return 0;
+    }
+    if (!bus_wel) {
+        bus_violation("write command without write enable");
+        return 0;
+    }
+    bus_wel = 0;
+    return 1;
+}
+
+void bus_set_busy(uint64_t ns, uint8_t erase) {
+    bus_busy_until = s25fs_bus_now + ns;
+    bus_busy_erase = erase;
+}
+
+/// The chip select has gone high: do whatever the command said to.
+void bus_deselect() {
+    uint32_t page;
+
+    bus_selected = 0;
+    s25fs_bus_stats.commands++;
+    if (bus_ignored || !bus_index)
+        return;
+
+    switch (bus_cmd) {
+    case FLASH_CMD_WREN:
+        bus_wel = 1;
+        break;
+    case FLASH_CMD_WRDIS:
+        bus_wel = 0;
+        break;
+    case FLASH_CMD_CLSR:
+        break;
+    case FLASH_CMD_PAGE_PROGRAM:
+        if (bus_index < 5) {
+            bus_violation("page program without data");
+            break;
+        }
+        if (!bus_write_allowed())
+            break;
+        page = bus_addr & ~(FLASH_PAGE_SIZE-1) & (S25FS_BUS_SIZE-1);
+        for (uint16_t i=0; i<FLASH_PAGE_SIZE; i++) {
+            bus_image[page + i] &= bus_page[i];
+        }
+        bus_set_busy(s25fs_bus_program_ns, 0);
+        break;
+    case FLASH_CMD_ERASE_BLOCK:
+        if (bus_index != 4) {
+            bus_violation("block erase with the wrong length");
+            break;
+        }
+        if (!bus_write_allowed())
+            break;
+        bus_erase_addr = bus_addr & ~(FLASH_BLOCK_SIZE-1) & (S25FS_BUS_SIZE-1);
+        memset(bus_image + bus_erase_addr, 0xFF, FLASH_BLOCK_SIZE);
+        bus_set_busy(s25fs_bus_erase_ns, 1);
+        break;
+    case FLASH_CMD_CHIP_ERASE:
+        if (!bus_write_allowed())
+            break;
+        memset(bus_image, 0xFF, S25FS_BUS_SIZE);
+        bus_set_busy(s25fs_bus_chip_erase_ns, 0);
+        break;
+    case FLASH_CMD_WRAR:
+        if (bus_index != 5) {
+            bus_violation("register write with the wrong length");
+            break;
+        }
+        if (!bus_write_allowed())
+            break;
+        bus_regs[bus_addr & 7] = bus_reg_val;
+        bus_set_busy(s25fs_bus_program_ns, 0);
+        break;
+    case FLASH_CMD_ERASE_SUSPEND:
+        // This is ignored if there's no erase going on.
+        if (s25fs_bus_busy() && bus_busy_erase)
+            bus_suspended_left = bus_busy_until - s25fs_bus_now;
+        break;
+    case FLASH_CMD_ERASE_RESUME:
+        if (bus_suspended_left) {
+            bus_busy_until = s25fs_bus_now + bus_suspended_left;
+            bus_suspended_left = 0;
+        }
+        break;
+    case FLASH_CMD_POWER_DOWN:
+        bus_powered_down = 1;
+        break;
+    case FLASH_CMD_POWER_UP:
+        bus_powered_down = 0;
+        break;
+    case FLASH_CMD_READ_STATUS:
+    case FLASH_CMD_READ_ID:
+    case FLASH_CMD_READ_DATA:
+    case FLASH_CMD_FAST_READ:
+    case FLASH_CMD_RDAR:
+        break;
+    default:
+        bus_violation("unknown command");
+        break;
+    }
+}
+
+/// Notice any change in the chip select since the last register access.
+void s25fs_bus_sync() {
+    uint8_t selected = !(bus_p3out & BUS_CS);
+
+    if (selected == bus_selected)
+        return;
+    if (selected) {
+        bus_selected = 1;
+        bus_index = 0;
+        bus_ignored = 0;
+        bus_addr = 0;
+        memset(bus_page, 0xFF, sizeof(bus_page));
+    } else {
+        bus_deselect();
+    }
+}
+
+/// Read a data byte for READ or FAST_READ, `offset` bytes into the read.
+uint8_t bus_read_byte(uint32_t offset) {
+    uint32_t address = (bus_addr + offset) & (S25FS_BUS_SIZE-1);
+
+    if (bus_suspended_left && (address & ~(FLASH_BLOCK_SIZE-1))
+            == bus_erase_addr)
+        bus_violation("read from the block whose erase is suspended");
+    return bus_image[address];
+}
+
+/// Clock one byte through the chip: `out` goes in, and we return what comes
+/// back.
+uint8_t bus_clock(uint8_t out) {
+    uint32_t n = bus_index++;
+
+    s25fs_bus_now += 8 * 1000000000ULL / s25fs_bus_spi_hz;
+
+    if (!bus_selected) {
+        bus_violation("byte clocked with the flash deselected");
+        return 0xFF;
+    }
+
+    if (n == 0) {
+        bus_cmd = out;
+        if (bus_powered_down && out != FLASH_CMD_POWER_UP) {
+            bus_violation("command while powered down");
+            bus_ignored = 1;
+        } else if (s25fs_bus_busy() && out != FLASH_CMD_READ_STATUS
+                   && out != FLASH_CMD_ERASE_SUSPEND) {
+            bus_violation("command while busy");
+            bus_ignored = 1;
+        }
+        return 0xFF;
+    }
+    if (bus_ignored)
+        return 0xFF;
+
+    switch (bus_cmd) {
+    case FLASH_CMD_READ_STATUS:
+        return bus_status();
+    case FLASH_CMD_READ_ID:
+        if (n > 4)
+            return 0xFF;
+        return (FLASH_RDID_VAL_S25FS064S >> (8 * (4 - n))) & 0xFF;
+    case FLASH_CMD_READ_DATA:
+    case FLASH_CMD_FAST_READ:
+    case FLASH_CMD_PAGE_PROGRAM:
+    case FLASH_CMD_ERASE_BLOCK:
+    case FLASH_CMD_WRAR:
+    case FLASH_CMD_RDAR:
+        if (n <= 3) {
+            bus_addr = (bus_addr << 8) | out;
+            return 0xFF;
+        }
+        break;
+    default:
+        return 0xFF;
+    }
+
+    switch (bus_cmd) {
+    case FLASH_CMD_READ_DATA:
+        return bus_read_byte(n - 4);
+    case FLASH_CMD_FAST_READ:
+        if (n == 4)
+            return 0xFF; // dummy
+        return bus_read_byte(n - 5);
+    case FLASH_CMD_PAGE_PROGRAM:
+        if ((bus_addr & (FLASH_PAGE_SIZE-1)) + n - 4 == FLASH_PAGE_SIZE)
+            bus_violation("page program wrapped around its page");
+        bus_page[(bus_addr + n - 4) & (FLASH_PAGE_SIZE-1)] = out;
+        return 0xFF;
+    case FLASH_CMD_WRAR:
+        bus_reg_val = out;
+        return 0xFF;
+    case FLASH_CMD_RDAR:
+        return bus_regs[bus_addr & 7];
+    }
+    bus_violation("too many bytes for the command");
+    return 0xFF;
+}
+
+/// Run the DMA transfer, if the driver has set it up and started it.
+void bus_dma_run() {
+    uint8_t *src;
+    uint8_t *dst;
+
+    if (!(bus_dma0ctl & DMAEN) || !(bus_dma1ctl & DMAEN))
+        return;
+    // Both channels trigger on rising edges, so nothing moves until the
+    //  driver pulls UCTXIFG low and lets it back up.
+    if (!bus_tx_edge || !(bus_ifg & UCTXIFG))
+        return;
+    bus_tx_edge = 0;
+
+    if (DMACTL0 != (DMA0TSEL_16 | DMA1TSEL_17))
+        bus_violation("DMA channels triggered by the wrong flags");
+    if (DMACTL4 & ROUNDROBIN)
+        bus_violation("DMA in round-robin, so TX can get ahead of RX");
+    if ((bus_dma0ctl & BUS_DMA_CTL_MASK) != BUS_DMA0_CTL
+            || (bus_dma1ctl & BUS_DMA_CTL_MASK) != BUS_DMA1_CTL)
+        bus_violation("DMA channels in the wrong transfer mode");
+    if (DMA0SA != (uintptr_t) &bus_rx || DMA1DA != (uintptr_t) &bus_tx)
+        bus_violation("DMA channels not connected to eUSCI_A1");
+    if (!DMA0SZ || DMA0SZ != DMA1SZ)
+        bus_violation("DMA channels of different sizes");
+    if (bus_ifg & UCRXIFG)
+        bus_violation("DMA started with UCRXIFG already set");
+
+    src = (uint8_t *) DMA1SA;
+    dst = (uint8_t *) DMA0DA;
+    for (uint16_t i=0; i<DMA0SZ; i++) {
+        dst[i] = bus_clock(*src);
+    }
+    s25fs_bus_stats.dma_bytes += DMA0SZ;
+    s25fs_bus_stats.dma_transfers++;
+
+    // Single transfer mode turns the channels off when they're done.
+    bus_dma0ctl = (bus_dma0ctl & ~DMAEN) | DMAIFG;
+    bus_dma1ctl = (bus_dma1ctl & ~DMAEN) | DMAIFG;
+}
+
+/// The driver has gone to sleep; the only thing that can wake it is the DMA.
+void bus_lpm() {
+    bus_dma_run();
+    if (!(host_sr & GIE) || !(bus_dma0ctl & DMAIE)
+            || !(bus_dma0ctl & DMAIFG)) {
+        fprintf(stderr, "flash bus: CPU asleep with no DMA interrupt coming\n");
+        exit(1);
+    }
+    // Reading DMAIV clears the flag.
+    bus_dma0ctl &= ~DMAIFG;
+    DMAIV = DMAIV_DMA0IFG;
+    S25FS_DMA_ISR();
+    DMAIV = 0;
+    s25fs_bus_stats.dma_isr_wakes++;
+}
+
+volatile uint8_t *s25fs_bus_p3out() {
+    s25fs_bus_sync();
+    return &bus_p3out;
+}
+
+volatile uint16_t *s25fs_bus_txbuf() {
+    s25fs_bus_sync();
+    if (bus_tx != BUS_TX_EMPTY)
+        bus_violation("UCA1TXBUF written before the last byte went out");
+    return &bus_tx;
+}
+
+volatile uint16_t *s25fs_bus_ifg() {
+    s25fs_bus_sync();
+    if (!(bus_ifg & UCTXIFG))
+        bus_tx_edge = 1;
+    if (bus_tx != BUS_TX_EMPTY) {
+        bus_rx = bus_clock((uint8_t) bus_tx);
+        bus_tx = BUS_TX_EMPTY;
+        bus_ifg |= UCRXIFG;
+        s25fs_bus_stats.cpu_bytes++;
+    }
+    return &bus_ifg;
+}
+
+volatile uint16_t *s25fs_bus_rxbuf() {
+    s25fs_bus_sync();
+    bus_ifg &= ~UCRXIFG;
+    return &bus_rx;
+}
+
+volatile uint16_t *s25fs_bus_dma0ctl() {
+    s25fs_bus_sync();
+    bus_dma_run();
+    if (!(bus_dma0ctl & DMAEN)) {
+        bus_dma_polls = 0;
+    } else if (++bus_dma_polls > BUS_STUCK_POLLS) {
+        fprintf(stderr, "flash bus: DMA never started\n");
+        exit(1);
+    }
+    return &bus_dma0ctl;
+}
+
+volatile uint16_t *s25fs_bus_dma1ctl() {
+    s25fs_bus_sync();
+    return &bus_dma1ctl;
+}
+
+/// Run the bus at whatever clock the driver asks for.
+void EUSCI_A_SPI_initMaster(uint16_t base, EUSCI_A_SPI_initMasterParam *param) {
+    // The clock is divided down from the source by a whole number.
+    s25fs_bus_spi_hz = param->clockSourceFrequency
+            / (param->clockSourceFrequency / param->desiredSpiClock);
+}
+
+/// Start over with a fully erased chip, and hook into LPM for the DMA.
+void s25fs_bus_reset() {
+    if (!bus_image)
+        bus_image = malloc(S25FS_BUS_SIZE);
+    memset(bus_image, 0xFF, S25FS_BUS_SIZE);
+    memset(bus_regs, 0, sizeof(bus_regs));
+    memset(&s25fs_bus_stats, 0, sizeof(s25fs_bus_stats));
+    bus_busy_until = 0;
+    bus_suspended_left = 0;
+    bus_wel = 0;
+    bus_powered_down = 0;
+    s25fs_bus_violations = 0;
+    host_lpm_hook = bus_lpm;
+}
+
+/// Move the virtual clock forward, e.g. by one time loop.
+void s25fs_bus_advance(uint64_t ns) {
+    s25fs_bus_now += ns;
+}
+
+/// Direct pointer into the chip, for checking what the driver wrote.
+uint8_t *s25fs_bus_image() {
+    s25fs_bus_sync();
+    return bus_image;
+}
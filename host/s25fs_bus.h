@@ -0,0 +1,42 @@
+/// Header for the host model of the S25FS064S on eUSCI_A1's SPI bus.
+/**
+ ** \file s25fs_bus.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef S25FS_BUS_H_
+#define S25FS_BUS_H_
+
+#include <stdint.h>
+
+#define S25FS_BUS_SIZE 0x800000
+
+/// Bus traffic, by how it was clocked.
+typedef struct {
+    /// Transactions (chip select low to high).
+    uint32_t commands;
+    /// Bytes clocked by the CPU through UCA1TXBUF.
+    uint32_t cpu_bytes;
+    /// Bytes clocked by the DMA.
+    uint32_t dma_bytes;
+    /// DMA transfers, and how many of them woke the CPU with the ISR.
+    uint32_t dma_transfers;
+    uint32_t dma_isr_wakes;
+} s25fs_bus_stats_t;
+
+extern uint32_t s25fs_bus_spi_hz;
+extern uint64_t s25fs_bus_program_ns;
+extern uint64_t s25fs_bus_erase_ns;
+extern uint64_t s25fs_bus_now;
+extern uint32_t s25fs_bus_violations;
+extern s25fs_bus_stats_t s25fs_bus_stats;
+
+void s25fs_bus_reset();
+void s25fs_bus_sync();
+void s25fs_bus_advance(uint64_t ns);
+uint8_t s25fs_bus_busy();
+uint8_t *s25fs_bus_image();
+
+#endif /* S25FS_BUS_H_ */
@@ -0,0 +1,220 @@
+/// Check the real SPI flash driver against a byte-level model of the chip.
+/**
+ ** This links the firmware's s25fs.c against s25fs_bus.c, which decodes the
+ ** bytes the driver clocks out of eUSCI_A1 (by CPU or by DMA) the way the
+ ** S25FS064S would. It brings the chip up the way the badge does, writes
+ ** random data with `s25fs_write_stream()`, and reads it back in random
+ ** pieces with interrupts off (the DMA polled) and on (the DMA ISR waking
+ ** the CPU from LPM0), plus one read too long for a single DMA transfer.
+ ** Then it mixes queued jobs with the synchronous program and erase calls,
+ ** in both orders.
+ **
+ ** Usage: s25fs_check [reads]
+ **
+ ** Exits nonzero if anything reads back wrong, or if the driver did anything
+ ** on the bus that the chip or the DMA would have ignored or mangled.
+ **
+ ** \file s25fs_check.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qc15.h"
+#include "s25fs.h"
+#include "s25fs_bus.h"
+
+/// Where the checks write, and how much.
+#define CHECK_BASE 0x100000
+#define CHECK_LEN 0x40000
+/// Where the job checks write; a block each.
+#define JOB_BASE 0x200000
+
+/// 1/32 of a second, in ns.
+#define TICK_NS 31250000ULL
+
+volatile qc_clock_t qc_clock;
+
+uint8_t expect[CHECK_LEN];
+uint8_t got[CHECK_LEN];
+uint32_t seed = 1;
+
+uint32_t rnd() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/// Report a check, returning 1 if it failed.
+uint8_t result(const char *what, uint32_t bad) {
+    printf("%-40s %s", what, bad ? "MISMATCH" : "ok");
+    if (bad)
+        printf(" (%lu bad)", (unsigned long) bad);
+    printf("\n");
+    return bad ? 1 : 0;
+}
+
+uint32_t compare(uint32_t offset, uint32_t len) {
+    uint32_t bad = 0;
+
+    for (uint32_t i=0; i<len; i++) {
+        if (got[i] != expect[offset + i])
+            bad++;
+    }
+    return bad;
+}
+
+/// Fill the check region with random data, in randomly sized writes.
+uint32_t check_writes() {
+    uint32_t offset = 0;
+    uint32_t len;
+    uint32_t bad = 0;
+
+    for (uint32_t i=0; i<CHECK_LEN; i++) {
+        expect[i] = rnd();
+    }
+    while (offset < CHECK_LEN) {
+        len = 1 + rnd() % 700;
+        if (offset + len > CHECK_LEN)
+            len = CHECK_LEN - offset;
+        if (!s25fs_write_stream(CHECK_BASE + offset, expect + offset, len))
+            bad++;
+        offset += len;
+    }
+    if (memcmp(s25fs_bus_image() + CHECK_BASE, expect, CHECK_LEN))
+        bad++;
+    return bad;
+}
+
+/// Read random pieces of the check region back.
+uint32_t check_reads(uint32_t reads) {
+    uint32_t offset;
+    uint32_t len;
+    uint32_t bad = 0;
+
+    for (uint32_t i=0; i<reads; i++) {
+        // Mostly short reads, so both sides of S25FS_DMA_MIN_LEN get used.
+        len = 1 + rnd() % (i % 4 ? 16 : 1024);
+        offset = rnd() % (CHECK_LEN - len);
+        memset(got, 0, len);
+        s25fs_read_data(got, CHECK_BASE + offset, len);
+        bad += compare(offset, len);
+    }
+    return bad;
+}
+
+/// Bytes in `len` bytes at `address` that aren't `expect`, or are not 0xFF
+/// if `expect` is null.
+uint32_t image_bad(uint32_t address, uint8_t *expect, uint32_t len) {
+    uint8_t *image = s25fs_bus_image();
+    uint32_t bad = 0;
+
+    for (uint32_t i=0; i<len; i++) {
+        if (image[address + i] != (expect ? expect[i] : 0xFF))
+            bad++;
+    }
+    return bad;
+}
+
+/// One pass through the time loop, as far as the flash is concerned.
+void tick() {
+    qc_clock.time++;
+    s25fs_bus_advance(TICK_NS);
+    s25fs_job_poll();
+}
+
+/// A job queued while a synchronous erase is still going.
+uint32_t check_job_after_erase() {
+    uint32_t address = JOB_BASE;
+    uint32_t ticks = 0;
+    uint32_t bad;
+
+    s25fs_wr_en();
+    s25fs_erase_block_64kb(address);
+    // That returned with the chip still busy. The job crosses a page.
+    s_flash_job_done = 0;
+    s25fs_job_program(address + 0x80, expect, 600, 0);
+    while (!s_flash_job_done && ticks++ < 100)
+        tick();
+    bad = image_bad(address + 0x80, expect, 600);
+    if (!s_flash_job_done || !s25fs_job_last_result)
+        bad++;
+    return bad;
+}
+
+/// A synchronous program, set up with `s25fs_wr_en()` while a job waits.
+uint32_t check_write_after_job() {
+    uint32_t address = JOB_BASE + 0x10000;
+    uint32_t bad;
+
+    s25fs_job_erase_block(address, 0);
+    s25fs_wr_en();
+    s25fs_write_data(address + 0x100, expect, 200);
+    s25fs_block_while_wip();
+    bad = image_bad(address, 0, 0x100);
+    bad += image_bad(address + 0x100, expect, 200);
+    return bad;
+}
+
+/// A synchronous erase, set up with `s25fs_wr_en()` while a job waits.
+uint32_t check_erase_after_job() {
+    uint32_t address = JOB_BASE + 0x20000;
+
+    s25fs_job_program(address, expect, 300, 0);
+    s25fs_wr_en();
+    s25fs_erase_block_64kb(address);
+    s25fs_block_while_wip();
+    return image_bad(address, 0, 0x10000);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t reads = argc > 1 ? strtoul(argv[1], 0, 0) : 5000;
+    uint32_t isr_wakes;
+    uint8_t failures = 0;
+
+    s25fs_bus_reset();
+    s25fs_init_io();
+    s25fs_init();
+    failures += result("s25fs_post1", !s25fs_post1());
+    failures += result("s25fs_post2", !s25fs_post2());
+
+    failures += result("s25fs_write_stream", check_writes());
+
+    failures += result("reads, interrupts off", check_reads(reads));
+    if (s25fs_bus_stats.dma_isr_wakes)
+        failures += result("no DMA ISR with interrupts off", 1);
+
+    __enable_interrupt();
+    failures += result("reads, interrupts on", check_reads(reads));
+    isr_wakes = s25fs_bus_stats.dma_isr_wakes;
+    __disable_interrupt();
+    if (!isr_wakes)
+        failures += result("DMA ISR with interrupts on", 1);
+
+    memset(got, 0, CHECK_LEN);
+    s25fs_read_data(got, CHECK_BASE, CHECK_LEN);
+    failures += result("one read over 64 KB", compare(0, CHECK_LEN));
+
+    failures += result("job behind a synchronous erase",
+                       check_job_after_erase());
+    failures += result("synchronous program behind a job",
+                       check_write_after_job());
+    failures += result("synchronous erase behind a job",
+                       check_erase_after_job());
+
+    printf("bus: %lu commands, %lu bytes by CPU, %lu bytes in %lu DMA "
+           "transfers (%lu ISR wakes), %.1f ms\n",
+           (unsigned long) s25fs_bus_stats.commands,
+           (unsigned long) s25fs_bus_stats.cpu_bytes,
+           (unsigned long) s25fs_bus_stats.dma_bytes,
+           (unsigned long) s25fs_bus_stats.dma_transfers,
+           (unsigned long) isr_wakes, s25fs_bus_now / 1000000.0);
+    failures += result("bus violations",
+                       s25fs_bus_violations);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,566 @@
+/// File-backed S25FS064S emulator, standing in for s25fs.c in host builds.
+/**
+ ** This implements the same API as ccs_workspace/qc15_main/s25fs.c, on top
+ ** of an 8 MB image file that's mmap'd into memory. It behaves like a NOR
+ ** flash: programming can only clear bits, an erase sets a whole 64 KB block
+ ** back to 0xFF, a page program wraps around at the end of its 256-byte page,
+ ** and program/erase commands are ignored unless the write enable latch is
+ ** set and the chip isn't busy. Anything that the real chip would silently
+ ** ignore or mangle is counted in `s25fs_emu_violations`.
+ **
+ ** It also keeps a virtual clock. Every byte on the SPI bus costs 8 bit
+ ** times at `s25fs_emu_spi_hz`, and programs and erases make the chip busy
+ ** (WIP) for a typical amount of time. Host harnesses move the clock forward
+ ** with `s25fs_emu_advance()` once per simulated time loop; anything that
+ ** blocks on WIP moves it forward too, and that waiting is counted.
+ **
+ ** Every command is charged to the firmware function that called the API,
+ ** found with __builtin_return_address() and dladdr(). Link with -rdynamic
+ ** so dladdr() can see the executable's symbols.
+ **
+ ** Environment variables:
+ **  * QC15_FLASH_IMAGE - image file (default qc15_flash.bin), created and
+ **                       filled with 0xFF if it doesn't exist.
+ **  * QC15_SPI_HZ      - SPI clock (default 1000000, SMCLK).
+ **
+ ** \file s25fs_emu.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdint.h>
+
+#include "qc15.h"
+#include "s25fs.h"
+#include "flash_cache.h"
+#include "s25fs_emu.h"
+
+#define FLASH_SIZE 0x800000
+#define FLASH_BLOCK_SIZE 0x10000
+#define FLASH_PAGE_SIZE 256
+
+#define FLASH_RDID_VAL_S25FS064S 0x0102174D
+
+const uint8_t FLASH_SR_WIP = BIT0;
+const uint8_t FLASH_SR_WEL = BIT1;
+
+/// SPI clock, in Hz.
+uint32_t s25fs_emu_spi_hz = 1000000;
+/// Time the chip spends on a page program, in ns.
+uint64_t s25fs_emu_program_ns = 450000;
+/// Time the chip spends on a 64 KB block erase, in ns.
+uint64_t s25fs_emu_erase_ns = 520000000;
+/// Time the chip spends on a chip erase, in ns.
+uint64_t s25fs_emu_chip_erase_ns = 55000000000ULL;
+/// Time to suspend an erase so we can read, in ns.
+uint64_t s25fs_emu_suspend_ns = 40000;
+/// A 64 KB block (by address) whose erases fail with E_ERR, or
+///  S25FS_EMU_NO_BLOCK.
+uint32_t s25fs_emu_bad_block = S25FS_EMU_NO_BLOCK;
+
+/// The virtual clock, in ns.
+uint64_t s25fs_emu_now = 0;
+/// Commands that the real chip would have ignored or mangled.
+uint32_t s25fs_emu_violations = 0;
+
+s25fs_emu_caller_t s25fs_emu_callers[S25FS_EMU_MAX_CALLERS];
+uint8_t s25fs_emu_caller_count = 0;
+
+uint8_t *flash_image = 0;
+uint64_t flash_busy_until = 0;
+uint8_t flash_wel = 0;
+uint8_t flash_sr_err = 0;
+
+// Same globals as s25fs.c, so the rest of the firmware links unchanged.
+uint8_t s_flash_job_done = 0;
+uint8_t s25fs_job_last_result = 0;
+uint16_t s25fs_job_count_done[S25FS_JOB_TYPE_COUNT] = {0,};
+uint32_t s25fs_job_latency_last[S25FS_JOB_TYPE_COUNT] = {0,};
+uint32_t s25fs_job_latency_max[S25FS_JOB_TYPE_COUNT] = {0,};
+uint8_t s25fs_job_count = 0;
+s25fs_write_stats_t s25fs_write_stats_last = {0};
+s25fs_write_stats_t s25fs_write_stats_total = {0};
+
+typedef struct {
+    uint8_t type;
+    uint32_t address;
+    uint8_t *buffer;
+    uint16_t len;
+    uint8_t *result;
+} emu_job_t;
+
+emu_job_t emu_jobs[S25FS_JOB_QUEUE_LEN];
+uint8_t emu_job_head = 0;
+uint8_t emu_job_active = 0;
+uint32_t emu_job_started_at = 0;
+
+/// Find (or make) the accounting entry for the function at `ret`.
+s25fs_emu_caller_t *emu_caller(void *ret) {
+    Dl_info info;
+    const char *name = "?";
+
+    if (dladdr(ret, &info) && info.dli_sname)
+        name = info.dli_sname;
+
+    for (uint8_t i=0; i<s25fs_emu_caller_count; i++) {
+        if (!strcmp(s25fs_emu_callers[i].name, name))
+            return &s25fs_emu_callers[i];
+    }
+
+    if (s25fs_emu_caller_count == S25FS_EMU_MAX_CALLERS)
+        return &s25fs_emu_callers[S25FS_EMU_MAX_CALLERS-1];
+
+    s25fs_emu_caller_t *caller = &s25fs_emu_callers[s25fs_emu_caller_count++];
+    memset(caller, 0, sizeof(*caller));
+    strncpy(caller->name, name, sizeof(caller->name)-1);
+    return caller;
+}
+
+/// Charge `bytes` bytes of bus traffic to `caller` and advance the clock.
+void emu_bus(s25fs_emu_caller_t *caller, uint32_t bytes) {
+    uint64_t ns = (uint64_t) bytes * 8 * 1000000000ULL / s25fs_emu_spi_hz;
+
+    caller->commands++;
+    caller->bus_bytes += bytes;
+    caller->bus_ns += ns;
+    s25fs_emu_now += ns;
+}
+
+/// Spin on the status register until the chip is idle, like the firmware.
+void emu_wait(s25fs_emu_caller_t *caller) {
+    while (s25fs_emu_now < flash_busy_until) {
+        uint64_t before = s25fs_emu_now;
+        // One status read (command plus one byte), plus __delay_cycles(100)
+        //  at 8 MHz between polls.
+        emu_bus(caller, 2);
+        s25fs_emu_now += 12500;
+        caller->wait_ns += s25fs_emu_now - before;
+    }
+}
+
+uint8_t emu_busy() {
+    return s25fs_emu_now < flash_busy_until;
+}
+
+/// Map the image file, creating it if needed.
+void s25fs_emu_open() {
+    const char *path = getenv("QC15_FLASH_IMAGE");
+    const char *hz = getenv("QC15_SPI_HZ");
+    struct stat st;
+    int fd;
+
+    if (flash_image)
+        return;
+    if (!path)
+        path = "qc15_flash.bin";
+    if (hz)
+        s25fs_emu_spi_hz = strtoul(hz, 0, 0);
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(path);
+        exit(1);
+    }
+
+    if (st.st_size != FLASH_SIZE) {
+        // Fresh (or wrong-sized) image: start out fully erased.
+        uint8_t block[FLASH_BLOCK_SIZE];
+        memset(block, 0xFF, sizeof(block));
+        if (ftruncate(fd, 0)) {
+            perror(path);
+            exit(1);
+        }
+        for (uint32_t i=0; i<FLASH_SIZE; i+=FLASH_BLOCK_SIZE) {
+            if (write(fd, block, sizeof(block)) != sizeof(block)) {
+                perror(path);
+                exit(1);
+            }
+        }
+    }
+
+    flash_image = mmap(0, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+    close(fd);
+    if (flash_image == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+}
+
+/// Move the virtual clock forward, e.g. by one time loop.
+void s25fs_emu_advance(uint64_t ns) {
+    s25fs_emu_now += ns;
+}
+
+/// Direct pointer into the image, for harnesses that want to look at it.
+uint8_t *s25fs_emu_image() {
+    s25fs_emu_open();
+    return flash_image;
+}
+
+void s25fs_emu_reset_stats() {
+    s25fs_emu_caller_count = 0;
+    s25fs_emu_violations = 0;
+}
+
+void s25fs_emu_report(FILE *out) {
+    uint64_t total_ns = 0;
+
+    fprintf(out, "%-32s %8s %10s %12s %12s\n", "caller", "cmds", "bytes",
+            "bus_us", "wip_wait_us");
+    for (uint8_t i=0; i<s25fs_emu_caller_count; i++) {
+        s25fs_emu_caller_t *c = &s25fs_emu_callers[i];
+        fprintf(out, "%-32s %8lu %10lu %12.1f %12.1f\n", c->name,
+                (unsigned long) c->commands, (unsigned long) c->bus_bytes,
+                c->bus_ns / 1000.0, c->wait_ns / 1000.0);
+        total_ns += c->bus_ns;
+    }
+    fprintf(out, "total bus time %.1f us, %u violations\n", total_ns / 1000.0,
+            s25fs_emu_violations);
+}
+
+/// Apply a page program the way the chip does: AND in, wrapping in the page.
+void emu_program(uint32_t address, uint8_t *buffer, uint32_t len_bytes) {
+    uint32_t page = address & ~(FLASH_PAGE_SIZE-1) & (FLASH_SIZE-1);
+    uint32_t offset = address & (FLASH_PAGE_SIZE-1);
+
+    if (len_bytes > FLASH_PAGE_SIZE) {
+        // Only the last 256 bytes clocked in are kept.
+        s25fs_emu_violations++;
+        offset = (offset + len_bytes - FLASH_PAGE_SIZE)
+                 & (FLASH_PAGE_SIZE-1);
+        buffer += len_bytes - FLASH_PAGE_SIZE;
+        len_bytes = FLASH_PAGE_SIZE;
+    } else if (offset + len_bytes > FLASH_PAGE_SIZE) {
+        // This is the silent wrap that s25fs_write_stream() avoids.
+        s25fs_emu_violations++;
+    }
+
+    for (uint32_t i=0; i<len_bytes; i++) {
+        flash_image[page + ((offset + i) & (FLASH_PAGE_SIZE-1))] &= buffer[i];
+    }
+}
+
+/// Common gatekeeping for program and erase commands.
+uint8_t emu_write_allowed() {
+    if (emu_busy() || !flash_wel) {
+        s25fs_emu_violations++;
+        return 0;
+    }
+    flash_wel = 0;
+    return 1;
+}
+
+void emu_start_program(s25fs_emu_caller_t *caller, uint32_t address,
+                       uint8_t *buffer, uint32_t len_bytes) {
+    emu_bus(caller, 4 + len_bytes);
+    if (!emu_write_allowed())
+        return;
+    flash_cache_invalidate(address, len_bytes);
+    emu_program(address, buffer, len_bytes);
+    flash_busy_until = s25fs_emu_now + s25fs_emu_program_ns;
+}
+
+void emu_start_erase(s25fs_emu_caller_t *caller, uint32_t address) {
+    emu_bus(caller, 4);
+    if (!emu_write_allowed())
+        return;
+    address &= (FLASH_SIZE-1) & ~(FLASH_BLOCK_SIZE-1);
+    flash_busy_until = s25fs_emu_now + s25fs_emu_erase_ns;
+    if (address == s25fs_emu_bad_block) {
+        flash_sr_err = BIT5; // E_ERR
+        return;
+    }
+    flash_cache_invalidate(address, FLASH_BLOCK_SIZE);
+    memset(flash_image + address, 0xFF, FLASH_BLOCK_SIZE);
+}
+
+void s25fs_init_io() {
+    s25fs_emu_open();
+}
+
+void s25fs_hold_io() {
+}
+
+void s25fs_init() {
+    s25fs_emu_open();
+    flash_sr_err = 0;
+}
+
+uint8_t s25fs_get_status() {
+    emu_bus(emu_caller(__builtin_return_address(0)), 2);
+    return (emu_busy() ? FLASH_SR_WIP : 0) | (flash_wel ? FLASH_SR_WEL : 0)
+            | flash_sr_err;
+}
+
+void s25fs_wr_en() {
+    emu_bus(emu_caller(__builtin_return_address(0)), 1);
+    flash_wel = 1;
+}
+
+void s25fs_wr_dis() {
+    emu_bus(emu_caller(__builtin_return_address(0)), 1);
+    flash_wel = 0;
+}
+
+uint8_t s25fs_post1() {
+    return 1;
+}
+
+uint8_t s25fs_post2() {
+    return 1;
+}
+
+void s25fs_job_flush();
+
+void s25fs_block_while_wip() {
+    emu_wait(emu_caller(__builtin_return_address(0)));
+}
+
+/// Same as the firmware: flush the jobs, and put back the write enable
+/// latch that they used up.
+void emu_job_drain(s25fs_emu_caller_t *caller) {
+    if (!s25fs_job_count)
+        return;
+    s25fs_job_flush();
+    emu_bus(caller, 1);
+    flash_wel = 1;
+}
+
+void s25fs_read_data(uint8_t* buffer, uint32_t address, uint32_t len_bytes) {
+    s25fs_emu_caller_t *caller = emu_caller(__builtin_return_address(0));
+    uint8_t suspended = 0;
+
+    if (s25fs_job_count) {
+        // Same policy as the firmware: conflicting jobs drain, a running
+        //  erase gets suspended, a running program gets to finish.
+        emu_job_t *job = &emu_jobs[emu_job_head];
+        uint8_t conflict = 0;
+        for (uint8_t i=0; i<s25fs_job_count; i++) {
+            emu_job_t *j = &emu_jobs[(emu_job_head+i) % S25FS_JOB_QUEUE_LEN];
+            uint32_t start = j->type == S25FS_JOB_ERASE ?
+                    (j->address & ~(FLASH_BLOCK_SIZE-1)) : j->address;
+            uint32_t len = j->type == S25FS_JOB_ERASE ?
+                    FLASH_BLOCK_SIZE : j->len;
+            if (address < start + len && start < address + len_bytes)
+                conflict = 1;
+        }
+        if (conflict) {
+            s25fs_job_flush();
+        } else if (emu_job_active && job->type == S25FS_JOB_ERASE
+                && emu_busy()) {
+            emu_bus(caller, 1);
+            s25fs_emu_now += s25fs_emu_suspend_ns;
+            suspended = 1;
+        }
+    }
+
+    if (!suspended)
+        emu_wait(caller);
+
+    uint64_t before = s25fs_emu_now;
+    // FAST_READ: command, three address bytes, one dummy byte.
+    emu_bus(caller, 5 + len_bytes);
+    caller->read_bytes += len_bytes;
+    for (uint32_t i=0; i<len_bytes; i++) {
+        buffer[i] = flash_image[(address + i) & (FLASH_SIZE-1)];
+    }
+
+    if (suspended) {
+        // Resume; the erase didn't progress while we were reading.
+        emu_bus(caller, 1);
+        flash_busy_until += s25fs_emu_now - before + s25fs_emu_suspend_ns;
+    }
+}
+
+void s25fs_write_data(uint32_t address, uint8_t* buffer, uint32_t len_bytes) {
+    s25fs_emu_caller_t *caller = emu_caller(__builtin_return_address(0));
+
+    emu_job_drain(caller);
+    emu_wait(caller);
+    emu_start_program(caller, address, buffer, len_bytes);
+    caller->program_bytes += len_bytes;
+}
+
+uint8_t s25fs_write_stream(uint32_t address, uint8_t *buffer,
+                           uint32_t len_bytes) {
+    s25fs_emu_caller_t *caller = emu_caller(__builtin_return_address(0));
+    uint64_t start = s25fs_emu_now;
+    uint16_t chunk;
+
+    s25fs_job_flush();
+    emu_wait(caller);
+
+    s25fs_write_stats_last.bytes = 0;
+    s25fs_write_stats_last.pages = 0;
+
+    while (len_bytes) {
+        chunk = FLASH_PAGE_SIZE - (address & (FLASH_PAGE_SIZE-1));
+        if (chunk > len_bytes)
+            chunk = len_bytes;
+
+        emu_bus(caller, 1);
+        flash_wel = 1;
+        emu_start_program(caller, address, buffer, chunk);
+        emu_wait(caller);
+        if (flash_sr_err)
+            return 0;
+
+        caller->program_bytes += chunk;
+        s25fs_write_stats_last.bytes += chunk;
+        s25fs_write_stats_last.pages++;
+        address += chunk;
+        buffer += chunk;
+        len_bytes -= chunk;
+    }
+
+    s25fs_write_stats_last.usecs = (s25fs_emu_now - start) / 1000;
+    s25fs_write_stats_total.bytes += s25fs_write_stats_last.bytes;
+    s25fs_write_stats_total.pages += s25fs_write_stats_last.pages;
+    s25fs_write_stats_total.usecs += s25fs_write_stats_last.usecs;
+    return 1;
+}
+
+void s25fs_erase_block_64kb(uint32_t address) {
+    s25fs_emu_caller_t *caller = emu_caller(__builtin_return_address(0));
+
+    emu_job_drain(caller);
+    emu_wait(caller);
+    emu_start_erase(caller, address);
+}
+
+void s25fs_erase_chip() {
+    s25fs_emu_caller_t *caller = emu_caller(__builtin_return_address(0));
+
+    emu_job_drain(caller);
+    emu_wait(caller);
+    emu_bus(caller, 1);
+    if (!emu_write_allowed())
+        return;
+    flash_cache_invalidate_all();
+    memset(flash_image, 0xFF, FLASH_SIZE);
+    flash_busy_until = s25fs_emu_now + s25fs_emu_chip_erase_ns;
+}
+
+void s25fs_sleep() {
+}
+
+void s25fs_wake() {
+}
+
+void emu_job_start(s25fs_emu_caller_t *caller) {
+    emu_job_t *job = &emu_jobs[emu_job_head];
+    uint16_t chunk;
+
+    emu_bus(caller, 1);
+    flash_wel = 1;
+    if (job->type == S25FS_JOB_ERASE) {
+        emu_start_erase(caller, job->address);
+    } else {
+        chunk = FLASH_PAGE_SIZE - (job->address & (FLASH_PAGE_SIZE-1));
+        if (chunk > job->len)
+            chunk = job->len;
+        emu_start_program(caller, job->address, job->buffer, chunk);
+        caller->program_bytes += chunk;
+        job->address += chunk;
+        job->buffer += chunk;
+        job->len -= chunk;
+    }
+    if (!emu_job_active)
+        emu_job_started_at = qc_clock.time;
+    emu_job_active = 1;
+}
+
+void emu_job_finish(s25fs_emu_caller_t *caller) {
+    emu_job_t *job = &emu_jobs[emu_job_head];
+    uint32_t latency = qc_clock.time - emu_job_started_at;
+
+    if (job->type == S25FS_JOB_PROGRAM && job->len) {
+        emu_job_start(caller);
+        return;
+    }
+
+    // Like s25fs.c, clear any error with CLSR.
+    s25fs_job_last_result = !flash_sr_err;
+    if (flash_sr_err)
+        emu_bus(caller, 1);
+    flash_sr_err = 0;
+    if (job->result)
+        *job->result = s25fs_job_last_result;
+    s25fs_job_count_done[job->type]++;
+    s25fs_job_latency_last[job->type] = latency;
+    if (latency > s25fs_job_latency_max[job->type])
+        s25fs_job_latency_max[job->type] = latency;
+
+    emu_job_active = 0;
+    emu_job_head = (emu_job_head + 1) % S25FS_JOB_QUEUE_LEN;
+    s25fs_job_count--;
+    s_flash_job_done = 1;
+}
+
+void s25fs_job_poll() {
+    s25fs_emu_caller_t *caller = emu_caller(__builtin_return_address(0));
+
+    if (!s25fs_job_count)
+        return;
+    // One status read; a job doesn't start while the chip is still busy
+    //  with something synchronous.
+    emu_bus(caller, 2);
+    if (emu_busy())
+        return;
+    if (emu_job_active)
+        emu_job_finish(caller);
+    if (s25fs_job_count && !emu_job_active)
+        emu_job_start(caller);
+}
+
+void s25fs_job_flush() {
+    s25fs_emu_caller_t *caller = emu_caller(__builtin_return_address(0));
+
+    while (s25fs_job_count) {
+        if (!emu_job_active) {
+            emu_wait(caller);
+            emu_job_start(caller);
+        }
+        emu_wait(caller);
+        emu_job_finish(caller);
+    }
+}
+
+uint8_t emu_job_submit(uint8_t type, uint32_t address, uint8_t *buffer,
+                       uint16_t len_bytes, uint8_t *result) {
+    if (s25fs_job_count == S25FS_JOB_QUEUE_LEN)
+        return 0;
+    emu_job_t *job = &emu_jobs[(emu_job_head + s25fs_job_count)
+                               % S25FS_JOB_QUEUE_LEN];
+    job->type = type;
+    job->address = address;
+    job->buffer = buffer;
+    job->len = len_bytes;
+    job->result = result;
+    if (result)
+        *result = S25FS_JOB_PENDING;
+    s25fs_job_count++;
+    return 1;
+}
+
+uint8_t s25fs_job_erase_block(uint32_t address, uint8_t *result) {
+    return emu_job_submit(S25FS_JOB_ERASE, address, 0, 0, result);
+}
+
+uint8_t s25fs_job_program(uint32_t address, uint8_t *buffer,
+                          uint16_t len_bytes, uint8_t *result) {
+    return emu_job_submit(S25FS_JOB_PROGRAM, address, buffer, len_bytes,
+                          result);
+}
@@ -0,0 +1,48 @@
+/// Header for the host-side S25FS064S emulator.
+/**
+ ** \file s25fs_emu.h
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#ifndef S25FS_EMU_H_
+#define S25FS_EMU_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define S25FS_EMU_MAX_CALLERS 64
+#define S25FS_EMU_NO_BLOCK 0xFFFFFFFF
+
+/// Flash bus usage charged to one firmware function.
+typedef struct {
+    char name[48];
+    uint64_t commands;
+    uint64_t bus_bytes;
+    uint64_t read_bytes;
+    uint64_t program_bytes;
+    /// Time the bus spent clocking this caller's bytes.
+    uint64_t bus_ns;
+    /// Time this caller spent polling WIP while the chip was busy.
+    uint64_t wait_ns;
+} s25fs_emu_caller_t;
+
+extern uint32_t s25fs_emu_spi_hz;
+extern uint64_t s25fs_emu_program_ns;
+extern uint64_t s25fs_emu_erase_ns;
+extern uint32_t s25fs_emu_bad_block;
+extern uint64_t s25fs_emu_now;
+extern uint32_t s25fs_emu_violations;
+extern s25fs_emu_caller_t s25fs_emu_callers[S25FS_EMU_MAX_CALLERS];
+extern uint8_t s25fs_emu_caller_count;
+
+void s25fs_emu_open();
+void s25fs_emu_advance(uint64_t ns);
+uint8_t *s25fs_emu_image();
+void s25fs_emu_reset_stats();
+void s25fs_emu_report(FILE *out);
+
+uint8_t s25fs_get_status();
+
+#endif /* S25FS_EMU_H_ */
@@ -0,0 +1,240 @@
+/// Equivalence check for the game engine's timer scheduling.
+/**
+ ** game_process_timers() used to test every timer on every time loop, with
+ ** a modulo for the recurring ones. It now schedules each timer's next
+ ** firing instead. This checks that the two agree about which timer fires
+ ** when, by running the real game engine (game.c, through game_host.c, like
+ ** game_runner) on random states and comparing it, every time the timers
+ ** are processed, with the old algorithm, which is kept below.
+ **
+ ** Each trial writes a few states into the game image in the flash
+ ** emulator, with random timers: recurring and not, with clashing and
+ ** overlapping durations, in no particular order, and with action series
+ ** that are empty, that go to closed states, that go to other states, and
+ ** that take several time loops. The time loop is game_clock_tick()'s, except
+ ** that instead of specials and button presses, random action series get
+ ** started, which block the timers the same way those do.
+ **
+ ** Usage: timer_equiv [trials [seed]]
+ **
+ ** The exit status is 1 if the engine and the old algorithm ever disagree.
+ **
+ ** \file timer_equiv.c
+ ** \author George Louthan
+ ** \date   2018
+ ** \copyright (c) 2018 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qc15.h"
+#include "lcd111.h"
+#include "game.h"
+#include "badge.h"
+#include "flash_cache.h"
+#include "flash_layout.h"
+#include "s25fs.h"
+#include "s25fs_emu.h"
+#include "lcd_model.h"
+#include "game_host.h"
+
+#define GAME_ACTION_TYPE_STATE_TRANSITION 2
+#define GAME_ACTION_TYPE_NOP 7
+
+/// States in each trial. `STATE_CLOSED` is closed; the rest are open.
+#define TRIAL_STATES 4
+#define STATE_CLOSED 1
+/// Time loops per trial.
+#define TRIAL_TICKS 640
+/// The first action of every action series carries this plus its own ID in
+///  its duration, so we can tell which series the engine started.
+#define TAG_BASE 1000
+
+game_action_t actions[256];
+uint16_t actions_len;
+game_state_t states[TRIAL_STATES];
+
+/// The action series that stands in for specials and button presses.
+uint16_t interrupt_series;
+
+uint32_t rng_state;
+
+/// Content randomness, separate from rand(), which the engine uses.
+uint32_t rng(uint32_t n) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % n;
+}
+
+uint16_t add_action(uint16_t type, uint16_t detail) {
+    game_action_t *action = &actions[actions_len];
+    action->type = type;
+    action->detail = detail;
+    action->duration = 0;
+    action->next_action_id = ACTION_NONE;
+    action->next_choice_id = ACTION_NONE;
+    action->choice_share = 1;
+    action->choice_total = 1;
+    return actions_len++;
+}
+
+/// Add a series of `len` NOPs, optionally ending in a transition to `state`.
+uint16_t add_series(uint8_t len, uint16_t state) {
+    uint16_t first = actions_len;
+
+    for (uint8_t i=0; i<len; i++) {
+        add_action(GAME_ACTION_TYPE_NOP, 0);
+        if (i)
+            actions[first+i-1].next_action_id = first+i;
+    }
+    if (state != GAME_NULL) {
+        actions[actions_len-1].next_action_id = actions_len;
+        add_action(GAME_ACTION_TYPE_STATE_TRANSITION, state);
+    }
+    actions[first].duration = TAG_BASE + first;
+    return first;
+}
+
+uint16_t random_result() {
+    switch (rng(5)) {
+    case 0:
+        return ACTION_NONE;
+    case 1:
+        return add_series(1 + rng(2), STATE_CLOSED);
+    case 2:
+        // Any state, including this one, which starts it over.
+        return add_series(1 + rng(2), rng(TRIAL_STATES));
+    default:
+        return add_series(1 + rng(4), GAME_NULL);
+    }
+}
+
+uint32_t random_duration() {
+    switch (rng(8)) {
+    case 0:
+        return 30 + rng(200);
+    case 1:
+        return 2 * (1 + rng(6));
+    default:
+        return 1 + rng(12);
+    }
+}
+
+void make_trial() {
+    uint8_t *image = s25fs_emu_image();
+
+    actions_len = 0;
+    memset(states, 0, sizeof(states));
+    for (uint16_t s=0; s<TRIAL_STATES; s++) {
+        states[s].entry_series_id = rng(2) ? add_series(1 + rng(3), GAME_NULL)
+                                           : ACTION_NONE;
+        states[s].timer_series_len = rng(MAX_TIMERS + 1);
+        for (uint8_t i=0; i<states[s].timer_series_len; i++) {
+            game_timer_t *timer = &states[s].timer_series[i];
+            timer->recurring = rng(2);
+            timer->duration = random_duration();
+            // A non-recurring timer with no duration never fires. (The
+            //  old algorithm divides by zero for a recurring one.)
+            if (!timer->recurring && !rng(20))
+                timer->duration = 0;
+            timer->result_action_id = random_result();
+        }
+    }
+    interrupt_series = add_series(1 + rng(5), GAME_NULL);
+
+    memset(image + FLASH_ADDR_GAME_ACTIONS, 0xFF, GAME_IMAGE_LEN);
+    memcpy(image + FLASH_ADDR_GAME_ACTIONS, actions,
+           actions_len * sizeof(game_action_t));
+    memcpy(image + FLASH_ADDR_GAME_STATES, states, sizeof(states));
+    // No choice tables.
+    memset(image + FLASH_ADDR_GAME_CHOICES, 0,
+           ALL_ACTIONS_LEN * sizeof(game_choice_set_t));
+    flash_cache_invalidate_all();
+
+    game_init();
+    memset(closed_states, 0, CLOSED_STATES_LEN);
+    close_state(STATE_CLOSED);
+}
+
+/// The old game_process_timers(), minus the firing: which series it starts.
+uint16_t reference_timer() {
+    for (uint8_t i=0; i<current_state->timer_series_len; i++) {
+        if (!game_curr_state_elapsed)
+            continue;
+        if ((game_curr_state_elapsed == current_state->timer_series[i].duration) ||
+                (current_state->timer_series[i].recurring &&
+                        ((game_curr_state_elapsed % current_state->timer_series[i].duration) == 0))) {
+            // start_action_series() returns 0 for these:
+            uint16_t result = current_state->timer_series[i].result_action_id;
+            if (result != ACTION_NONE && !leads_to_closed_state(result))
+                return result;
+        }
+    }
+    return ACTION_NONE;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t trials = argc > 1 ? strtoul(argv[1], 0, 0) : 2000;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], 0, 0) : 1;
+    uint64_t evaluations = 0;
+    uint64_t fired = 0;
+    uint32_t mismatches = 0;
+    uint16_t expected, got;
+    uint32_t now;
+
+    s25fs_init_io();
+    s25fs_init();
+    flash_cache_init();
+    lcd_model_reset();
+    lcd111_init();
+    srand(seed);
+
+    for (uint32_t trial=0; trial<trials; trial++) {
+        rng_state = seed * 2654435761u + trial + 1;
+        make_trial();
+        game_set_state(0, 1);
+
+        for (uint32_t t=0; t<TRIAL_TICKS; t++) {
+            // game_clock_tick():
+            if (in_action_series) {
+                game_curr_action_elapsed++;
+                game_action_sequence_tick();
+            }
+            if (!in_action_series)
+                game_curr_state_elapsed++;
+            // Stand in for specials and buttons:
+            if (!in_action_series && !rng(6))
+                start_action_series(interrupt_series);
+            if (in_action_series)
+                continue;
+
+            evaluations++;
+            now = game_curr_state_elapsed;
+            expected = reference_timer();
+            game_process_timers();
+            got = in_action_series ? loaded_action.duration - TAG_BASE
+                                   : ACTION_NONE;
+            if (got != ACTION_NONE)
+                fired++;
+            if (got != expected) {
+                if (mismatches++ < 10)
+                    printf("trial %lu, time loop %lu: state %u at %lu "
+                           "started series %u, wanted %u\n",
+                           (unsigned long) trial, (unsigned long) t,
+                           game_curr_state_id, (unsigned long) now, got,
+                           expected);
+            }
+        }
+        events_clear();
+    }
+
+    printf("%lu trials, %llu timer checks, %llu timers fired, "
+           "%lu mismatches\n", (unsigned long) trials,
+           (unsigned long long) evaluations, (unsigned long long) fired,
+           (unsigned long) mismatches);
+    return mismatches ? 1 : 0;
+}
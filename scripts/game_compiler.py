@@ -0,0 +1,800 @@
+"""
+Compiler for the badge game content.
+
+This turns the CSV exports of the game spreadsheets into the binary tables
+the badge reads out of its SPI flash (see game_layout.py), and regenerates
+``ccs_workspace/qc15_main/state_definitions.h`` to match. It can also go the
+other way, exporting an existing image back into CSVs, which is the easiest
+way to get a starting point for editing.
+
+Usage:
+    python game_compiler.py build content/ -o game.bin \\
+        --header ../ccs_workspace/qc15_main/state_definitions.h
+    python game_compiler.py build content/ --flash-image flash.bin
+    python game_compiler.py export game.bin --defs state_definitions.h -o content/
+
+``game.bin`` starts at FLASH_ADDR_GAME_ACTIONS (0x300000). ``--flash-image``
+patches the tables into a full flash dump instead, such as the one the host
+S25FS emulator uses.
+
+Input
+=====
+
+Every file has a header row naming its columns. Blank rows are ignored.
+Names are not case sensitive. Anywhere an action, state or text slot is
+referenced, ``#<n>`` refers to it by its number instead of its name. A blank
+reference means none (GAME_NULL).
+
+enums.csv (required): ``kind,name``
+    kind is ``anim``, ``special`` or ``other``. The order of the rows of each
+    kind gives their values: anims index all_animations, specials are the
+    SPECIAL_* events, others are the OTHER_ACTION_* custom actions.
+
+states.csv (required): ``name,entry``
+    One row per state, in STATE_ID_* order. ``entry`` is the action series
+    that runs on entering the state.
+
+actions.csv (required): ``label,type,detail,duration,next,next_choice,share,total``
+    One row per action, in ID order. ``label`` is optional, and only needed
+    for actions that something refers to by name. ``type`` is a
+    GAME_ACTION_TYPE_* name without the prefix (e.g. TEXT), or a number.
+    What ``detail`` means depends on the type: an anim name for ANIM_TEMP and
+    SET_ANIM_BG (blank to go back to the background/none), a state name for
+    STATE_TRANSITION, the text itself for TEXT*, an ``other`` enum name for
+    OTHER, and a plain number otherwise. ``share`` defaults to 1, and
+    ``total`` defaults to the sum of the shares in the choice set.
+
+text.csv (optional): ``id,text``
+    Text slots at fixed IDs. Any other text used in actions.csv or
+    inputs.csv is added after these, sharing slots for identical strings.
+
+timers.csv (optional): ``state,duration,recurring,result``
+    ``duration`` is in 1/32 second clock ticks. Each state's timers must be
+    listed non-recurring first, then recurring from the longest interval to
+    the shortest, which decides which timer fires when several come due at
+    once.
+
+inputs.csv (optional): ``state,text,result``
+    Menu choices, in the order the up/down buttons cycle through them.
+
+others.csv (optional): ``state,special,result``
+    Special events the state responds to.
+
+Validation
+==========
+
+Nothing is written unless the content is valid. All of the problems found
+are reported, with the file and line they came from: unknown or out of range
+references, duplicate names, text that doesn't fit in a 24-character slot
+(after printf expansion, for the TEXT_* types that format in a name or
+count), timers out of order, too many timers/inputs/others for a state,
+choice sets whose ``total`` doesn't match their shares, and tables that
+don't fit in their flash block.
+
+Content that compiles is then run through the checks in game_lint.py, which
+follow the action series the way the badge will: unreachable states, series
+that loop forever, menus that can hang once their states are closed, and the
+like. Lint errors stop the build too; warnings are printed, and the content
+is written anyway.
+
+The compiler also builds a table for each choice set, which the badge uses
+to make a choice with one flash read instead of walking the set. Before
+anything is written, every table is checked against the walk, on both sides
+of every boundary between choices, so that each value rand() % choice_total
+can take picks the same action either way.
+
+Incremental builds
+==================
+
+The build keeps a cache file (``<output>.cache`` by default) with hashes of
+its inputs and outputs. If nothing has changed, it stops there. Otherwise it
+rebuilds, but only rewrites outputs whose contents actually changed, so an
+unchanged header doesn't trigger a firmware rebuild, and it reports which of
+the four flash blocks changed, so only those need reflashing.
+"""
+
+from __future__ import print_function
+
+import argparse
+import csv
+import hashlib
+import io
+import json
+import os
+import re
+import sys
+import time
+
+import game_layout as gl
+import game_lint
+
+COMPILER_VERSION = 4
+
+INPUT_FILES = ('enums.csv', 'states.csv', 'actions.csv', 'text.csv',
+               'timers.csv', 'inputs.csv', 'others.csv')
+REQUIRED_FILES = ('enums.csv', 'states.csv', 'actions.csv')
+
+ENUM_KINDS = ('anim', 'special', 'other')
+
+# qc15.h: QC15_BADGE_NAME_LEN and QC15_PERSON_NAME_LEN, less the terminator.
+NAME_MAX = 10
+# badges_nearby is a uint8_t.
+COUNT_MAX_DIGITS = 3
+
+# What each TEXT_* type sprintf's into its text, and how long it can be.
+TEXT_FORMATS = {
+    gl.ACTION_TYPES['TEXT_BADGENAME']: ('s', NAME_MAX),
+    gl.ACTION_TYPES['TEXT_USER_NAME']: ('s', NAME_MAX),
+    gl.ACTION_TYPES['TEXT_CNCTDNAME']: ('s', NAME_MAX),
+    gl.ACTION_TYPES['TEXT_CNT']: ('diu', COUNT_MAX_DIGITS),
+}
+
+CONVERSION = re.compile(r'%(?:%|[-+ #0]*\d*(?:\.\d+)?[hlL]*([a-zA-Z]))')
+IDENTIFIER = re.compile(r'^[A-Za-z_][A-Za-z0-9_]*$')
+
+TRUE_WORDS = ('1', 'y', 'yes', 'true', 'x')
+FALSE_WORDS = ('', '0', 'n', 'no', 'false')
+
+
+def read_csv(path):
+    """Yield (line number, {column: value}) for the non-blank rows of a CSV."""
+    if sys.version_info[0] < 3:
+        f = open(path, 'rb')
+        decode = lambda cell: cell.decode('utf-8')
+    else:
+        f = io.open(path, newline='', encoding='utf-8')
+        decode = lambda cell: cell
+    with f:
+        reader = csv.reader(f)
+        header = None
+        for row in reader:
+            row = [decode(cell) for cell in row]
+            if not any(cell.strip() for cell in row):
+                continue
+            if header is None:
+                header = [c.strip().lstrip(u'\ufeff').lower() for c in row]
+                continue
+            row += [u''] * (len(header) - len(row))
+            yield reader.line_num, dict(zip(header, row))
+
+
+def write_csv(path, header, rows):
+    if sys.version_info[0] < 3:
+        f = open(path, 'wb')
+        encode = lambda cell: (u'%s' % cell).encode('utf-8')
+    else:
+        f = io.open(path, 'w', newline='', encoding='utf-8')
+        encode = lambda cell: u'%s' % cell
+    with f:
+        writer = csv.writer(f, lineterminator='\n')
+        writer.writerow(header)
+        for row in rows:
+            writer.writerow([encode(cell) for cell in row])
+
+
+def file_hash(path):
+    h = hashlib.sha1()
+    with open(path, 'rb') as f:
+        h.update(f.read())
+    return h.hexdigest()
+
+
+def write_if_changed(path, data):
+    """Write `data` to `path` unless it's already there. True if written."""
+    try:
+        with open(path, 'rb') as f:
+            if f.read() == data:
+                return False
+    except IOError:
+        pass
+    with open(path, 'wb') as f:
+        f.write(data)
+    return True
+
+
+class Compiler(object):
+    def __init__(self, csv_dir):
+        self.csv_dir = csv_dir
+        self.errors = []
+
+        self.anims = []
+        self.specials = []
+        self.others = []
+        self.enum_ids = dict((kind, {}) for kind in ENUM_KINDS)
+
+        self.state_names = []
+        self.state_ids = {}
+        self.states = []
+
+        self.texts = []
+        self.text_ids = {}
+        self.text_checked = set()
+
+        self.actions = []
+        self.action_ids = {}
+
+    def error(self, where, message):
+        self.errors.append('%s: %s' % (where, message))
+
+    def rows(self, name):
+        path = os.path.join(self.csv_dir, name)
+        if not os.path.exists(path):
+            if name in REQUIRED_FILES:
+                self.error(name, 'missing')
+            return []
+        return [('%s:%d' % (name, line), row) for line, row in read_csv(path)]
+
+    ## Parsing helpers ########################################################
+
+    def number(self, where, value, what, default=0, limit=0xFFFF):
+        value = value.strip()
+        if not value:
+            return default
+        try:
+            n = int(value, 0)
+        except ValueError:
+            self.error(where, '%s %r is not a number' % (what, value))
+            return default
+        if n < 0 or n > limit:
+            self.error(where, '%s %d is out of range (0-%d)' % (what, n, limit))
+            return default
+        return n
+
+    def ref(self, where, value, ids, count, what):
+        """Resolve a name or #number reference against `ids` (lower case)."""
+        value = value.strip()
+        if not value:
+            return gl.GAME_NULL
+        if value.startswith('#'):
+            n = self.number(where, value[1:], what, gl.GAME_NULL)
+            if n != gl.GAME_NULL and n >= count:
+                self.error(where, '%s #%d does not exist (there are %d)'
+                           % (what, n, count))
+                return gl.GAME_NULL
+            return n
+        try:
+            return ids[value.lower()]
+        except KeyError:
+            self.error(where, 'unknown %s %r' % (what, value))
+            return gl.GAME_NULL
+
+    def action_ref(self, where, value):
+        return self.ref(where, value, self.action_ids, len(self.actions),
+                        'action')
+
+    def state_ref(self, where, value):
+        return self.ref(where, value, self.state_ids, len(self.state_names),
+                        'state')
+
+    def text_ref(self, where, value, action_type=gl.ACTION_TYPES['TEXT']):
+        """Return the slot ID for some text, adding it if it's new."""
+        if re.match(r'^#\d+$', value.strip()):
+            text_id = self.ref(where, value, {}, len(self.texts), 'text')
+        elif value in self.text_ids:
+            text_id = self.text_ids[value]
+        else:
+            text_id = len(self.texts)
+            self.texts.append(value)
+            self.text_ids[value] = text_id
+        if text_id != gl.GAME_NULL and (text_id, action_type) not in self.text_checked:
+            self.text_checked.add((text_id, action_type))
+            self.check_text(where, self.texts[text_id], action_type)
+        return text_id
+
+    def check_text(self, where, text, action_type):
+        try:
+            text.encode('latin-1')
+        except UnicodeError:
+            self.error(where, 'text %r has characters the LCD can\'t show'
+                       % text)
+            return
+        length = len(text)
+        conversions = [m.group(1) for m in CONVERSION.finditer(text)
+                       if m.group(1)]
+        if action_type in TEXT_FORMATS:
+            # This is a format string: the printf'd result is what has to
+            #  fit, in current_text.
+            allowed, arg_len = TEXT_FORMATS[action_type]
+            if len(conversions) != 1 or conversions[0] not in allowed:
+                self.error(where, 'text %r needs exactly one %%%s for %s'
+                           % (text, allowed[0],
+                              gl.ACTION_TYPE_NAMES[action_type]))
+                return
+            length = len(text.replace('%%', '%')) - 2 + arg_len
+        if length > gl.TEXT_LEN:
+            self.error(where, 'text %r is %d characters long; the most that '
+                       'fits is %d' % (text, length, gl.TEXT_LEN))
+
+    ## Tables #################################################################
+
+    def parse_enums(self):
+        tables = {'anim': self.anims, 'special': self.specials,
+                  'other': self.others}
+        for where, row in self.rows('enums.csv'):
+            kind = row.get('kind', '').strip().lower()
+            name = row.get('name', '').strip()
+            if kind not in tables:
+                self.error(where, 'kind must be one of %s, not %r'
+                           % (', '.join(ENUM_KINDS), kind))
+                continue
+            if not IDENTIFIER.match(name):
+                self.error(where, '%s name %r is not a valid identifier'
+                           % (kind, name))
+                continue
+            if name.lower() in self.enum_ids[kind]:
+                self.error(where, 'duplicate %s %r' % (kind, name))
+                continue
+            self.enum_ids[kind][name.lower()] = len(tables[kind])
+            tables[kind].append(name)
+
+    def parse_states(self):
+        rows = self.rows('states.csv')
+        for where, row in rows:
+            name = row.get('name', '').strip()
+            if not IDENTIFIER.match(name):
+                self.error(where, 'state name %r is not a valid identifier'
+                           % name)
+            elif name.lower() in self.state_ids:
+                self.error(where, 'duplicate state %r' % name)
+            else:
+                self.state_ids[name.lower()] = len(self.state_names)
+            self.state_names.append(name)
+        if len(self.state_names) > gl.MAX_STATES:
+            self.error('states.csv', '%d states don\'t fit in the flash '
+                       '(the most is %d)' % (len(self.state_names),
+                                             gl.MAX_STATES))
+        return rows
+
+    def parse_text(self):
+        for where, row in self.rows('text.csv'):
+            text_id = self.number(where, row.get('id', ''), 'text id',
+                                  None, gl.MAX_TEXT - 1)
+            if text_id is None:
+                continue
+            while len(self.texts) <= text_id:
+                self.texts.append(None)
+            if self.texts[text_id] is not None:
+                self.error(where, 'duplicate text id %d' % text_id)
+                continue
+            text = row.get('text', '')
+            self.texts[text_id] = text
+            self.text_ids.setdefault(text, text_id)
+        # Unused slots are left blank.
+        self.texts = [t if t is not None else u'' for t in self.texts]
+
+    def parse_actions(self):
+        rows = self.rows('actions.csv')
+        # Labels first, since actions can refer forward.
+        for action_id, (where, row) in enumerate(rows):
+            label = row.get('label', '').strip()
+            if not label:
+                continue
+            if label.lower() in self.action_ids:
+                self.error(where, 'duplicate action label %r' % label)
+            self.action_ids[label.lower()] = action_id
+        self.actions = [None] * len(rows)
+        if len(rows) > gl.MAX_ACTIONS:
+            self.error('actions.csv', '%d actions don\'t fit in the flash '
+                       '(the most is %d)' % (len(rows), gl.MAX_ACTIONS))
+
+        self.given_totals = [None] * len(rows)
+        for action_id, (where, row) in enumerate(rows):
+            type_name = row.get('type', '').strip()
+            if type_name.upper() in gl.ACTION_TYPES:
+                action_type = gl.ACTION_TYPES[type_name.upper()]
+            else:
+                action_type = self.number(where, type_name, 'action type')
+            detail = self.detail(where, action_type, row.get('detail', ''))
+            total = row.get('total', '').strip()
+            if total:
+                self.given_totals[action_id] = self.number(
+                    where, total, 'choice total')
+            self.actions[action_id] = gl.Action(
+                action_type, detail,
+                self.number(where, row.get('duration', ''), 'duration'),
+                self.action_ref(where, row.get('next', '')),
+                self.action_ref(where, row.get('next_choice', '')),
+                self.number(where, row.get('share', ''), 'choice share', 1),
+                0)
+        self.action_rows = [where for where, row in rows]
+
+    def detail(self, where, action_type, value):
+        if action_type in gl.ANIM_TYPES:
+            return self.ref(where, value, self.enum_ids['anim'],
+                            len(self.anims), 'anim')
+        if action_type == gl.ACTION_TYPES['STATE_TRANSITION']:
+            state_id = self.state_ref(where, value)
+            if state_id == gl.GAME_NULL:
+                self.error(where, 'state transition needs a target state')
+            return state_id
+        if action_type in gl.TEXT_TYPES:
+            return self.text_ref(where, value, action_type)
+        if action_type == gl.ACTION_TYPES['OTHER']:
+            return self.ref(where, value, self.enum_ids['other'],
+                            len(self.others), 'other action')
+        return self.number(where, value, 'detail')
+
+    def resolve_choices(self):
+        """Fill in and check choice_total for every choice set."""
+        refs = [0] * len(self.actions)
+        for action_id, action in enumerate(self.actions):
+            nxt = action.next_choice_id
+            if nxt == gl.GAME_NULL:
+                continue
+            refs[nxt] += 1
+            if refs[nxt] == 2:
+                self.error(self.action_rows[nxt], 'action is the next choice '
+                           'of more than one action, so it\'s in more than '
+                           'one choice set')
+        seen = [False] * len(self.actions)
+        self.choice_heads = []
+        for head in range(len(self.actions)):
+            if refs[head]:
+                continue
+            self.choice_heads.append(head)
+            members = []
+            action_id = head
+            while action_id != gl.GAME_NULL and not seen[action_id]:
+                seen[action_id] = True
+                members.append(action_id)
+                action_id = self.actions[action_id].next_choice_id
+            self.set_total(members)
+        for action_id in range(len(self.actions)):
+            if not seen[action_id]:
+                self.error(self.action_rows[action_id], 'next_choice loops '
+                           'back around without ever ending')
+
+    def set_total(self, members):
+        total = sum(self.actions[i].choice_share for i in members)
+        if len(members) > 1 and not total:
+            self.error(self.action_rows[members[0]], 'choice set has no '
+                       'shares, so no choice can be made')
+        for i in members:
+            given = self.given_totals[i]
+            if given is not None and given != total:
+                self.error(self.action_rows[i], 'choice total is %d, but the '
+                           'shares in its choice set add up to %d'
+                           % (given, total))
+            self.actions[i] = self.actions[i]._replace(choice_total=total)
+
+    def parse_state_lists(self, state_rows):
+        timers = [[] for _ in self.state_names]
+        inputs = [[] for _ in self.state_names]
+        others = [[] for _ in self.state_names]
+        timer_rows = [[] for _ in self.state_names]
+
+        for where, row in self.rows('timers.csv'):
+            state_id = self.state_ref(where, row.get('state', ''))
+            recurring = row.get('recurring', '').strip().lower()
+            if recurring not in TRUE_WORDS + FALSE_WORDS:
+                self.error(where, 'recurring should be yes or no, not %r'
+                           % recurring)
+            duration = self.number(where, row.get('duration', ''),
+                                   'timer duration', 0, 0xFFFFFFFF)
+            if not duration:
+                self.error(where, 'timers need a nonzero duration')
+            timer = gl.Timer(duration, int(recurring in TRUE_WORDS),
+                             self.action_ref(where, row.get('result', '')))
+            if state_id != gl.GAME_NULL:
+                timers[state_id].append(timer)
+                timer_rows[state_id].append(where)
+
+        for where, row in self.rows('inputs.csv'):
+            state_id = self.state_ref(where, row.get('state', ''))
+            item = gl.Input(self.text_ref(where, row.get('text', '')),
+                            self.action_ref(where, row.get('result', '')))
+            if state_id != gl.GAME_NULL:
+                inputs[state_id].append(item)
+
+        for where, row in self.rows('others.csv'):
+            state_id = self.state_ref(where, row.get('state', ''))
+            item = gl.Other(self.ref(where, row.get('special', ''),
+                                     self.enum_ids['special'],
+                                     len(self.specials), 'special'),
+                            self.action_ref(where, row.get('result', '')))
+            if state_id != gl.GAME_NULL:
+                others[state_id].append(item)
+
+        for state_id, (where, row) in enumerate(state_rows):
+            name = self.state_names[state_id]
+            for items, limit, what in ((timers[state_id], gl.MAX_TIMERS, 'timers'),
+                                       (inputs[state_id], gl.MAX_INPUTS, 'inputs'),
+                                       (others[state_id], gl.MAX_OTHERS, 'specials')):
+                if len(items) > limit:
+                    self.error(where, 'state %s has %d %s; the most it can '
+                               'have is %d' % (name, len(items), what, limit))
+                    del items[limit:]
+            self.check_timer_order(timers[state_id], timer_rows[state_id])
+            self.states.append(gl.State(
+                self.action_ref(where, row.get('entry', '')),
+                timers[state_id], inputs[state_id], others[state_id]))
+
+    def check_timer_order(self, timers, rows):
+        last = None
+        for timer, where in zip(timers, rows):
+            if last and last.recurring and not timer.recurring:
+                self.error(where, 'non-recurring timer comes after a '
+                           'recurring one')
+            elif (last and last.recurring and timer.recurring and
+                    timer.duration > last.duration):
+                self.error(where, 'recurring timer of %d ticks comes after a '
+                           'shorter one (%d); they must go from longest to '
+                           'shortest' % (timer.duration, last.duration))
+            last = timer
+
+    def compile(self):
+        self.parse_enums()
+        state_rows = self.parse_states()
+        self.parse_text()
+        self.parse_actions()
+        self.resolve_choices()
+        self.parse_state_lists(state_rows)
+        if len(self.texts) > gl.MAX_TEXT:
+            self.error('text', '%d text slots don\'t fit in the flash '
+                       '(the most is %d)' % (len(self.texts), gl.MAX_TEXT))
+        if self.errors:
+            return False
+        self.choices = gl.pack_choices(self.actions, self.choice_heads)
+        if len(self.choices) > gl.REGION_SIZE:
+            self.error('actions.csv', 'choice tables don\'t fit in the flash '
+                       '(%d bytes)' % len(self.choices))
+        self.verify_choices()
+        return not self.errors
+
+    def verify_choices(self):
+        """Make sure the choice tables pick exactly what the walk would."""
+        for head in self.choice_heads:
+            if self.actions[head].next_choice_id == gl.GAME_NULL:
+                continue
+            wrong = gl.check_choice_table(self.actions, self.choices, head)
+            if wrong:
+                self.error(self.action_rows[head], 'choice table picks '
+                           'action %d for %d, but the walk picks %d'
+                           % (wrong[1], wrong[0], wrong[2]))
+
+    def content(self):
+        """The compiled tables, for game_lint.py."""
+        return game_lint.Content(self.actions, len(self.texts), self.states,
+                                 len(self.anims), len(self.specials),
+                                 len(self.others), self.choices,
+                                 self.state_names, self.action_rows)
+
+    ## Output #################################################################
+
+    def image(self):
+        image = bytearray(b'\xff' * gl.IMAGE_SIZE)
+        for addr, data in self.regions():
+            start = addr - gl.IMAGE_BASE
+            image[start:start + len(data)] = data
+        return bytes(image)
+
+    def regions(self):
+        return (
+            (gl.FLASH_ADDR_GAME_ACTIONS,
+             b''.join(gl.pack_action(a) for a in self.actions)),
+            (gl.FLASH_ADDR_GAME_TEXT,
+             b''.join(gl.pack_text(t) for t in self.texts)),
+            (gl.FLASH_ADDR_GAME_STATES,
+             b''.join(gl.pack_state(s) for s in self.states)),
+            (gl.FLASH_ADDR_GAME_CHOICES, self.choices),
+        )
+
+    def header(self):
+        lines = [
+            '#define ALL_ACTIONS_LEN %d' % len(self.actions),
+            '#define ALL_TEXT_LEN %d' % len(self.texts),
+            '#define all_states_len %d' % len(self.states),
+            '#define MAX_TIMERS %d' % gl.MAX_TIMERS,
+            '#define MAX_INPUTS %d' % gl.MAX_INPUTS,
+            '#define MAX_OTHERS %d' % gl.MAX_OTHERS,
+            '#define GAME_ANIMS_LEN %d' % len(self.anims),
+            '',
+            '// ' + ', '.join(self.anims),
+        ]
+        for prefix, names in (('SPECIAL_', self.specials),
+                              ('STATE_ID_', self.state_names),
+                              ('OTHER_ACTION_', self.others)):
+            for value, name in enumerate(names):
+                lines.append('#define %s%s %d' % (prefix, name.upper(), value))
+        # The firmware sources all use CRLF.
+        return ('\r\n'.join(lines) + '\r\n').encode('ascii')
+
+
+def changed_regions(old, new):
+    names = ('actions', 'text', 'states', 'choices')
+    addrs = (gl.FLASH_ADDR_GAME_ACTIONS, gl.FLASH_ADDR_GAME_TEXT,
+             gl.FLASH_ADDR_GAME_STATES, gl.FLASH_ADDR_GAME_CHOICES)
+    return [name for name, addr in zip(names, addrs)
+            if old is None or gl.region(old, addr) != gl.region(new, addr)]
+
+
+def build(args):
+    start = time.time()
+    outputs = [p for p in (args.output, args.header, args.flash_image) if p]
+    if not outputs:
+        print('Nothing to build: give -o, --header and/or --flash-image.',
+              file=sys.stderr)
+        return 2
+
+    cache_path = args.cache or (outputs[0] + '.cache')
+    inputs = {}
+    for name in INPUT_FILES:
+        path = os.path.join(args.csv_dir, name)
+        if os.path.exists(path):
+            inputs[name] = file_hash(path)
+    key = {'version': COMPILER_VERSION, 'inputs': inputs,
+           'outputs': sorted(outputs)}
+
+    try:
+        with open(cache_path) as f:
+            cache = json.load(f)
+    except (IOError, ValueError):
+        cache = {}
+    if not args.force and cache.get('key') == key and all(
+            os.path.exists(p) and file_hash(p) == cache['outputs'].get(p)
+            for p in outputs):
+        print('Game content is up to date (%.3fs).' % (time.time() - start))
+        return 0
+
+    compiler = Compiler(args.csv_dir)
+    if not compiler.compile():
+        for message in compiler.errors:
+            print(message, file=sys.stderr)
+        print('%d error(s); nothing written.' % len(compiler.errors),
+              file=sys.stderr)
+        return 1
+
+    problems = game_lint.lint(compiler.content())
+    game_lint.print_problems(problems)
+    errors = game_lint.count(problems, game_lint.ERROR)
+    if errors:
+        print('%d lint error(s); nothing written.' % errors, file=sys.stderr)
+        return 1
+
+    image = compiler.image()
+    if args.output:
+        old = None
+        if os.path.exists(args.output):
+            old = gl.read_image(args.output)
+        if write_if_changed(args.output, image):
+            print('%s: changed %s' % (args.output,
+                                      ', '.join(changed_regions(old, image))))
+    if args.flash_image:
+        old = None
+        if os.path.exists(args.flash_image):
+            old = gl.read_image(args.flash_image, True)
+            mode = 'r+b'
+        else:
+            mode = 'w+b'
+        changed = changed_regions(old, image)
+        if changed:
+            with open(args.flash_image, mode) as f:
+                f.seek(gl.IMAGE_BASE)
+                f.write(image)
+            print('%s: changed %s' % (args.flash_image, ', '.join(changed)))
+    if args.header:
+        if write_if_changed(args.header, compiler.header()):
+            print('%s: regenerated' % args.header)
+
+    with open(cache_path, 'w') as f:
+        json.dump({'key': key,
+                   'outputs': dict((p, file_hash(p)) for p in outputs)},
+                  f, indent=1, sort_keys=True)
+
+    print('%d actions, %d text, %d states (%.3fs).'
+          % (len(compiler.actions), len(compiler.texts), len(compiler.states),
+             time.time() - start))
+    return 0
+
+
+def export(args):
+    """Dump an existing image out to CSVs that compile back to the same thing."""
+    defs = gl.read_definitions(args.defs)
+    image = gl.read_image(args.image, args.flash_image)
+    actions_buf = gl.region(image, gl.FLASH_ADDR_GAME_ACTIONS)
+    text_buf = gl.region(image, gl.FLASH_ADDR_GAME_TEXT)
+    states_buf = gl.region(image, gl.FLASH_ADDR_GAME_STATES)
+    n_actions = defs.counts['ALL_ACTIONS_LEN']
+    n_text = defs.counts['ALL_TEXT_LEN']
+    n_states = defs.counts['all_states_len']
+    states = defs.states + ['STATE%d' % i
+                            for i in range(len(defs.states), n_states)]
+
+    def ref(n):
+        return '' if n == gl.GAME_NULL else '#%d' % n
+
+    def name(table, n):
+        if n == gl.GAME_NULL:
+            return ''
+        return table[n] if n < len(table) and table[n] else '#%d' % n
+
+    if not os.path.isdir(args.output):
+        os.makedirs(args.output)
+    out = lambda f: os.path.join(args.output, f)
+
+    write_csv(out('enums.csv'), ('kind', 'name'),
+              [('anim', a) for a in defs.anims] +
+              [('special', s) for s in defs.specials] +
+              [('other', o) for o in defs.others])
+    write_csv(out('text.csv'), ('id', 'text'),
+              [(i, gl.unpack_text(text_buf, i * gl.TEXT_SLOT))
+               for i in range(n_text)])
+
+    rows = []
+    for i in range(n_actions):
+        a = gl.unpack_action(actions_buf, i * gl.ACTION.size)
+        if a.type in gl.ANIM_TYPES:
+            detail = name(defs.anims, a.detail)
+        elif a.type == gl.ACTION_TYPES['STATE_TRANSITION']:
+            detail = name(states, a.detail)
+        elif a.type in gl.TEXT_TYPES:
+            detail = ref(a.detail)
+        elif a.type == gl.ACTION_TYPES['OTHER']:
+            detail = name(defs.others, a.detail)
+        else:
+            detail = a.detail
+        rows.append(('', gl.ACTION_TYPE_NAMES.get(a.type, a.type), detail,
+                     a.duration, ref(a.next_action_id),
+                     ref(a.next_choice_id), a.choice_share, a.choice_total))
+    write_csv(out('actions.csv'), ('label', 'type', 'detail', 'duration',
+                                   'next', 'next_choice', 'share', 'total'),
+              rows)
+
+    state_rows, timers, inputs, others = [], [], [], []
+    for i in range(n_states):
+        s = gl.unpack_state(states_buf, i * gl.STATE_SIZE)
+        state_rows.append((states[i], ref(s.entry_series_id)))
+        for t in s.timers:
+            timers.append((states[i], t.duration,
+                           'yes' if t.recurring else 'no',
+                           ref(t.result_action_id)))
+        for u in s.inputs:
+            inputs.append((states[i], ref(u.text_addr),
+                           ref(u.result_action_id)))
+        for o in s.others:
+            others.append((states[i], name(defs.specials, o.type_id),
+                           ref(o.result_action_id)))
+    write_csv(out('states.csv'), ('name', 'entry'), state_rows)
+    write_csv(out('timers.csv'), ('state', 'duration', 'recurring', 'result'),
+              timers)
+    write_csv(out('inputs.csv'), ('state', 'text', 'result'), inputs)
+    write_csv(out('others.csv'), ('state', 'special', 'result'), others)
+    print('Exported %d actions, %d text, %d states to %s.'
+          % (n_actions, n_text, n_states, args.output))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compile the game content CSVs into a flash image.')
+    sub = parser.add_subparsers(dest='command')
+
+    p = sub.add_parser('build', help='compile CSVs into an image')
+    p.add_argument('csv_dir', help='directory of CSV exports')
+    p.add_argument('-o', '--output', help='game image to write')
+    p.add_argument('--header', help='state_definitions.h to regenerate')
+    p.add_argument('--flash-image',
+                   help='full flash image to patch the tables into')
+    p.add_argument('--cache', help='incremental build cache file')
+    p.add_argument('--force', action='store_true',
+                   help='rebuild even if nothing changed')
+
+    p = sub.add_parser('export', help='dump an image back out to CSVs')
+    p.add_argument('image', help='game image (or flash image with --flash)')
+    p.add_argument('--defs', required=True,
+                   help='the state_definitions.h the image was built with')
+    p.add_argument('--flash', dest='flash_image', action='store_true',
+                   help='the image is a whole flash dump')
+    p.add_argument('-o', '--output', required=True, help='CSV directory')
+
+    args = parser.parse_args()
+    if args.command == 'build':
+        return build(args)
+    if args.command == 'export':
+        return export(args)
+    parser.print_help()
+    return 2
+
+
+if __name__ == '__main__':
+    sys.exit(main())
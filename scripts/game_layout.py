@@ -0,0 +1,270 @@
+"""
+Binary layout of the game content in the SPI flash.
+
+This mirrors the structs in ``ccs_workspace/qc15_main/game.h`` and the
+addresses in ``flash_layout.h``, as the MSP430 compiler lays them out: little
+endian, and nothing aligned past 2 bytes. The content tools (the compiler and
+the linter) share it, so if either of those headers changes, this is the one
+place to update.
+
+    0x300000  actions  game_action_t[ALL_ACTIONS_LEN], 14 bytes each
+    0x310000  text     25-byte slots: up to 24 characters, NUL padded
+    0x320000  states   game_state_t[all_states_len], 86 bytes each
+    0x330000  choices  game_choice_set_t[ALL_ACTIONS_LEN], 4 bytes each,
+                       then game_choice_t entries, 4 bytes each
+"""
+
+from __future__ import print_function
+
+import collections
+import re
+import struct
+
+FLASH_ADDR_GAME_ACTIONS = 0x300000
+FLASH_ADDR_GAME_TEXT = 0x310000
+FLASH_ADDR_GAME_STATES = 0x320000
+FLASH_ADDR_GAME_CHOICES = 0x330000
+# Each table gets one 64 KB flash block.
+REGION_SIZE = 0x10000
+# The game image starts at the actions and runs to the end of the choices.
+IMAGE_BASE = FLASH_ADDR_GAME_ACTIONS
+IMAGE_SIZE = FLASH_ADDR_GAME_CHOICES + REGION_SIZE - IMAGE_BASE
+
+GAME_NULL = 0xFFFF
+
+TEXT_SLOT = 25
+TEXT_LEN = 24
+
+MAX_TIMERS = 3
+MAX_INPUTS = 8
+MAX_OTHERS = 6
+# game.h: GAME_CHOICES_MAX
+CHOICES_MAX = 16
+
+# game.c: GAME_ACTION_TYPE_*
+ACTION_TYPES = collections.OrderedDict([
+    ('ANIM_TEMP', 0),
+    ('SET_ANIM_BG', 1),
+    ('STATE_TRANSITION', 2),
+    ('PUSH', 3),
+    ('POP', 4),
+    ('PREVIOUS', 5),
+    ('CLOSE', 6),
+    ('NOP', 7),
+    ('TEXT', 16),
+    ('TEXT_BADGENAME', 17),
+    ('TEXT_USER_NAME', 18),
+    ('TEXT_CNT', 19),
+    ('TEXT_CNCTDNAME', 20),
+    ('OTHER', 100),
+])
+ACTION_TYPE_NAMES = dict((v, k) for k, v in ACTION_TYPES.items())
+
+ANIM_TYPES = (ACTION_TYPES['ANIM_TEMP'], ACTION_TYPES['SET_ANIM_BG'])
+TEXT_TYPES = (ACTION_TYPES['TEXT'], ACTION_TYPES['TEXT_BADGENAME'],
+              ACTION_TYPES['TEXT_USER_NAME'], ACTION_TYPES['TEXT_CNT'],
+              ACTION_TYPES['TEXT_CNCTDNAME'])
+
+ACTION = struct.Struct('<7H')
+TIMER = struct.Struct('<IBxH')
+INPUT = struct.Struct('<HH')
+OTHER = struct.Struct('<HH')
+STATE_HEAD = struct.Struct('<HBBBx')
+CHOICE_SET = struct.Struct('<HH')
+CHOICE = struct.Struct('<HH')
+STATE_SIZE = (STATE_HEAD.size + MAX_TIMERS * TIMER.size +
+              MAX_INPUTS * INPUT.size + MAX_OTHERS * OTHER.size)
+
+assert ACTION.size == 14
+assert STATE_SIZE == 86
+
+MAX_ACTIONS = REGION_SIZE // ACTION.size
+MAX_TEXT = REGION_SIZE // TEXT_SLOT
+MAX_STATES = REGION_SIZE // STATE_SIZE
+
+Action = collections.namedtuple(
+    'Action', 'type detail duration next_action_id next_choice_id '
+              'choice_share choice_total')
+Timer = collections.namedtuple('Timer', 'duration recurring result_action_id')
+Input = collections.namedtuple('Input', 'text_addr result_action_id')
+Other = collections.namedtuple('Other', 'type_id result_action_id')
+State = collections.namedtuple('State', 'entry_series_id timers inputs others')
+
+
+def pack_action(action):
+    return ACTION.pack(*action)
+
+
+def unpack_action(buf, offset=0):
+    return Action(*ACTION.unpack_from(buf, offset))
+
+
+def pack_text(text):
+    """Pack a string (or bytes) into one NUL-padded text slot."""
+    if not isinstance(text, bytes):
+        text = text.encode('latin-1')
+    return text[:TEXT_LEN].ljust(TEXT_SLOT, b'\x00')
+
+
+def unpack_text(buf, offset=0):
+    raw = bytes(buf[offset:offset + TEXT_LEN])
+    return raw.split(b'\x00', 1)[0].decode('latin-1')
+
+
+def pack_state(state):
+    """Pack a State; unused timer/input/other slots are zero filled."""
+    out = [STATE_HEAD.pack(state.entry_series_id, len(state.timers),
+                           len(state.inputs), len(state.others))]
+    for items, fmt, count in ((state.timers, TIMER, MAX_TIMERS),
+                              (state.inputs, INPUT, MAX_INPUTS),
+                              (state.others, OTHER, MAX_OTHERS)):
+        for item in items:
+            out.append(fmt.pack(*item))
+        out.append(b'\x00' * fmt.size * (count - len(items)))
+    return b''.join(out)
+
+
+def unpack_state(buf, offset=0):
+    entry, n_timers, n_inputs, n_others = STATE_HEAD.unpack_from(buf, offset)
+    offset += STATE_HEAD.size
+    lists = []
+    for fmt, cls, count, used in ((TIMER, Timer, MAX_TIMERS, n_timers),
+                                  (INPUT, Input, MAX_INPUTS, n_inputs),
+                                  (OTHER, Other, MAX_OTHERS, n_others)):
+        lists.append([cls(*fmt.unpack_from(buf, offset + i * fmt.size))
+                      for i in range(min(used, count))])
+        offset += count * fmt.size
+    return State(entry, *lists)
+
+
+def walk_choice(actions, head, value):
+    """Pick from a choice set the way select_action_choice() walks it."""
+    action_id = head
+    total = 0
+    while True:
+        action = actions[action_id]
+        total += action.choice_share
+        if action.next_choice_id == GAME_NULL or value < total:
+            return action_id
+        action_id = action.next_choice_id
+
+
+def choice_members(actions, head):
+    members = [head]
+    while actions[members[-1]].next_choice_id != GAME_NULL:
+        members.append(actions[members[-1]].next_choice_id)
+    return members
+
+
+def pack_choices(actions, heads):
+    """Build the choice tables region for the choice sets starting at `heads`.
+
+    Sets with one choice, or more than CHOICES_MAX, are left out; the badge
+    walks those.
+    """
+    directory = [(0, 0)] * len(actions)
+    entries = []
+    for head in heads:
+        members = choice_members(actions, head)
+        if len(members) < 2 or len(members) > CHOICES_MAX:
+            continue
+        directory[head] = (len(entries), len(members))
+        upper = 0
+        for action_id in members:
+            upper += actions[action_id].choice_share
+            entries.append((min(upper, 0xFFFF), action_id))
+        entries[-1] = (0xFFFF, members[-1])
+    return (b''.join(CHOICE_SET.pack(*d) for d in directory) +
+            b''.join(CHOICE.pack(*e) for e in entries))
+
+
+def table_choice(choices, action_count, head, value):
+    """Pick from a choice set using a choice tables region, like
+    choice_table_pick() does. Returns GAME_NULL if the set isn't in it."""
+    first, count = CHOICE_SET.unpack_from(choices, head * CHOICE_SET.size)
+    if not count or count > CHOICES_MAX:
+        return GAME_NULL
+    base = action_count * CHOICE_SET.size + first * CHOICE.size
+    for i in range(count - 1):
+        upper, action_id = CHOICE.unpack_from(choices, base + i * CHOICE.size)
+        if value < upper:
+            return action_id
+    return CHOICE.unpack_from(choices, base + (count - 1) * CHOICE.size)[1]
+
+
+def check_choice_table(actions, choices, head):
+    """Compare a choice set's table with the walk. Returns (value, table pick,
+    walk pick) for the first value they disagree on, or None if they agree
+    (or the set isn't in the table, so the badge walks it anyway)."""
+    # Both ways of choosing are step functions of the random value, so
+    #  checking either side of each step covers every value.
+    total = actions[head].choice_total
+    values = set([0, total - 1])
+    upper = 0
+    for member in choice_members(actions, head):
+        upper += actions[member].choice_share
+        values.update((upper - 1, upper))
+    for value in sorted(v for v in values if 0 <= v < total):
+        picked = table_choice(choices, len(actions), head, value)
+        if picked == GAME_NULL:
+            return None
+        walked = walk_choice(actions, head, value)
+        if picked != walked:
+            return value, picked, walked
+    return None
+
+
+class Definitions(object):
+    """The contents of a state_definitions.h."""
+
+    def __init__(self):
+        self.counts = collections.OrderedDict()
+        self.anims = []
+        self.specials = []
+        self.states = []
+        self.others = []
+
+
+_DEFINE = re.compile(r'^\s*#define\s+(\w+)\s+(\w+)')
+
+
+def read_definitions(path):
+    defs = Definitions()
+    prefixes = (('SPECIAL_', defs.specials), ('STATE_ID_', defs.states),
+                ('OTHER_ACTION_', defs.others))
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith('//') and not defs.anims:
+                # The animation names are listed in a comment, in
+                #  all_animations order.
+                defs.anims = [a.strip() for a in line[2:].split(',')
+                              if a.strip()]
+                continue
+            m = _DEFINE.match(line)
+            if not m:
+                continue
+            name, value = m.group(1), int(m.group(2), 0)
+            for prefix, table in prefixes:
+                if name.startswith(prefix):
+                    while len(table) <= value:
+                        table.append(None)
+                    table[value] = name[len(prefix):]
+                    break
+            else:
+                defs.counts[name] = value
+    return defs
+
+
+def read_image(path, flash_image=False):
+    """Read a game image, or the game image out of a whole flash dump."""
+    with open(path, 'rb') as f:
+        if flash_image:
+            f.seek(IMAGE_BASE)
+        data = f.read(IMAGE_SIZE)
+    return data.ljust(IMAGE_SIZE, b'\xff')
+
+
+def region(image, addr):
+    start = addr - IMAGE_BASE
+    return image[start:start + REGION_SIZE]
@@ -0,0 +1,568 @@
+"""
+Static checks for the badge game content.
+
+This loads the action, text and state tables out of a game image (laid out
+as in game_layout.py) along with the state_definitions.h that goes with it,
+follows the action series the way game.c does, and reports content that the
+badge would only show by misbehaving:
+
+* states that no chain of state transitions from state 0 reaches;
+* action series that can loop forever, through next_action_id or
+  next_choice_id (find_chain_end() in game.c never returns on the first);
+* menus whose every choice leads to a state that can be closed, which hang
+  next_input_id() once all of those states are closed; actions after a state
+  transition, which never run; and choice sets whose other choices lead to
+  closable states that the first choice doesn't, which leads_to_closed_state()
+  doesn't look at;
+* timers out of the non-recurring first, then longest interval first order,
+  which decides which timer fires when several come due at once, and timers
+  that never fire;
+* choice sets whose choice_total isn't the sum of their shares, actions in
+  more than one choice set, and choice tables that don't match their sets;
+* references and detail IDs that are out of range for their tables.
+
+Series that end in a transition to a closable state are listed with -v.
+That's normal (it's how a closed state's menu choice goes away), but they're
+the series whose behavior changes as the game goes on.
+
+Usage:
+    python game_lint.py game.bin --defs state_definitions.h
+    python game_lint.py flash.bin --flash --defs state_definitions.h
+
+Problems are errors (the badge will misbehave) or warnings (it might). The
+exit status is 1 if there were any errors, or any warnings with --strict.
+game_compiler.py runs the same checks on every build, and won't write an
+image with errors in it.
+"""
+
+from __future__ import print_function
+
+import argparse
+import collections
+import sys
+import time
+
+import game_layout as gl
+
+ERROR = 'error'
+WARNING = 'warning'
+NOTE = 'note'
+
+Problem = collections.namedtuple('Problem', 'severity where message')
+
+TRANSITION = gl.ACTION_TYPES['STATE_TRANSITION']
+CLOSE = gl.ACTION_TYPES['CLOSE']
+OTHER = gl.ACTION_TYPES['OTHER']
+# The actions that leave the current state, after which the rest of their
+#  series never runs. (Only STATE_TRANSITION counts for leads_to_closed_state.)
+STATE_CHANGES = (TRANSITION, gl.ACTION_TYPES['POP'],
+                 gl.ACTION_TYPES['PREVIOUS'])
+
+# chain_end() results, as in game.c.
+CHAIN_END_NONE = -1
+CHAIN_END_MULTI = -2
+CHAIN_END_LOOP = -3
+
+
+class Content(object):
+    """The game tables, from an image or straight from the compiler."""
+
+    def __init__(self, actions, text_count, states, anim_count,
+                 special_count, other_count, choices=None, state_names=None,
+                 action_names=None, list_lens=None):
+        self.actions = actions
+        self.text_count = text_count
+        self.states = states
+        self.anim_count = anim_count
+        self.special_count = special_count
+        self.other_count = other_count
+        # The choice tables region, if there is one to check.
+        self.choices = choices
+        self.state_names = state_names or []
+        self.action_names = action_names or []
+        # The timer, input and other counts in each state's header, which
+        #  unpack_state() clips to what fits.
+        self.list_lens = list_lens
+
+    @classmethod
+    def from_image(cls, image, defs):
+        actions_buf = gl.region(image, gl.FLASH_ADDR_GAME_ACTIONS)
+        states_buf = gl.region(image, gl.FLASH_ADDR_GAME_STATES)
+        n_actions = defs.counts['ALL_ACTIONS_LEN']
+        n_states = defs.counts['all_states_len']
+        actions = [gl.unpack_action(actions_buf, i * gl.ACTION.size)
+                   for i in range(n_actions)]
+        states = [gl.unpack_state(states_buf, i * gl.STATE_SIZE)
+                  for i in range(n_states)]
+        list_lens = [gl.STATE_HEAD.unpack_from(states_buf,
+                                               i * gl.STATE_SIZE)[1:]
+                     for i in range(n_states)]
+        return cls(actions, defs.counts['ALL_TEXT_LEN'], states,
+                   defs.counts.get('GAME_ANIMS_LEN', len(defs.anims)),
+                   len(defs.specials), len(defs.others),
+                   gl.region(image, gl.FLASH_ADDR_GAME_CHOICES),
+                   defs.states, list_lens=list_lens)
+
+    def state_name(self, state_id):
+        if state_id < len(self.state_names) and self.state_names[state_id]:
+            return 'state %s' % self.state_names[state_id]
+        return 'state %d' % state_id
+
+    def action_name(self, action_id):
+        if action_id < len(self.action_names):
+            return self.action_names[action_id]
+        return 'action %d' % action_id
+
+
+class Linter(object):
+    def __init__(self, content):
+        self.content = content
+        self.actions = content.actions
+        self.states = content.states
+        self.problems = []
+        self.chain_end_memo = {}
+
+    def report(self, severity, where, message):
+        self.problems.append(Problem(severity, where, message))
+
+    def valid_action(self, action_id):
+        return action_id < len(self.actions)
+
+    def series_heads(self, state):
+        """(what, action ID) for each action series a state can start."""
+        heads = [('entry series', state.entry_series_id)]
+        heads += [('timer %d' % i, t.result_action_id)
+                  for i, t in enumerate(state.timers)]
+        heads += [('menu choice %d' % i, u.result_action_id)
+                  for i, u in enumerate(state.inputs)]
+        heads += [('special %d' % i, o.result_action_id)
+                  for i, o in enumerate(state.others)]
+        return [(what, a) for what, a in heads if self.valid_action(a)]
+
+    def lint(self):
+        self.check_references()
+        self.check_loops()
+        self.check_choices()
+        self.check_timers()
+        self.check_reachable()
+        self.check_closable()
+        return self.problems
+
+    ## References #############################################################
+
+    def check_references(self):
+        c = self.content
+        n_actions = len(self.actions)
+        n_states = len(self.states)
+
+        def action_ref(where, what, action_id):
+            if action_id != gl.GAME_NULL and action_id >= n_actions:
+                self.report(ERROR, where, '%s is action %d, which doesn\'t '
+                            'exist (there are %d)'
+                            % (what, action_id, n_actions))
+
+        for i, a in enumerate(self.actions):
+            where = c.action_name(i)
+            action_ref(where, 'next action', a.next_action_id)
+            action_ref(where, 'next choice', a.next_choice_id)
+            if a.type not in gl.ACTION_TYPE_NAMES:
+                self.report(ERROR, where, 'unknown action type %d' % a.type)
+            elif a.type == TRANSITION and a.detail >= n_states:
+                self.report(ERROR, where, 'transition to state %d, which '
+                            'doesn\'t exist (there are %d)'
+                            % (a.detail, n_states))
+            elif a.type in gl.TEXT_TYPES and a.detail >= c.text_count:
+                self.report(ERROR, where, 'text %d doesn\'t exist (there '
+                            'are %d)' % (a.detail, c.text_count))
+            elif (a.type in gl.ANIM_TYPES and a.detail != gl.GAME_NULL and
+                    a.detail >= c.anim_count):
+                self.report(WARNING, where, 'animation %d doesn\'t exist '
+                            '(there are %d); the badge treats it as none'
+                            % (a.detail, c.anim_count))
+            elif a.type == OTHER and a.detail >= c.other_count:
+                self.report(WARNING, where, 'other action %d doesn\'t exist '
+                            '(there are %d), so this does nothing'
+                            % (a.detail, c.other_count))
+
+        for i, s in enumerate(self.states):
+            where = c.state_name(i)
+            if c.list_lens:
+                for n, limit, what in zip(c.list_lens[i],
+                                          (gl.MAX_TIMERS, gl.MAX_INPUTS,
+                                           gl.MAX_OTHERS),
+                                          ('timers', 'menu choices',
+                                           'specials')):
+                    if n > limit:
+                        self.report(ERROR, where, 'has %d %s; the most is %d'
+                                    % (n, what, limit))
+            action_ref(where, 'entry series', s.entry_series_id)
+            for j, t in enumerate(s.timers):
+                action_ref(where, 'timer %d' % j, t.result_action_id)
+            for j, u in enumerate(s.inputs):
+                action_ref(where, 'menu choice %d' % j, u.result_action_id)
+                if u.text_addr >= c.text_count:
+                    self.report(ERROR, where, 'menu choice %d is text %d, '
+                                'which doesn\'t exist (there are %d)'
+                                % (j, u.text_addr, c.text_count))
+            for j, o in enumerate(s.others):
+                action_ref(where, 'special %d' % j, o.result_action_id)
+                if o.type_id >= c.special_count:
+                    self.report(WARNING, where, 'special %d is type %d, '
+                                'which doesn\'t exist (there are %d), so it '
+                                'never fires'
+                                % (j, o.type_id, c.special_count))
+
+    ## Loops ##################################################################
+
+    def successors(self, action_id):
+        a = self.actions[action_id]
+        return [x for x in (a.next_action_id, a.next_choice_id)
+                if self.valid_action(x)]
+
+    def strongly_connected(self):
+        """Tarjan's algorithm over next_action_id and next_choice_id, without
+        recursion. Returns the components that contain a loop."""
+        n = len(self.actions)
+        index = [None] * n
+        low = [0] * n
+        on_stack = [False] * n
+        stack = []
+        counter = 0
+        loops = []
+        for root in range(n):
+            if index[root] is not None:
+                continue
+            index[root] = low[root] = counter
+            counter += 1
+            stack.append(root)
+            on_stack[root] = True
+            work = [(root, self.successors(root), 0)]
+            while work:
+                v, succ, i = work[-1]
+                if i < len(succ):
+                    work[-1] = (v, succ, i + 1)
+                    w = succ[i]
+                    if index[w] is None:
+                        index[w] = low[w] = counter
+                        counter += 1
+                        stack.append(w)
+                        on_stack[w] = True
+                        work.append((w, self.successors(w), 0))
+                    elif on_stack[w]:
+                        low[v] = min(low[v], index[w])
+                    continue
+                work.pop()
+                if work:
+                    u = work[-1][0]
+                    low[u] = min(low[u], low[v])
+                if low[v] != index[v]:
+                    continue
+                component = []
+                while True:
+                    w = stack.pop()
+                    on_stack[w] = False
+                    component.append(w)
+                    if w == v:
+                        break
+                if len(component) > 1 or v in succ:
+                    loops.append(sorted(component))
+        return loops
+
+    def on_cycle(self, field):
+        """The actions on a loop through `field` alone."""
+        n = len(self.actions)
+        color = [0] * n  # 0: unvisited, 1: on the current path, 2: done
+        cycle = [False] * n
+        for start in range(n):
+            path = []
+            x = start
+            while self.valid_action(x) and not color[x]:
+                color[x] = 1
+                path.append(x)
+                x = getattr(self.actions[x], field)
+            if self.valid_action(x) and color[x] == 1:
+                for y in path[path.index(x):]:
+                    cycle[y] = True
+            for y in path:
+                color[y] = 2
+        return cycle
+
+    def check_loops(self):
+        self.next_cycle = self.on_cycle('next_action_id')
+        self.choice_cycle = self.on_cycle('next_choice_id')
+        for component in self.strongly_connected():
+            members = ', '.join(str(a) for a in component[:8])
+            if len(component) > 8:
+                members += ', ...'
+            where = self.content.action_name(component[0])
+            if any(self.next_cycle[a] for a in component):
+                self.report(ERROR, where, 'next_action_id loops (actions %s): '
+                            'this series never ends, and the badge hangs '
+                            'checking it for closed states' % members)
+            elif any(self.choice_cycle[a] for a in component):
+                self.report(ERROR, where, 'next_choice_id loops back around '
+                            'without ever ending (actions %s)' % members)
+            else:
+                self.report(ERROR, where, 'series can loop forever, '
+                            'depending on its choices (actions %s)' % members)
+
+    ## Choices ################################################################
+
+    def check_choices(self):
+        c = self.content
+        refs = [0] * len(self.actions)
+        for a in self.actions:
+            if self.valid_action(a.next_choice_id):
+                refs[a.next_choice_id] += 1
+        for i, n in enumerate(refs):
+            if n > 1:
+                self.report(ERROR, c.action_name(i), 'next choice of %d '
+                            'actions, so it\'s in more than one choice set' % n)
+
+        self.choice_heads = [i for i in range(len(self.actions))
+                             if not refs[i] and not self.choice_cycle[i]]
+        for head in self.choice_heads:
+            members = self.members(head)
+            if len(members) < 2 or self.choice_cycle[members[-1]]:
+                continue # (Loops are reported already.)
+            where = c.action_name(head)
+            total = self.actions[head].choice_total
+            shares = sum(self.actions[m].choice_share for m in members)
+            if not total:
+                self.report(ERROR, where, 'choice_total is 0, and the badge '
+                            'divides by it')
+                continue
+            if total != shares:
+                self.report(ERROR, where, 'choice_total is %d, but the shares '
+                            'in its choice set add up to %d' % (total, shares))
+            if c.choices is not None and len(members) <= gl.CHOICES_MAX:
+                wrong = gl.check_choice_table(self.actions, c.choices, head)
+                if wrong:
+                    self.report(ERROR, where, 'choice table picks action %d '
+                                'for %d, but the walk picks %d'
+                                % (wrong[1], wrong[0], wrong[2]))
+
+    def members(self, head):
+        members = [head]
+        x = self.actions[head].next_choice_id
+        while self.valid_action(x) and not self.choice_cycle[members[-1]]:
+            members.append(x)
+            x = self.actions[x].next_choice_id
+        return members
+
+    ## Timers #################################################################
+
+    def check_timers(self):
+        for i, s in enumerate(self.states):
+            where = self.content.state_name(i)
+            last = None
+            for j, t in enumerate(s.timers):
+                if not t.duration:
+                    self.report(WARNING, where, 'timer %d has no duration, so '
+                                'it never fires' % j)
+                if last and last.recurring and not t.recurring:
+                    self.report(WARNING, where, 'timer %d is non-recurring, '
+                                'but comes after a recurring one' % j)
+                elif (last and last.recurring and t.recurring and
+                        t.duration > last.duration):
+                    self.report(WARNING, where, 'timer %d recurs every %d '
+                                'ticks, but comes after one that recurs every '
+                                '%d; they should go from longest to shortest'
+                                % (j, t.duration, last.duration))
+                last = t
+
+    ## Reachability ###########################################################
+
+    def check_reachable(self):
+        n_states = len(self.states)
+        self.reachable = [False] * n_states
+        seen = [False] * len(self.actions)
+        if not n_states:
+            return
+        self.reachable[0] = True
+        queue = [0]
+        while queue:
+            state = self.states[queue.pop()]
+            actions = [a for _, a in self.series_heads(state)]
+            while actions:
+                x = actions.pop()
+                if seen[x]:
+                    continue
+                seen[x] = True
+                a = self.actions[x]
+                if (a.type == TRANSITION and a.detail < n_states and
+                        not self.reachable[a.detail]):
+                    self.reachable[a.detail] = True
+                    queue.append(a.detail)
+                actions.extend(self.successors(x))
+        for i in range(n_states):
+            if not self.reachable[i]:
+                self.report(WARNING, self.content.state_name(i),
+                            'unreachable from state 0')
+
+    ## Closed states ##########################################################
+
+    def closing_actions(self):
+        """The actions that, once reached, might close the current state
+        before anything changes it."""
+        n = len(self.actions)
+        next_preds = [[] for _ in range(n)]
+        choice_preds = [[] for _ in range(n)]
+        for i, a in enumerate(self.actions):
+            if self.valid_action(a.next_action_id):
+                next_preds[a.next_action_id].append(i)
+            if self.valid_action(a.next_choice_id):
+                choice_preds[a.next_choice_id].append(i)
+        closes = [a.type == CLOSE for a in self.actions]
+        queue = [i for i in range(n) if closes[i]]
+        while queue:
+            x = queue.pop()
+            # Reaching a choice set can pick any of the choices after it, but
+            #  whatever follows a state change runs in some other state.
+            preds = choice_preds[x] + [p for p in next_preds[x]
+                                       if self.actions[p].type
+                                       not in STATE_CHANGES]
+            for p in preds:
+                if not closes[p]:
+                    closes[p] = True
+                    queue.append(p)
+        return closes
+
+    def chain_end(self, action_id):
+        """Where the series starting at `action_id` ends up, following only
+        next_action_id, the way find_chain_end() in game.c does."""
+        path = []
+        x = action_id
+        while (self.valid_action(x) and x not in self.chain_end_memo and
+               not self.next_cycle[x]):
+            path.append(x)
+            x = self.actions[x].next_action_id
+        if not self.valid_action(x):
+            end = CHAIN_END_NONE
+        elif x in self.chain_end_memo:
+            end = self.chain_end_memo[x]
+        else:
+            end = CHAIN_END_LOOP
+        for x in reversed(path):
+            a = self.actions[x]
+            if end != CHAIN_END_LOOP and a.type == TRANSITION:
+                if end in (CHAIN_END_NONE, a.detail):
+                    end = a.detail
+                else:
+                    end = CHAIN_END_MULTI
+            self.chain_end_memo[x] = end
+        return end
+
+    def chain_targets(self, action_id):
+        """The states the series at `action_id` transitions to, following
+        only next_action_id."""
+        targets = []
+        x = action_id
+        while self.valid_action(x) and not self.next_cycle[x]:
+            a = self.actions[x]
+            if a.type == TRANSITION:
+                targets.append(a.detail)
+            x = a.next_action_id
+        return targets
+
+    def check_closable(self):
+        c = self.content
+        n_states = len(self.states)
+        closes = self.closing_actions()
+        closable = [any(closes[a] for _, a in self.series_heads(s))
+                    for s in self.states]
+
+        def closed_targets(action_id):
+            if self.chain_end(action_id) == CHAIN_END_NONE:
+                return []
+            return sorted(set(t for t in self.chain_targets(action_id)
+                              if t < n_states and closable[t]))
+
+        for i, a in enumerate(self.actions):
+            if (a.type == TRANSITION and a.next_action_id != gl.GAME_NULL
+                    and not self.next_cycle[i]):
+                self.report(WARNING, c.action_name(i), 'the actions after '
+                            'this transition to %s never run'
+                            % c.state_name(a.detail))
+
+        heads_checked = set()
+        for i, s in enumerate(self.states):
+            if not self.reachable[i]:
+                continue
+            where = c.state_name(i)
+            for what, head in self.series_heads(s):
+                targets = closed_targets(head)
+                if targets:
+                    self.report(NOTE, where, '%s leads to closable %s'
+                                % (what, ', '.join(c.state_name(t)
+                                                   for t in targets)))
+                if head in heads_checked or self.choice_cycle[head]:
+                    continue
+                heads_checked.add(head)
+                for member in self.members(head)[1:]:
+                    missed = [t for t in closed_targets(member)
+                              if t not in targets]
+                    if missed:
+                        self.report(WARNING, c.action_name(member), 'choice '
+                                    'leads to closable %s, but the '
+                                    'closed-state check only follows the '
+                                    'first choice in its set (%s)'
+                                    % (', '.join(c.state_name(t)
+                                                 for t in missed),
+                                       c.action_name(head)))
+
+            inputs = [u.result_action_id for u in s.inputs]
+            if inputs and all(self.valid_action(a) and closed_targets(a)
+                              for a in inputs):
+                targets = sorted(set(t for a in inputs
+                                     for t in closed_targets(a)))
+                self.report(WARNING, where, 'every menu choice leads to a '
+                            'closable state (%s); once they\'re all closed, '
+                            'the badge hangs looking for one that isn\'t'
+                            % ', '.join(c.state_name(t) for t in targets))
+
+
+def lint(content):
+    return Linter(content).lint()
+
+
+def print_problems(problems, verbose=False, out=sys.stderr):
+    for p in problems:
+        if p.severity != NOTE or verbose:
+            print('%s: %s: %s' % (p.where, p.severity, p.message), file=out)
+
+
+def count(problems, severity):
+    return sum(1 for p in problems if p.severity == severity)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Check a game image for content problems.')
+    parser.add_argument('image', help='game image (or flash image with --flash)')
+    parser.add_argument('--defs', required=True,
+                        help='the state_definitions.h the image was built with')
+    parser.add_argument('--flash', dest='flash_image', action='store_true',
+                        help='the image is a whole flash dump')
+    parser.add_argument('--strict', action='store_true',
+                        help='fail on warnings too')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='also list the series that lead to closable '
+                             'states')
+    args = parser.parse_args()
+
+    start = time.time()
+    content = Content.from_image(gl.read_image(args.image, args.flash_image),
+                                 gl.read_definitions(args.defs))
+    problems = lint(content)
+    print_problems(problems, args.verbose)
+    errors, warnings = count(problems, ERROR), count(problems, WARNING)
+    print('%d actions, %d states: %d error(s), %d warning(s), %d series '
+          'leading to closable states (%.3fs).'
+          % (len(content.actions), len(content.states), errors, warnings,
+             count(problems, NOTE), time.time() - start))
+    return 1 if errors or (args.strict and warnings) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,46 @@
+"""
+Generate the gamma table that ht16d35b.c uses to turn 8-bit LED channel
+values into the HT16D35B's 6-bit grayscale.
+
+The eye's response to PWM duty is far from linear, so a straight ``>>2``
+spends most of a fade's perceived change in its first few steps. Raising
+the duty to the power of the gamma makes equal steps in the 8-bit values look
+about equally big. Any channel that is on at all stays at least 1, so dim
+colors in the existing animations don't vanish.
+
+Usage: python gamma_lut.py [gamma]
+"""
+
+from __future__ import print_function
+
+import sys
+
+GAMMA = 2.2
+LEVELS = 63
+
+
+def gamma_table(gamma=GAMMA):
+    table = []
+    for i in range(256):
+        value = int(round(LEVELS * (i / 255.0) ** gamma))
+        if i and not value:
+            value = 1
+        table.append(value)
+    return table
+
+
+def main():
+    gamma = float(sys.argv[1]) if len(sys.argv) > 1 else GAMMA
+    table = gamma_table(gamma)
+    print("/// 8-bit channel value to 6-bit grayscale, gamma %.1f." % gamma)
+    print("/**")
+    print(" ** Generated by scripts/gamma_lut.py.")
+    print(" */")
+    print("const uint8_t ht16d_gamma[256] = {")
+    for row in range(0, 256, 16):
+        print("    " + " ".join("%2d," % v for v in table[row:row+16]))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
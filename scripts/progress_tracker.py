@@ -0,0 +1,258 @@
+"""
+Conference-wide message reconstruction from base station progress reports.
+
+The base station (qc15_base) prints one line per progress frame it hears:
+
+    3,<badge_id>,<part_id>,0x<20 hex digits>
+
+where the hex digits are the 10-byte ``code_part_unlocks`` bitmap for that
+part (bit ``i%8`` of byte ``i/8`` set means character ``i`` is unlocked, see
+``check_id_buf()`` in util.c). This script merges every badge's reports into
+a single unlock map for the 96 parts of the 7680-character message.
+
+Each report is merged incrementally: only the bits that are new for that
+badge and part are touched, so the cost of a report is proportional to what
+it changes rather than to the size of the log. The tracker keeps, for every
+character, the set of badges that have it unlocked, plus a per-part count
+and set of the characters still locked, so the usual queries ("how many are
+left in part N", "is this character still locked", "who holds it") are
+constant time.
+
+Usage:
+    python progress_tracker.py base_log.txt
+    python progress_tracker.py -f base_log.txt      # follow a growing log
+    some_serial_reader | python progress_tracker.py -
+"""
+
+from __future__ import print_function
+
+import argparse
+import sys
+import time
+
+PART_COUNT = 96
+PART_SIZE = 80
+PART_BYTES = PART_SIZE // 8
+PARTS_PER_BADGE = 6
+BADGE_SEGMENTS = PART_COUNT // PARTS_PER_BADGE
+
+MSG_TYPE_PROGRESS = '3'
+MSG_TYPE_STATS = '4'
+
+
+def bitmap_from_hex(hex_str):
+    """Convert the base station's ``0x....`` string into an int bitmap.
+
+    Bit ``i`` of the returned value corresponds to character ``i``, which
+    matches the byte/bit order used by ``check_id_buf()``.
+    """
+    if hex_str.startswith('0x') or hex_str.startswith('0X'):
+        hex_str = hex_str[2:]
+    if len(hex_str) != PART_BYTES * 2:
+        raise ValueError("bad part_data length %d" % len(hex_str))
+    bitmap = 0
+    for byte_index in range(PART_BYTES):
+        byte = int(hex_str[byte_index*2:byte_index*2+2], 16)
+        bitmap |= byte << (8*byte_index)
+    return bitmap
+
+
+def bit_indices(bitmap):
+    """Yield the index of every set bit in ``bitmap``, lowest first."""
+    while bitmap:
+        low = bitmap & -bitmap
+        yield low.bit_length() - 1
+        bitmap ^= low
+
+
+def parts_for_badge(badge_id):
+    """The six global part IDs a badge is responsible for."""
+    start = (badge_id % BADGE_SEGMENTS) * PARTS_PER_BADGE
+    return range(start, start + PARTS_PER_BADGE)
+
+
+class ProgressTracker(object):
+    """Incrementally merged unlock map for the whole message."""
+
+    def __init__(self):
+        # Union of every badge's bitmap, per part.
+        self.part_unlocks = [0] * PART_COUNT
+        # holders[part][char] -> set of badge IDs with that char unlocked.
+        self.holders = [[set() for _ in range(PART_SIZE)]
+                        for _ in range(PART_COUNT)]
+        # locked[part] -> set of char indices nobody has unlocked yet.
+        self.locked = [set(range(PART_SIZE)) for _ in range(PART_COUNT)]
+        self.total_locked = PART_COUNT * PART_SIZE
+        # Last merged bitmap for each (badge_id, part_id).
+        self.reports = dict()
+        # Badges seen per segment (badge_id % 16), i.e. per group of parts.
+        self.segment_badges = [set() for _ in range(BADGE_SEGMENTS)]
+        self.stats = dict()
+        self.lines_parsed = 0
+        self.lines_rejected = 0
+
+    def merge(self, badge_id, part_id, bitmap):
+        """Merge one progress report. Returns the list of chars that became
+        unlocked conference-wide because of it."""
+        if not 0 <= part_id < PART_COUNT:
+            raise ValueError("part_id %d out of range" % part_id)
+        bitmap &= (1 << PART_SIZE) - 1
+        key = (badge_id, part_id)
+        previous = self.reports.get(key, 0)
+        # Unlocks are monotonic on the badge; a badge that has been reset
+        #  can only ever report a subset, which we just ignore.
+        new_bits = bitmap & ~previous
+        self.segment_badges[badge_id % BADGE_SEGMENTS].add(badge_id)
+        if not new_bits:
+            return []
+        self.reports[key] = previous | new_bits
+
+        newly_global = []
+        holders = self.holders[part_id]
+        for char_index in bit_indices(new_bits):
+            holders[char_index].add(badge_id)
+        globally_new = new_bits & ~self.part_unlocks[part_id]
+        if globally_new:
+            self.part_unlocks[part_id] |= globally_new
+            locked = self.locked[part_id]
+            for char_index in bit_indices(globally_new):
+                locked.discard(char_index)
+                newly_global.append(char_index)
+            self.total_locked -= len(newly_global)
+        return newly_global
+
+    def feed_line(self, line):
+        """Parse one line of base station output. Returns the result of
+        ``merge()`` for progress lines, or None for anything else."""
+        line = line.strip()
+        if not line or line.startswith('#'):
+            return None
+        fields = line.split(',')
+        try:
+            if fields[0] == MSG_TYPE_PROGRESS and len(fields) == 4:
+                self.lines_parsed += 1
+                return self.merge(int(fields[1]), int(fields[2]),
+                                  bitmap_from_hex(fields[3]))
+            if fields[0] == MSG_TYPE_STATS and len(fields) == 11:
+                self.lines_parsed += 1
+                self.stats[int(fields[1])] = [int(f) for f in fields[2:]]
+                return None
+        except ValueError:
+            pass
+        self.lines_rejected += 1
+        return None
+
+    ## Queries. All of these are constant time (or linear in their output).
+
+    def is_locked(self, part_id, char_index):
+        return not (self.part_unlocks[part_id] >> char_index) & 1
+
+    def locked_count(self, part_id):
+        return len(self.locked[part_id])
+
+    def locked_chars(self, part_id):
+        return sorted(self.locked[part_id])
+
+    def char_holders(self, part_id, char_index):
+        return self.holders[part_id][char_index]
+
+    def part_candidates(self, part_id):
+        """Badges we've heard from that are able to unlock ``part_id``."""
+        return self.segment_badges[part_id // PARTS_PER_BADGE]
+
+    def global_char(self, part_id, char_index):
+        return part_id * PART_SIZE + char_index
+
+    def render(self, message=None, locked_char='?'):
+        """Return the reconstructed message, with locked characters masked.
+        If ``message`` isn't given, unlocked characters are shown as ``#``."""
+        out = []
+        for part_id in range(PART_COUNT):
+            unlocks = self.part_unlocks[part_id]
+            for char_index in range(PART_SIZE):
+                if (unlocks >> char_index) & 1:
+                    if message:
+                        out.append(message[part_id*PART_SIZE + char_index])
+                    else:
+                        out.append('#')
+                else:
+                    out.append(locked_char)
+        return ''.join(out)
+
+    def summary(self):
+        total = PART_COUNT * PART_SIZE
+        lines = []
+        lines.append("%d/%d characters unlocked (%.1f%%), %d badges reporting"
+                     % (total - self.total_locked, total,
+                        100.0 * (total - self.total_locked) / total,
+                        len(set(b for b, _ in self.reports))))
+        for segment in range(BADGE_SEGMENTS):
+            counts = []
+            for part_id in range(segment*PARTS_PER_BADGE,
+                                 (segment+1)*PARTS_PER_BADGE):
+                counts.append("%2d" % self.locked_count(part_id))
+            lines.append("  segment %2d (%3d badges) locked per part: %s"
+                         % (segment, len(self.segment_badges[segment]),
+                            ' '.join(counts)))
+        return '\n'.join(lines)
+
+
+def follow(stream):
+    """Yield lines from ``stream``, waiting for more at EOF like tail -f."""
+    while True:
+        line = stream.readline()
+        if not line:
+            time.sleep(0.25)
+            continue
+        yield line
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Merge qc15 base station progress reports.")
+    parser.add_argument('log', help="base station log file, or - for stdin")
+    parser.add_argument('-f', '--follow', action='store_true',
+                        help="keep reading as the log grows")
+    parser.add_argument('-m', '--message',
+                        help="plaintext message file, for rendering")
+    parser.add_argument('-p', '--part', type=int, action='append',
+                        help="list locked chars and holders for this part")
+    args = parser.parse_args()
+
+    message = None
+    if args.message:
+        with open(args.message) as message_file:
+            message = message_file.read().replace('\n', '')
+
+    stream = sys.stdin if args.log == '-' else open(args.log)
+    tracker = ProgressTracker()
+
+    if args.follow:
+        for line in follow(stream):
+            newly_unlocked = tracker.feed_line(line)
+            if newly_unlocked:
+                part_id = int(line.split(',')[2])
+                print("part %d: +%d unlocked, %d left; %d left overall"
+                      % (part_id, len(newly_unlocked),
+                         tracker.locked_count(part_id), tracker.total_locked))
+                sys.stdout.flush()
+        return
+
+    for line in stream:
+        tracker.feed_line(line)
+
+    print(tracker.summary())
+    for part_id in args.part or []:
+        print("part %d locked: %s" % (part_id, tracker.locked_chars(part_id)))
+        print("part %d candidates: %s"
+              % (part_id, sorted(tracker.part_candidates(part_id))))
+        for char_index in range(PART_SIZE):
+            holders = tracker.char_holders(part_id, char_index)
+            if holders:
+                print("  char %2d held by %s" % (char_index, sorted(holders)))
+    if message:
+        print(tracker.render(message))
+
+
+if __name__ == "__main__":
+    main()